@@ -0,0 +1,252 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Pixel and geometry kernels benchmarks.
+//!
+//! Run with `cargo bench --bench kernels`.
+//! An optional argument filters benchmarks by name.
+
+extern crate resvg;
+
+use std::env;
+use std::time::{
+    Duration,
+    Instant,
+};
+
+use resvg::prelude::*;
+use resvg::usvg;
+use resvg::backend_utils::{
+    image,
+    mask,
+    text,
+};
+use resvg::layers::{
+    self,
+    Layers,
+};
+
+
+const SIZES: &[(&str, u32, u32)] = &[
+    ("icon", 64, 64),
+    ("HD", 1920, 1080),
+    ("8K", 7680, 4320),
+];
+
+const SEGMENTS: &[usize] = &[100, 10_000, 1_000_000];
+
+const MIN_TIME_MS: u64 = 500;
+
+
+fn main() {
+    let filter = env::args().nth(1).and_then(|s| if s.starts_with('-') { None } else { Some(s) });
+    let enabled = |name: &str| filter.as_ref().map(|f| name.contains(f.as_str())).unwrap_or(true);
+
+    for &(size_name, w, h) in SIZES {
+        let size = ScreenSize::new(w, h);
+        let pixels = (w * h) as f64;
+
+        let name = format!("image_to_mask/{}", size_name);
+        if enabled(&name) {
+            let mut data = random_bytes((w * h * 4) as usize);
+            bench(&name, pixels, "px", || {
+                let region = ScreenRect::new(0, 0, w, h);
+                mask::image_to_mask(&mut data, size, region, Some(usvg::Opacity::new(0.5)));
+            });
+        }
+
+        let name = format!("premultiply/{}", size_name);
+        if enabled(&name) {
+            let src = random_bytes((w * h * 4) as usize);
+            let mut dst = vec![0; (w * h * 4) as usize];
+            bench(&name, pixels, "px", || {
+                image::copy_to_bgra_premultiplied(&src, size, w * 4, 4, (0, 0, w, h), &mut dst);
+            });
+        }
+
+        let name = format!("layers_get/{}", size_name);
+        if enabled(&name) {
+            let mut layers = Layers::new(
+                size, 96.0,
+                |size, _| Some((size, vec![0u8; (size.width * size.height * 4) as usize])),
+                |img: &mut (ScreenSize, Vec<u8>), regions| {
+                    layers::fill_regions(&mut img.1, img.0, regions, [0, 0, 0, 0])
+                },
+            );
+
+            // Emulate nested groups: acquire a few layers at once and release them.
+            // Only the last one is drawn on, so the others are not cleared.
+            let area = ScreenRect::new(0, 0, w, h);
+            bench(&name, pixels * 4.0, "px", || {
+                let l1 = layers.get(area).unwrap();
+                let l2 = layers.get(area).unwrap();
+                let l3 = layers.get(area).unwrap();
+                let l4 = layers.get(area).unwrap();
+                l4.touch(Some(Rect::new(0.0, 0.0, 100.0, 100.0)));
+                l4.borrow_mut().1[0] = 1;
+                drop((l1, l2, l3, l4));
+            });
+        }
+    }
+
+    for &count in SEGMENTS {
+        let segments = random_path(count);
+        let ts = usvg::Transform::new(1.5, 0.2, -0.3, 0.8, 10.0, 20.0);
+
+        let name = format!("path_bbox/{}", count);
+        if enabled(&name) {
+            let mut sum = 0.0;
+            bench(&name, count as f64, "seg", || {
+                sum += utils::path_bbox(&segments, None, &ts).width;
+            });
+            assert!(sum.is_finite());
+        }
+
+        let name = format!("transform_path/{}", count);
+        if enabled(&name) {
+            // Applying the same transform in place would grow the coordinates
+            // up to infinity, so it alternates with the inverted one.
+            let det = ts.a * ts.d - ts.b * ts.c;
+            let inv = usvg::Transform::new(
+                ts.d / det, -ts.b / det, -ts.c / det, ts.a / det,
+                (ts.c * ts.f - ts.d * ts.e) / det, (ts.b * ts.e - ts.a * ts.f) / det,
+            );
+
+            let mut path = segments.clone();
+            let mut forward = true;
+            bench(&name, count as f64, "seg", || {
+                utils::transform_path(&mut path, if forward { &ts } else { &inv });
+                forward = !forward;
+            });
+            assert!(utils::path_bbox(&path, None, &usvg::Transform::default()).width.is_finite());
+        }
+    }
+
+    for &count in &[10, 1000, 10_000] {
+        let name = format!("prepare_blocks/{}", count);
+        if enabled(&name) {
+            let svg = random_text_svg(count);
+            let tree = usvg::Tree::from_str(&svg, &usvg::Options::default()).unwrap();
+            let node = tree.root().descendants().find(|n|
+                if let usvg::NodeKind::Text(_) = *n.borrow() { true } else { false }
+            ).unwrap();
+            let mut fm = StubFontMetrics { size: 0.0 };
+
+            let kind = node.borrow();
+            if let usvg::NodeKind::Text(ref text) = *kind {
+                bench(&name, count as f64, "glyph", || {
+                    let blocks = text::prepare_blocks(text, &mut fm);
+                    assert!(!blocks.is_empty());
+                });
+            }
+        }
+    }
+}
+
+fn bench<F: FnMut()>(name: &str, units: f64, unit: &str, mut f: F) {
+    // Warm up.
+    f();
+
+    let min_time = Duration::from_millis(MIN_TIME_MS);
+    let start = Instant::now();
+    let mut iterations = 0;
+    loop {
+        f();
+        iterations += 1;
+
+        if start.elapsed() >= min_time {
+            break;
+        }
+    }
+
+    let elapsed = start.elapsed();
+    let secs = elapsed.as_secs() as f64 + elapsed.subsec_nanos() as f64 / 1_000_000_000.0;
+    let throughput = units * iterations as f64 / secs;
+    println!("{:<28} {:>10.2} M{}/s {:>10.3}ms/iter",
+             name, throughput / 1_000_000.0, unit, secs * 1000.0 / iterations as f64);
+}
+
+
+/// A fixed seed linear congruential generator.
+///
+/// Keeps inputs identical between runs.
+struct Lcg(u64);
+
+impl Lcg {
+    fn new() -> Self {
+        Lcg(0x2545F4914F6CDD1D)
+    }
+
+    fn next(&mut self) -> u32 {
+        self.0 = self.0.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+        (self.0 >> 33) as u32
+    }
+
+    fn next_f64(&mut self, max: f64) -> f64 {
+        self.next() as f64 / (1u64 << 31) as f64 * max
+    }
+}
+
+fn random_bytes(len: usize) -> Vec<u8> {
+    let mut rng = Lcg::new();
+    (0..len).map(|_| rng.next() as u8).collect()
+}
+
+fn random_path(count: usize) -> Vec<usvg::PathSegment> {
+    let mut rng = Lcg::new();
+    let mut segments = Vec::with_capacity(count);
+    segments.push(usvg::PathSegment::MoveTo { x: 0.0, y: 0.0 });
+    for i in 1..count {
+        if i % 2 == 0 {
+            segments.push(usvg::PathSegment::LineTo {
+                x: rng.next_f64(1000.0), y: rng.next_f64(1000.0),
+            });
+        } else {
+            segments.push(usvg::PathSegment::CurveTo {
+                x1: rng.next_f64(1000.0), y1: rng.next_f64(1000.0),
+                x2: rng.next_f64(1000.0), y2: rng.next_f64(1000.0),
+                x: rng.next_f64(1000.0), y: rng.next_f64(1000.0),
+            });
+        }
+    }
+
+    segments
+}
+
+fn random_text_svg(count: usize) -> String {
+    let mut rng = Lcg::new();
+    let text: String = (0..count).map(|_| (b'a' + (rng.next() % 26) as u8) as char).collect();
+    // Every fourth glyph has a custom position, so blocks are both merged and split.
+    let xs: Vec<String> = (0..count).filter(|i| i % 4 == 0).map(|i| (i * 10).to_string()).collect();
+
+    format!("<svg xmlns='http://www.w3.org/2000/svg' width='100' height='100'>\
+             <text x='{}' y='50'>{}</text></svg>", xs.join(" "), text)
+}
+
+/// Font metrics with fixed advances, so only the layout itself is measured.
+struct StubFontMetrics {
+    size: f64,
+}
+
+impl text::FontMetrics<()> for StubFontMetrics {
+    fn set_font(&mut self, font: &usvg::Font) {
+        self.size = font.size;
+    }
+
+    fn font(&self) -> () {
+        ()
+    }
+
+    fn width(&self, text: &str) -> f64 {
+        text.len() as f64 * self.size * 0.6
+    }
+
+    fn ascent(&self) -> f64 {
+        self.size * 0.8
+    }
+
+    fn height(&self) -> f64 {
+        self.size
+    }
+}
@@ -0,0 +1,426 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * @file ResvgGraphicsItem.h
+ *
+ * QGraphicsItem based on resvg
+ */
+
+#ifndef RESVGGRAPHICSITEM_H
+#define RESVGGRAPHICSITEM_H
+
+#include "ResvgQt.h"
+
+#include <QGraphicsItem>
+#include <QStyleOptionGraphicsItem>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QImage>
+#include <QtMath>
+
+#include <cmath>
+
+/**
+ * @brief A parsed SVG that can be shared between multiple #ResvgGraphicsItem.
+ *
+ * Rendering is serialized, because the underling tree is not thread-safe.
+ */
+class ResvgSharedTree
+{
+public:
+    /**
+     * @brief Loads the SVG(Z) file.
+     *
+     * Files are parsed only once. All items that use the same file share the same tree,
+     * until the last of them is destroyed.
+     *
+     * Must be called from the GUI thread.
+     */
+    static QSharedPointer<ResvgSharedTree> load(const QString &filePath);
+
+    /**
+     * @brief Creates a tree from the SVG data.
+     */
+    static QSharedPointer<ResvgSharedTree> fromData(const QByteArray &data);
+
+    /**
+     * @brief Returns \b true if the file or data were loaded successful.
+     */
+    bool isValid() const { return m_renderer.isValid(); }
+
+    /**
+     * @brief Returns an underling error when #isValid is \b false.
+     */
+    QString errorString() const { return m_renderer.errorString(); }
+
+    /**
+     * @brief Returns an SVG viewbox.
+     */
+    QRectF viewBox() const { return m_viewBox; }
+
+    /**
+     * @brief Renders the SVG to an image of the specified size.
+     *
+     * Can be called from any thread.
+     */
+    QImage render(const QSize &size, qreal dpr) const;
+
+private:
+    ResvgSharedTree() = default;
+
+private:
+    ResvgRenderer m_renderer;
+    QRectF m_viewBox;
+    mutable QMutex m_mutex;
+};
+
+namespace ResvgPrivate {
+
+/**
+ * Receives rendered images in the GUI thread.
+ *
+ * Outlives the item while there are pending jobs.
+ */
+class ItemProxy : public QObject
+{
+public:
+    QGraphicsItem *item = nullptr;
+};
+
+template<typename F>
+class RenderJob : public QRunnable
+{
+public:
+    explicit RenderJob(F f) : m_f(f) {}
+    void run() override { m_f(); }
+
+private:
+    F m_f;
+};
+
+} // ResvgPrivate
+
+/**
+ * @brief A QGraphicsItem that renders an SVG using resvg.
+ *
+ * Unlike \b QGraphicsSvgItem, the SVG is rendered asynchronously into a device-space image
+ * per level of detail. Scaled images of the nearest cached level are drawn while
+ * a new level is being rendered. Items that are smaller than #placeholderSize pixels
+ * are drawn as simple rectangles.
+ *
+ * A level is rendered at the next power of two of the current scale, so an image
+ * can be up to twice as large as the item on screen. Images are limited
+ * by #maxImageSize and upscaled when the limit is reached. Cached images of an item
+ * never use more than #maxCacheBytes.
+ */
+class ResvgGraphicsItem : public QGraphicsItem
+{
+public:
+    /**
+     * @brief Constructs an item from the SVG(Z) file.
+     */
+    explicit ResvgGraphicsItem(const QString &filePath, QGraphicsItem *parent = nullptr);
+
+    /**
+     * @brief Constructs an item from the shared tree.
+     */
+    explicit ResvgGraphicsItem(const QSharedPointer<ResvgSharedTree> &tree,
+                               QGraphicsItem *parent = nullptr);
+
+    /**
+     * @brief Destructs the item. Pending renders are discarded.
+     */
+    ~ResvgGraphicsItem();
+
+    /**
+     * @brief Returns the shared tree.
+     */
+    QSharedPointer<ResvgSharedTree> tree() const { return m_tree; }
+
+    /**
+     * @brief Sets a size in device pixels below which a placeholder is drawn.
+     *
+     * Default: 4.
+     */
+    void setPlaceholderSize(qreal size) { m_placeholderSize = size; update(); }
+
+    /**
+     * @brief Returns a size in device pixels below which a placeholder is drawn.
+     */
+    qreal placeholderSize() const { return m_placeholderSize; }
+
+    /**
+     * @brief Sets a placeholder color.
+     *
+     * Default: light gray.
+     */
+    void setPlaceholderColor(const QColor &color) { m_placeholderColor = color; update(); }
+
+    /**
+     * @brief Sets a maximum width and height of a rendered image in pixels.
+     *
+     * Default: 4096.
+     */
+    void setMaxImageSize(int size) { m_maxImageSize = size; }
+
+    /**
+     * @brief Returns a maximum width and height of a rendered image in pixels.
+     */
+    int maxImageSize() const { return m_maxImageSize; }
+
+    /**
+     * @brief Sets a maximum amount of memory used by cached images of this item.
+     *
+     * The latest image is kept even if it's larger.
+     *
+     * Default: 64 MiB.
+     */
+    void setMaxCacheBytes(qint64 bytes) { m_maxCacheBytes = bytes; }
+
+    /**
+     * @brief Returns a maximum amount of memory used by cached images of this item.
+     */
+    qint64 maxCacheBytes() const { return m_maxCacheBytes; }
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *p, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+private:
+    QSize levelSize(int level, qreal dpr) const;
+    static qint64 imageBytes(const QImage &img) { return qint64(img.bytesPerLine()) * img.height(); }
+    void requestRender(int level, const QSize &size, qreal dpr);
+    void onRendered(int level, const QImage &img);
+    const QImage* nearestImage(int level) const;
+
+private:
+    // The level of detail is 2^level.
+    static const int MinLevel = -6;
+    static const int MaxLevel = 6;
+    // Number of cached levels per item.
+    static const int MaxCachedLevels = 3;
+
+    QSharedPointer<ResvgSharedTree> m_tree;
+    QSharedPointer<ResvgPrivate::ItemProxy> m_proxy;
+    QHash<int, QImage> m_cache;
+    QList<int> m_cacheOrder;
+    qint64 m_cacheBytes = 0;
+    // Levels that cannot be rendered. They are not requested again.
+    QSet<int> m_failedLevels;
+    int m_pendingLevel = MinLevel - 1;
+    int m_maxImageSize = 4096;
+    qint64 m_maxCacheBytes = 64 * 1024 * 1024;
+    qreal m_placeholderSize = 4;
+    QColor m_placeholderColor = QColor(200, 200, 200);
+};
+
+// Implementation.
+
+inline QSharedPointer<ResvgSharedTree> ResvgSharedTree::load(const QString &filePath)
+{
+    static QHash<QString, QWeakPointer<ResvgSharedTree>> cache;
+
+    auto tree = cache.value(filePath).toStrongRef();
+    if (tree) {
+        return tree;
+    }
+
+    tree = QSharedPointer<ResvgSharedTree>(new ResvgSharedTree());
+    tree->m_renderer.load(filePath);
+    tree->m_viewBox = tree->m_renderer.viewBoxF();
+
+    // Remove expired entries.
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (it.value().isNull()) {
+            it = cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    cache.insert(filePath, tree);
+    return tree;
+}
+
+inline QSharedPointer<ResvgSharedTree> ResvgSharedTree::fromData(const QByteArray &data)
+{
+    QSharedPointer<ResvgSharedTree> tree(new ResvgSharedTree());
+    tree->m_renderer.load(data);
+    tree->m_viewBox = tree->m_renderer.viewBoxF();
+    return tree;
+}
+
+inline QImage ResvgSharedTree::render(const QSize &size, qreal dpr) const
+{
+    QImage img(size, QImage::Format_ARGB32_Premultiplied);
+    if (img.isNull()) {
+        return img;
+    }
+
+    img.fill(Qt::transparent);
+
+    {
+        QMutexLocker lock(&m_mutex);
+        QPainter p(&img);
+        const_cast<ResvgRenderer&>(m_renderer).render(&p);
+    }
+
+    img.setDevicePixelRatio(dpr);
+    return img;
+}
+
+inline ResvgGraphicsItem::ResvgGraphicsItem(const QString &filePath, QGraphicsItem *parent)
+    : ResvgGraphicsItem(ResvgSharedTree::load(filePath), parent)
+{
+}
+
+inline ResvgGraphicsItem::ResvgGraphicsItem(const QSharedPointer<ResvgSharedTree> &tree,
+                                            QGraphicsItem *parent)
+    : QGraphicsItem(parent)
+    , m_tree(tree)
+    , m_proxy(new ResvgPrivate::ItemProxy(), &QObject::deleteLater)
+{
+    m_proxy->item = this;
+}
+
+inline ResvgGraphicsItem::~ResvgGraphicsItem()
+{
+    m_proxy->item = nullptr;
+}
+
+inline QRectF ResvgGraphicsItem::boundingRect() const
+{
+    return QRectF(QPointF(0, 0), m_tree->viewBox().size());
+}
+
+inline void ResvgGraphicsItem::paint(QPainter *p, const QStyleOptionGraphicsItem *option,
+                                     QWidget *)
+{
+    if (!m_tree->isValid()) {
+        return;
+    }
+
+    const auto rect = boundingRect();
+    const qreal lod = option->levelOfDetailFromTransform(p->worldTransform());
+    const qreal dpr = p->device() ? p->device()->devicePixelRatioF() : 1.0;
+
+    const QSizeF deviceSize = rect.size() * lod * dpr;
+    if (deviceSize.width() < m_placeholderSize && deviceSize.height() < m_placeholderSize) {
+        p->fillRect(rect, m_placeholderColor);
+        return;
+    }
+
+    const int level = qBound(MinLevel, qCeil(std::log2(lod)), MaxLevel);
+
+    // Cached images are up to twice as large as the item on screen,
+    // so they are downscaled as well.
+    p->save();
+    p->setRenderHint(QPainter::SmoothPixmapTransform);
+
+    const auto cached = m_cache.find(level);
+    if (cached != m_cache.end()) {
+        p->drawImage(rect, cached.value());
+        p->restore();
+        return;
+    }
+
+    if (!m_failedLevels.contains(level)) {
+        requestRender(level, levelSize(level, dpr), dpr);
+    }
+
+    if (const QImage *img = nearestImage(level)) {
+        p->drawImage(rect, *img);
+    } else {
+        p->fillRect(rect, m_placeholderColor);
+    }
+
+    p->restore();
+}
+
+inline QSize ResvgGraphicsItem::levelSize(int level, qreal dpr) const
+{
+    QSizeF size = boundingRect().size() * std::pow(2.0, level) * dpr;
+
+    // Huge items are rendered at a lower resolution and upscaled.
+    if (size.width() > m_maxImageSize || size.height() > m_maxImageSize) {
+        size.scale(m_maxImageSize, m_maxImageSize, Qt::KeepAspectRatio);
+    }
+
+    return size.toSize();
+}
+
+inline void ResvgGraphicsItem::requestRender(int level, const QSize &size, qreal dpr)
+{
+    // Only the latest level is rendered. Requests for other levels are ignored
+    // until the current one is finished.
+    if (m_pendingLevel >= MinLevel || size.isEmpty()) {
+        return;
+    }
+
+    m_pendingLevel = level;
+
+    auto tree = m_tree;
+    auto proxy = m_proxy;
+    auto job = [tree, proxy, level, size, dpr]() {
+        const QImage img = tree->render(size, dpr);
+
+        QMetaObject::invokeMethod(proxy.data(), [proxy, level, img]() {
+            if (proxy->item) {
+                static_cast<ResvgGraphicsItem*>(proxy->item)->onRendered(level, img);
+            }
+        }, Qt::QueuedConnection);
+    };
+
+    QThreadPool::globalInstance()->start(new ResvgPrivate::RenderJob<decltype(job)>(job));
+}
+
+inline void ResvgGraphicsItem::onRendered(int level, const QImage &img)
+{
+    m_pendingLevel = MinLevel - 1;
+
+    if (img.isNull()) {
+        // Usually, not enough memory. Use the nearest level instead.
+        m_failedLevels.insert(level);
+        update();
+        return;
+    }
+
+    m_cacheBytes -= imageBytes(m_cache.value(level));
+    m_cacheBytes += imageBytes(img);
+    m_cache.insert(level, img);
+    m_cacheOrder.removeAll(level);
+    m_cacheOrder.append(level);
+
+    while (m_cacheOrder.size() > MaxCachedLevels
+           || (m_cacheOrder.size() > 1 && m_cacheBytes > m_maxCacheBytes))
+    {
+        m_cacheBytes -= imageBytes(m_cache.take(m_cacheOrder.takeFirst()));
+    }
+
+    update();
+}
+
+inline const QImage* ResvgGraphicsItem::nearestImage(int level) const
+{
+    const QImage *img = nullptr;
+    int distance = 0;
+    for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+        const int d = qAbs(it.key() - level);
+        if (!img || d < distance) {
+            img = &it.value();
+            distance = d;
+        }
+    }
+
+    return img;
+}
+
+#endif // RESVGGRAPHICSITEM_H
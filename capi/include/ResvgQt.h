@@ -199,6 +199,10 @@ public:
 
     /**
      * @brief Renders the SVG data to canvas.
+     *
+     * When the painter device is a \b QImage, the image is rendered directly
+     * into its pixels, so there is no need to use #resvg_qt_render_to_buffer,
+     * which copies the data to an intermediate image and back.
      */
     void render(QPainter *p);
 
@@ -224,8 +228,6 @@ public:
      *
      * Use it if you want to see any warnings.
      *
-     * Must be called only once.
-     *
      * All warnings will be printed to the \b stderr.
      */
     static void initLog();
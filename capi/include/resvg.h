@@ -66,6 +66,33 @@ typedef enum resvg_error {
     RESVG_ERROR_NO_CANVAS,
 } resvg_error;
 
+/**
+ * @brief Log levels.
+ */
+typedef enum resvg_log_level {
+    RESVG_LOG_OFF = 0, /**< Logging is disabled. */
+    RESVG_LOG_ERROR, /**< Errors only. */
+    RESVG_LOG_WARN, /**< Warnings and errors. */
+    RESVG_LOG_INFO, /**< Info messages and above. */
+    RESVG_LOG_DEBUG, /**< Debug messages and above. */
+    RESVG_LOG_TRACE, /**< All messages. */
+} resvg_log_level;
+
+/**
+ * @brief A log callback.
+ *
+ * @param level Message level.
+ * @param target Message source module. UTF-8 string.
+ * @param line Message source line.
+ * @param message Message. UTF-8 string.
+ * @param ctx User data passed to #resvg_set_log_callback.
+ */
+typedef void (*resvg_log_callback)(resvg_log_level level,
+                                   const char *target,
+                                   uint32_t line,
+                                   const char *message,
+                                   void *ctx);
+
 /**
  * @brief An RGB color representation.
  */
@@ -118,6 +145,73 @@ typedef struct resvg_options {
      * groups with \b id attribute will not be removed.
      */
     bool keep_named_groups;
+    /**
+     * A directory for slow render diagnostic bundles.
+     *
+     * When parsing or rendering exceeds one of the capture thresholds,
+     * the input data, options, timings, rendering statistics and the preprocessed
+     * tree will be saved to a new subdirectory.
+     *
+     * Capture settings are taken from the options passed to the parsing function.
+     *
+     * Default: NULL, which disables capturing.
+     */
+    const char *capture_dir;
+    /**
+     * Capture threshold for a single phase in milliseconds.
+     *
+     * 0 disables the check. Default: 1000.
+     */
+    uint32_t capture_time;
+    /**
+     * Capture threshold for the memory allocated for layers and patterns in megabytes.
+     *
+     * 0 disables the check. Default: 0.
+     */
+    uint32_t capture_memory;
+    /**
+     * Skip elements that are fully covered by later opaque rectangles.
+     *
+     * Doesn't affect the result. Useful for documents with stacked layers,
+     * like dashboards and maps.
+     *
+     * Default: false.
+     */
+    bool occlusion_culling;
+    /**
+     * Reuse clip path and mask layers between renders.
+     *
+     * Useful when the same tree is rendered repeatedly using the same transform,
+     * like during UI repaints. Cached layers are invalidated automatically
+     * when the tree is modified. The cache is per thread.
+     *
+     * Cached layers hold references to their clip path and mask elements,
+     * so those elements are kept in memory after #resvg_tree_destroy
+     * until they are evicted or #resvg_clear_coverage_cache is called.
+     *
+     * Default: false.
+     */
+    bool coverage_cache;
+    /**
+     * Number of threads used to decode raster images before rendering.
+     *
+     * Doesn't affect the result. Supported only by the cairo backend.
+     *
+     * Threads are spawned on each render. All decoded images are kept in memory
+     * until the rendering is finished, which increases the peak memory usage.
+     *
+     * Default: 1.
+     */
+    uint32_t decoding_threads;
+    /**
+     * Renders only the content bounds.
+     *
+     * Affects only \b resvg_*_render_to_image functions.
+     * The rendered region can be retrieved via \b resvg_*_get_trim_region.
+     *
+     * Default: false.
+     */
+    bool trim;
 } resvg_options;
 
 /**
@@ -150,6 +244,26 @@ typedef struct resvg_transform {
     double f; /**< \b f value */
 } resvg_transform;
 
+/**
+ * @brief Rendering statistics.
+ *
+ * See #resvg_get_render_stats.
+ */
+typedef struct resvg_render_stats {
+    /** Number of allocated layers. */
+    uint32_t layers;
+    /** Number of rendered pattern tiles. */
+    uint32_t patterns;
+    /** Amount of memory allocated for layers and pattern tiles, in bytes. */
+    uint64_t surfaces_size;
+    /** Number of nodes skipped by occlusion culling. */
+    uint32_t culled_nodes;
+    /** Number of clip path and mask layers reused from the coverage cache. */
+    uint32_t coverage_cache_hits;
+    /** Number of clip path and mask layers that were not found in the coverage cache. */
+    uint32_t coverage_cache_misses;
+} resvg_render_stats;
+
 /**
  * @brief Initializes the library.
  *
@@ -171,12 +285,35 @@ void resvg_destroy(resvg_handle *handle);
  *
  * Use it if you want to see any warnings.
  *
- * Must be called only once.
- *
  * All warnings will be printed to the \b stderr.
+ *
+ * Same as #resvg_set_log_callback with the \b stderr printer and #RESVG_LOG_WARN.
  */
 void resvg_init_log();
 
+/**
+ * @brief Sets the log callback.
+ *
+ * Can be called multiple times. The previous callback is replaced.
+ *
+ * Messages above \b level are discarded before formatting.
+ * Each message kind, i.e. the same source location, is limited
+ * to 10 messages per second. The number of suppressed messages
+ * is reported when the limit is lifted.
+ *
+ * The callback can be called from any thread that renders,
+ * so it must be thread-safe.
+ *
+ * Does nothing if the application has installed a Rust logger already.
+ *
+ * @param level Maximum log level.
+ * @param callback Log callback. NULL disables logging.
+ * @param ctx User data passed to the callback.
+ */
+void resvg_set_log_callback(resvg_log_level level,
+                            resvg_log_callback callback,
+                            void *ctx);
+
 /**
  * @brief Initializes the #resvg_options structure.
  */
@@ -187,6 +324,8 @@ void resvg_init_options(resvg_options *opt);
  *
  * .svg and .svgz files are supported.
  *
+ * Gradients with uniform stops are replaced with a solid color during parsing.
+ *
  * See #resvg_is_image_empty for details.
  *
  * @param file_path UTF-8 file path.
@@ -201,6 +340,8 @@ int resvg_parse_tree_from_file(const char *file_path,
 /**
  * @brief Creates #resvg_render_tree from data.
  *
+ * Gradients with uniform stops are replaced with a solid color during parsing.
+ *
  * See #resvg_is_image_empty for details.
  *
  * @param data SVG data. Can contain SVG string or gzip compressed data.
@@ -214,6 +355,47 @@ int resvg_parse_tree_from_data(const char *data,
                                const resvg_options *opt,
                                resvg_render_tree **tree);
 
+/**
+ * @brief Creates a copy of the #resvg_render_tree.
+ *
+ * The copy is independent from the original tree and can outlive it.
+ *
+ * Much faster than parsing the same data again, since the tree
+ * is already preprocessed, but still requires a copy of each node.
+ *
+ * @param tree Render tree.
+ * @return A new render tree. Should be destroyed via #resvg_tree_destroy.
+ */
+resvg_render_tree* resvg_tree_clone(const resvg_render_tree *tree);
+
+/**
+ * @brief Replaces simple clip paths with the clipped geometry.
+ *
+ * Groups that are clipped by a single convex polygon, like a rectangle,
+ * and contain only paths with a solid fill and without curves and strokes
+ * will be rendered without a clip layer.
+ *
+ * The result may have slightly different antialiasing along the clip edges.
+ *
+ * @param tree Render tree.
+ * @return Number of baked clip paths.
+ */
+uint32_t resvg_bake_clip_paths(resvg_render_tree *tree);
+
+/**
+ * @brief Replaces effects that cover the whole content with their cheap equivalents.
+ *
+ * Clip paths and masks with a single rectangle that covers the group content
+ * are removed or replaced with the group opacity. Patterns fully covered
+ * by a single solid rectangle are replaced with a color.
+ *
+ * The result may have slightly different antialiasing along the content edges.
+ *
+ * @param tree Render tree.
+ * @return Number of simplified references.
+ */
+uint32_t resvg_simplify_covering_effects(resvg_render_tree *tree);
+
 /**
  * @brief Checks that tree has any nodes.
  *
@@ -267,10 +449,36 @@ bool resvg_get_node_transform(const resvg_render_tree *tree,
 /**
  * @brief Destroys the #resvg_render_tree.
  *
+ * Clip paths and masks referenced by the coverage cache are freed
+ * only by #resvg_clear_coverage_cache or when evicted.
+ *
  * @param tree Render tree.
  */
 void resvg_tree_destroy(resvg_render_tree *tree);
 
+/**
+ * @brief Frees clip path and mask layers cached by the current thread.
+ *
+ * See #resvg_options::coverage_cache.
+ */
+void resvg_clear_coverage_cache();
+
+/**
+ * @brief Resets rendering statistics of the current thread.
+ *
+ * Statistics are accumulated until reset.
+ */
+void resvg_reset_render_stats();
+
+/**
+ * @brief Returns rendering statistics of the current thread.
+ *
+ * Must be called from the same thread that did the rendering.
+ *
+ * @param stats Statistics.
+ */
+void resvg_get_render_stats(resvg_render_stats *stats);
+
 
 #ifdef RESVG_CAIRO_BACKEND
 /**
@@ -289,6 +497,21 @@ bool resvg_cairo_get_node_bbox(const resvg_render_tree *tree,
                                const char *id,
                                resvg_rect *bbox);
 
+/**
+ * @brief Returns the region rendered when #resvg_options::trim is set.
+ *
+ * The region is in the full image pixels and contains all rendered pixels,
+ * including stroke joins and caps.
+ *
+ * @param tree Render tree.
+ * @param opt Rendering options.
+ * @param region Rendered region.
+ * @return \b false if the image has no visible content.
+ */
+bool resvg_cairo_get_trim_region(const resvg_render_tree *tree,
+                                 const resvg_options *opt,
+                                 resvg_rect *region);
+
 /**
  * @brief Renders the #resvg_render_tree to file.
  *
@@ -314,6 +537,28 @@ void resvg_cairo_render_to_canvas(const resvg_render_tree *tree,
                                   resvg_size size,
                                   cairo_t *cr);
 
+/**
+ * @brief Renders the #resvg_render_tree to a raw buffer.
+ *
+ * The buffer must contain premultiplied ARGB32 pixels in the native byte order,
+ * which is the same as \b CAIRO_FORMAT_ARGB32 and \b QImage::Format_ARGB32_Premultiplied.
+ *
+ * The image is drawn over the existing buffer content without copying.
+ *
+ * @param tree Render tree.
+ * @param opt Rendering options.
+ * @param size Buffer size.
+ * @param stride Buffer row length in bytes. Must be >= size.width * 4.
+ * @param buffer Pixels buffer. Must be at least stride * size.height bytes long.
+ * @return #resvg_error. #RESVG_ERROR_NO_CANVAS when \b stride is too small
+ *         or the buffer size overflows.
+ */
+int resvg_cairo_render_to_buffer(const resvg_render_tree *tree,
+                                 const resvg_options *opt,
+                                 resvg_size size,
+                                 uint32_t stride,
+                                 uint8_t *buffer);
+
 /**
  * @brief Renders a Node by ID to canvas.
  *
@@ -348,6 +593,21 @@ bool resvg_qt_get_node_bbox(const resvg_render_tree *tree,
                             const char *id,
                             resvg_rect *bbox);
 
+/**
+ * @brief Returns the region rendered when #resvg_options::trim is set.
+ *
+ * The region is in the full image pixels and contains all rendered pixels,
+ * including stroke joins and caps.
+ *
+ * @param tree Render tree.
+ * @param opt Rendering options.
+ * @param region Rendered region.
+ * @return \b false if the image has no visible content.
+ */
+bool resvg_qt_get_trim_region(const resvg_render_tree *tree,
+                              const resvg_options *opt,
+                              resvg_rect *region);
+
 /**
  * @brief Renders the #resvg_render_tree to file.
  *
@@ -373,6 +633,26 @@ void resvg_qt_render_to_canvas(const resvg_render_tree *tree,
                                resvg_size size,
                                void *painter);
 
+/**
+ * @brief Renders the #resvg_render_tree to a raw buffer.
+ *
+ * Same as #resvg_cairo_render_to_buffer, but the buffer content
+ * is copied to an intermediate image and back.
+ *
+ * @param tree Render tree.
+ * @param opt Rendering options.
+ * @param size Buffer size.
+ * @param stride Buffer row length in bytes. Must be >= size.width * 4.
+ * @param buffer Pixels buffer. Must be at least stride * size.height bytes long.
+ * @return #resvg_error. #RESVG_ERROR_NO_CANVAS when \b stride is too small
+ *         or the buffer size overflows.
+ */
+int resvg_qt_render_to_buffer(const resvg_render_tree *tree,
+                              const resvg_options *opt,
+                              resvg_size size,
+                              uint32_t stride,
+                              uint8_t *buffer);
+
 /**
  * @brief Renders a Node by ID to canvas.
  *
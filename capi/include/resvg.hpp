@@ -0,0 +1,561 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * @file resvg.hpp
+ *
+ * C++17 wrapper for resvg C-API without Qt dependency.
+ *
+ * Define \b RESVG_CAIRO_BACKEND or \b RESVG_QT_BACKEND before including
+ * this header to enable the rendering methods.
+ *
+ * The wrapper itself doesn't allocate, except for IDs longer
+ * than #resvg::MaxStackIdLength and the option strings.
+ */
+
+#ifndef RESVG_HPP
+#define RESVG_HPP
+
+extern "C" {
+#include <resvg.h>
+}
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#if __cplusplus > 201703L && __has_include(<span>)
+#include <span>
+#endif
+
+namespace resvg {
+
+/**
+ * @brief Errors that map #resvg_error.
+ */
+enum class Error {
+    NotAnUtf8Str = RESVG_ERROR_NOT_AN_UTF8_STR,
+    FileOpenFailed = RESVG_ERROR_FILE_OPEN_FAILED,
+    FileWriteFailed = RESVG_ERROR_FILE_WRITE_FAILED,
+    InvalidFileSuffix = RESVG_ERROR_INVALID_FILE_SUFFIX,
+    MalformedGZip = RESVG_ERROR_MALFORMED_GZIP,
+    ParsingFailed = RESVG_ERROR_PARSING_FAILED,
+    NoCanvas = RESVG_ERROR_NO_CANVAS,
+};
+
+/**
+ * @brief Returns an error description.
+ */
+inline const char* errorToString(Error err)
+{
+    switch (err) {
+        case Error::NotAnUtf8Str : return "The SVG content has not an UTF-8 encoding.";
+        case Error::FileOpenFailed : return "Failed to open the file.";
+        case Error::FileWriteFailed : return "Failed to write to the file.";
+        case Error::InvalidFileSuffix : return "Invalid file suffix.";
+        case Error::MalformedGZip : return "Not a GZip compressed data.";
+        case Error::ParsingFailed : return "Failed to parse an SVG data.";
+        case Error::NoCanvas : return "Failed to allocate the canvas.";
+    }
+
+    return "";
+}
+
+/**
+ * @brief A \b std::expected like result type.
+ */
+template<typename T>
+class [[nodiscard]] Result
+{
+public:
+    Result(T &&value) : m_d(std::move(value)) {}
+    Result(Error err) : m_d(err) {}
+
+    /**
+     * @brief Returns \b true if the result contains a value.
+     */
+    bool hasValue() const { return m_d.index() == 0; }
+    explicit operator bool() const { return hasValue(); }
+
+    /**
+     * @brief Returns the value. Must be called only when #hasValue is \b true.
+     */
+    T& value() & { assert(hasValue()); return std::get<0>(m_d); }
+    const T& value() const & { assert(hasValue()); return std::get<0>(m_d); }
+    T&& value() && { assert(hasValue()); return std::get<0>(std::move(m_d)); }
+
+    T& operator*() & { return value(); }
+    const T& operator*() const & { return value(); }
+    T* operator->() { return &value(); }
+    const T* operator->() const { return &value(); }
+
+    /**
+     * @brief Returns the error. Must be called only when #hasValue is \b false.
+     */
+    Error error() const { assert(!hasValue()); return std::get<1>(m_d); }
+
+private:
+    std::variant<T, Error> m_d;
+};
+
+/**
+ * @brief A \b std::expected like result type without a value.
+ */
+template<>
+class [[nodiscard]] Result<void>
+{
+public:
+    Result() = default;
+    Result(Error err) : m_err(err) {}
+
+    bool hasValue() const { return !m_err; }
+    explicit operator bool() const { return hasValue(); }
+    Error error() const { assert(m_err); return *m_err; }
+
+private:
+    std::optional<Error> m_err;
+};
+
+namespace detail {
+
+inline Result<void> toResult(int err)
+{
+    if (err == RESVG_OK) {
+        return {};
+    }
+
+    return static_cast<Error>(err);
+}
+
+} // detail
+
+#if __cplusplus > 201703L && __has_include(<span>)
+/**
+ * @brief A mutable bytes view.
+ */
+using ByteSpan = std::span<uint8_t>;
+#else
+/**
+ * @brief A mutable bytes view.
+ *
+ * A minimal \b std::span replacement for C++17.
+ */
+class ByteSpan
+{
+public:
+    constexpr ByteSpan() = default;
+    constexpr ByteSpan(uint8_t *data, size_t size) : m_data(data), m_size(size) {}
+
+    constexpr uint8_t* data() const { return m_data; }
+    constexpr size_t size() const { return m_size; }
+
+private:
+    uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+};
+#endif
+
+/**
+ * @brief IDs up to this length will be converted to C strings without allocation.
+ */
+constexpr size_t MaxStackIdLength = 255;
+
+namespace detail {
+
+/**
+ * @brief Converts \b std::string_view to a null-terminated string.
+ *
+ * Uses a stack buffer for short strings.
+ */
+class CStr
+{
+public:
+    explicit CStr(std::string_view s)
+    {
+        if (s.size() <= MaxStackIdLength) {
+            std::memcpy(m_buf, s.data(), s.size());
+            m_buf[s.size()] = '\0';
+            m_ptr = m_buf;
+        } else {
+            m_heap.assign(s.data(), s.size());
+            m_ptr = m_heap.c_str();
+        }
+    }
+
+    CStr(const CStr&) = delete;
+    CStr& operator=(const CStr&) = delete;
+
+    const char* get() const { return m_ptr; }
+
+private:
+    char m_buf[MaxStackIdLength + 1];
+    std::string m_heap;
+    const char *m_ptr;
+};
+
+} // detail
+
+/**
+ * @brief The global library handle.
+ *
+ * See #resvg_handle for details.
+ */
+class Handle
+{
+public:
+    Handle() : m_d(resvg_init()) {}
+    ~Handle() { if (m_d) resvg_destroy(m_d); }
+
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+
+    Handle(Handle &&other) noexcept : m_d(std::exchange(other.m_d, nullptr)) {}
+    Handle& operator=(Handle &&other) noexcept
+    {
+        std::swap(m_d, other.m_d);
+        return *this;
+    }
+
+private:
+    resvg_handle *m_d;
+};
+
+/**
+ * @brief Rendering options.
+ *
+ * Owns the path and the capture directory strings.
+ */
+class Options
+{
+public:
+    /**
+     * @brief Creates options with default values.
+     */
+    Options() { resvg_init_options(&m_opt); }
+
+    Options(const Options&) = delete;
+    Options& operator=(const Options&) = delete;
+    Options(Options&&) = default;
+    Options& operator=(Options&&) = default;
+
+    /**
+     * @brief Sets an SVG image path. Used to resolve relative image paths.
+     */
+    void setPath(std::string_view path) { m_path.assign(path.data(), path.size()); }
+
+    /**
+     * @brief Sets an output DPI.
+     */
+    void setDpi(double dpi) { m_opt.dpi = dpi; }
+
+    /**
+     * @brief Sets a "fit to" property.
+     */
+    void setFitTo(resvg_fit_to_type type, float value) { m_opt.fit_to = { type, value }; }
+
+    /**
+     * @brief Sets a background color.
+     */
+    void setBackground(resvg_color color)
+    {
+        m_opt.draw_background = true;
+        m_opt.background = color;
+    }
+
+    /**
+     * @brief Keeps all non-empty groups with an \b id attribute.
+     */
+    void setKeepNamedGroups(bool keep) { m_opt.keep_named_groups = keep; }
+
+    /**
+     * @brief Skips elements that are fully covered by later opaque rectangles.
+     */
+    void setOcclusionCulling(bool flag) { m_opt.occlusion_culling = flag; }
+
+    /**
+     * @brief Reuses clip path and mask layers between renders.
+     *
+     * The cache is per thread and can be freed via resvg_clear_coverage_cache().
+     */
+    void setCoverageCache(bool flag) { m_opt.coverage_cache = flag; }
+
+    /**
+     * @brief Sets the number of threads used to decode raster images.
+     *
+     * Supported only by the cairo backend.
+     */
+    void setDecodingThreads(uint32_t count) { m_opt.decoding_threads = count; }
+
+    /**
+     * @brief Renders only the content bounds in Tree::renderToFile.
+     *
+     * See Tree::trimRegion.
+     */
+    void setTrim(bool flag) { m_opt.trim = flag; }
+
+    /**
+     * @brief Enables the slow render capture.
+     *
+     * See #resvg_options::capture_dir for details.
+     */
+    void setCapture(std::string_view dir, uint32_t timeMs, uint32_t memoryMb)
+    {
+        m_captureDir.assign(dir.data(), dir.size());
+        m_opt.capture_time = timeMs;
+        m_opt.capture_memory = memoryMb;
+    }
+
+    /**
+     * @brief Returns the C options.
+     *
+     * Valid until options are modified or destroyed.
+     */
+    resvg_options native() const
+    {
+        // Pointers are set on each call, since strings can be moved.
+        auto opt = m_opt;
+        opt.path = m_path.empty() ? nullptr : m_path.c_str();
+        opt.capture_dir = m_captureDir.empty() ? nullptr : m_captureDir.c_str();
+        return opt;
+    }
+
+private:
+    resvg_options m_opt;
+    std::string m_path;
+    std::string m_captureDir;
+};
+
+/**
+ * @brief A move-only render tree.
+ */
+class Tree
+{
+public:
+    Tree(const Tree&) = delete;
+    Tree& operator=(const Tree&) = delete;
+
+    Tree(Tree &&other) noexcept : m_d(std::exchange(other.m_d, nullptr)) {}
+    Tree& operator=(Tree &&other) noexcept
+    {
+        std::swap(m_d, other.m_d);
+        return *this;
+    }
+
+    ~Tree() { if (m_d) resvg_tree_destroy(m_d); }
+
+    /**
+     * @brief Parses an SVG(Z) file.
+     *
+     * \b path must be a null-terminated UTF-8 string.
+     */
+    static Result<Tree> fromFile(const char *path, const Options &opt)
+    {
+        const auto nopt = opt.native();
+        resvg_render_tree *tree = nullptr;
+        const auto err = resvg_parse_tree_from_file(path, &nopt, &tree);
+        if (err != RESVG_OK) {
+            return static_cast<Error>(err);
+        }
+
+        return Tree(tree);
+    }
+
+    /**
+     * @brief Parses an SVG(Z) data.
+     */
+    static Result<Tree> fromData(std::string_view data, const Options &opt)
+    {
+        const auto nopt = opt.native();
+        resvg_render_tree *tree = nullptr;
+        const auto err = resvg_parse_tree_from_data(data.data(), data.size(), &nopt, &tree);
+        if (err != RESVG_OK) {
+            return static_cast<Error>(err);
+        }
+
+        return Tree(tree);
+    }
+
+    /**
+     * @brief Returns a deep copy of the tree.
+     *
+     * See #resvg_tree_clone for details.
+     */
+    Tree clone() const { return Tree(resvg_tree_clone(m_d)); }
+
+    /**
+     * @brief Replaces simple clip paths with the clipped geometry.
+     *
+     * See #resvg_bake_clip_paths for details.
+     */
+    uint32_t bakeClipPaths() { return resvg_bake_clip_paths(m_d); }
+
+    /**
+     * @brief Replaces effects that cover the whole content with their cheap equivalents.
+     *
+     * See #resvg_simplify_covering_effects for details.
+     */
+    uint32_t simplifyCoveringEffects() { return resvg_simplify_covering_effects(m_d); }
+
+    /**
+     * @brief Checks that the tree has any nodes.
+     */
+    bool isEmpty() const { return !resvg_is_image_empty(m_d); }
+
+    /**
+     * @brief Returns an image size.
+     */
+    resvg_size size() const { return resvg_get_image_size(m_d); }
+
+    /**
+     * @brief Returns an image viewbox.
+     */
+    resvg_rect viewBox() const { return resvg_get_image_viewbox(m_d); }
+
+    /**
+     * @brief Returns \b true if a renderable node with such an ID exists.
+     */
+    bool nodeExists(std::string_view id) const
+    {
+        const detail::CStr rawId(id);
+        return resvg_node_exists(m_d, rawId.get());
+    }
+
+    /**
+     * @brief Returns node's transform by ID.
+     */
+    std::optional<resvg_transform> nodeTransform(std::string_view id) const
+    {
+        const detail::CStr rawId(id);
+        resvg_transform ts;
+        if (resvg_get_node_transform(m_d, rawId.get(), &ts)) {
+            return ts;
+        }
+
+        return std::nullopt;
+    }
+
+#if defined(RESVG_CAIRO_BACKEND) || defined(RESVG_QT_BACKEND)
+    /**
+     * @brief Returns node's bounding box by ID.
+     */
+    std::optional<resvg_rect> nodeBBox(const Options &opt, std::string_view id) const
+    {
+        const auto nopt = opt.native();
+        const detail::CStr rawId(id);
+        resvg_rect bbox;
+#ifdef RESVG_CAIRO_BACKEND
+        const bool ok = resvg_cairo_get_node_bbox(m_d, &nopt, rawId.get(), &bbox);
+#else
+        const bool ok = resvg_qt_get_node_bbox(m_d, &nopt, rawId.get(), &bbox);
+#endif
+        if (ok) {
+            return bbox;
+        }
+
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Returns the region rendered when Options::setTrim is set.
+     *
+     * Returns \b std::nullopt if the image has no visible content.
+     */
+    std::optional<resvg_rect> trimRegion(const Options &opt) const
+    {
+        const auto nopt = opt.native();
+        resvg_rect region;
+#ifdef RESVG_CAIRO_BACKEND
+        const bool ok = resvg_cairo_get_trim_region(m_d, &nopt, &region);
+#else
+        const bool ok = resvg_qt_get_trim_region(m_d, &nopt, &region);
+#endif
+        if (ok) {
+            return region;
+        }
+
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Renders the tree to a raw buffer.
+     *
+     * The buffer must contain premultiplied ARGB32 pixels in the native byte order.
+     * The image is drawn over the existing buffer content.
+     *
+     * @param stride Row length in bytes. Zero means \b size.width * 4.
+     */
+    Result<void> renderToBuffer(const Options &opt, resvg_size size,
+                                ByteSpan buffer, uint32_t stride = 0) const
+    {
+        // Computed in 64 bits, so a large width cannot wrap around.
+        const uint64_t rowLen = uint64_t(size.width) * 4;
+        if (stride == 0) {
+            if (rowLen > UINT32_MAX) {
+                return Error::NoCanvas;
+            }
+
+            stride = uint32_t(rowLen);
+        }
+
+        if (stride < rowLen || uint64_t(buffer.size()) < uint64_t(stride) * size.height) {
+            return Error::NoCanvas;
+        }
+
+        const auto nopt = opt.native();
+#ifdef RESVG_CAIRO_BACKEND
+        return detail::toResult(
+            resvg_cairo_render_to_buffer(m_d, &nopt, size, stride, buffer.data()));
+#else
+        return detail::toResult(
+            resvg_qt_render_to_buffer(m_d, &nopt, size, stride, buffer.data()));
+#endif
+    }
+
+    /**
+     * @brief Renders the tree to a PNG file.
+     *
+     * \b path must be a null-terminated UTF-8 string.
+     */
+    Result<void> renderToFile(const Options &opt, const char *path) const
+    {
+        const auto nopt = opt.native();
+#ifdef RESVG_CAIRO_BACKEND
+        return detail::toResult(resvg_cairo_render_to_image(m_d, &nopt, path));
+#else
+        return detail::toResult(resvg_qt_render_to_image(m_d, &nopt, path));
+#endif
+    }
+#endif
+
+    /**
+     * @brief Returns the underlying C tree.
+     */
+    const resvg_render_tree* native() const { return m_d; }
+
+private:
+    explicit Tree(resvg_render_tree *tree) : m_d(tree) {}
+
+    resvg_render_tree *m_d;
+};
+
+/**
+ * @brief Initializes the library log.
+ *
+ * See #resvg_init_log for details.
+ */
+inline void initLog()
+{
+    resvg_init_log();
+}
+
+} // resvg
+
+#endif // RESVG_HPP
@@ -0,0 +1,154 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::cell::Cell;
+use std::fs;
+use std::io::Read;
+use std::path;
+use std::time::{
+    Duration,
+    Instant,
+};
+
+use resvg;
+use resvg::capture::{
+    Bundle,
+    Thresholds,
+};
+use resvg::usvg;
+
+use super::{
+    cstr_to_str,
+    resvg_options,
+};
+
+
+#[derive(Clone)]
+pub enum Input {
+    Data(Vec<u8>),
+    File(path::PathBuf),
+}
+
+/// Everything we have to remember between parsing and rendering
+/// to write a diagnostic bundle.
+pub struct Source {
+    dir: path::PathBuf,
+    thresholds: Thresholds,
+    input: Input,
+    parse_time: Duration,
+    captured: Cell<bool>,
+}
+
+impl Source {
+    /// Returns `None` when capturing is disabled.
+    pub fn new(opt: &resvg_options, input: Input, parse_time: Duration) -> Option<Self> {
+        if opt.capture_dir.is_null() {
+            return None;
+        }
+
+        let dir = match cstr_to_str(opt.capture_dir) {
+            Some(v) if !v.is_empty() => v,
+            _ => return None,
+        };
+
+        let thresholds = Thresholds {
+            time: if opt.capture_time != 0 {
+                Some(Duration::from_millis(opt.capture_time as u64))
+            } else {
+                None
+            },
+            memory: if opt.capture_memory != 0 {
+                Some(opt.capture_memory as u64 * 1024 * 1024)
+            } else {
+                None
+            },
+        };
+
+        Some(Source {
+            dir: dir.into(),
+            thresholds,
+            input,
+            parse_time,
+            captured: Cell::new(false),
+        })
+    }
+
+    /// Returns a copy for a cloned tree.
+    ///
+    /// The new tree can be captured independently.
+    pub fn clone_for_tree(&self) -> Self {
+        Source {
+            dir: self.dir.clone(),
+            thresholds: self.thresholds,
+            input: self.input.clone(),
+            parse_time: self.parse_time,
+            captured: Cell::new(false),
+        }
+    }
+
+    /// Writes a bundle if parsing alone was too slow.
+    pub fn check_parsing(&self, opt: &resvg::Options, tree: Option<&usvg::Tree>) {
+        let timings = [("Preprocessing", self.parse_time)];
+        self.capture(opt, &timings, resvg::stats::RenderStats::default(), tree);
+    }
+
+    /// Runs the rendering and writes a bundle if it was too slow
+    /// or allocated too much.
+    pub fn render<F, T>(&self, opt: &resvg::Options, tree: &usvg::Tree, f: F) -> T
+        where F: FnOnce() -> T
+    {
+        resvg::stats::reset();
+
+        let start = Instant::now();
+        let res = f();
+        let render_time = start.elapsed();
+
+        let timings = [("Preprocessing", self.parse_time), ("Rendering", render_time)];
+        self.capture(opt, &timings, resvg::stats::get(), Some(tree));
+
+        res
+    }
+
+    fn capture(
+        &self,
+        opt: &resvg::Options,
+        timings: &[(&str, Duration)],
+        stats: resvg::stats::RenderStats,
+        tree: Option<&usvg::Tree>,
+    ) {
+        // Capture each tree only once.
+        if self.captured.get() || !self.thresholds.is_exceeded(timings, &stats) {
+            return;
+        }
+
+        self.captured.set(true);
+
+        let mut file_data = Vec::new();
+        let input = match self.input {
+            Input::Data(ref data) => data.as_slice(),
+            Input::File(ref path) => {
+                if let Ok(mut f) = fs::File::open(path) {
+                    if f.read_to_end(&mut file_data).is_err() {
+                        file_data.clear();
+                    }
+                }
+
+                file_data.as_slice()
+            }
+        };
+
+        let bundle = Bundle {
+            input,
+            opt,
+            timings,
+            stats,
+            tree,
+        };
+
+        match bundle.write(&self.dir) {
+            Ok(path) => warn!("Slow render captured to {:?}.", path),
+            Err(e) => warn!("Failed to write a capture bundle: {}.", e),
+        }
+    }
+}
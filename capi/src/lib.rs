@@ -6,19 +6,21 @@
 
 extern crate resvg;
 #[macro_use] extern crate log;
-extern crate fern;
 
 #[cfg(feature = "cairo-backend")]
 extern crate glib;
 #[cfg(feature = "cairo-backend")]
 extern crate cairo_sys;
 
-use std::fmt;
 use std::path;
 use std::ffi::CStr;
-use std::os::raw::c_char;
+use std::os::raw::{
+    c_char,
+    c_void,
+};
 use std::slice;
 use std::ptr;
+use std::time::Instant;
 
 #[cfg(feature = "qt-backend")]
 use resvg::qt;
@@ -29,6 +31,14 @@ use resvg::cairo;
 use resvg::usvg;
 use usvg::prelude::*;
 
+mod capture;
+mod logger;
+
+pub use logger::{
+    resvg_log_callback,
+    resvg_log_level,
+};
+
 
 #[repr(C)]
 pub struct resvg_options {
@@ -38,6 +48,13 @@ pub struct resvg_options {
     pub draw_background: bool,
     pub background: resvg_color,
     pub keep_named_groups: bool,
+    pub capture_dir: *const c_char,
+    pub capture_time: u32,
+    pub capture_memory: u32,
+    pub occlusion_culling: bool,
+    pub coverage_cache: bool,
+    pub decoding_threads: u32,
+    pub trim: bool,
 }
 
 enum ErrorId {
@@ -97,7 +114,28 @@ pub struct resvg_transform {
 }
 
 #[repr(C)]
-pub struct resvg_render_tree(resvg::usvg::Tree);
+pub struct resvg_render_stats {
+    pub layers: u32,
+    pub patterns: u32,
+    pub surfaces_size: u64,
+    pub culled_nodes: u32,
+    pub coverage_cache_hits: u32,
+    pub coverage_cache_misses: u32,
+}
+
+#[repr(C)]
+pub struct resvg_render_tree(resvg::usvg::Tree, Option<capture::Source>);
+
+impl resvg_render_tree {
+    fn render<F, T>(&self, opt: &resvg::Options, f: F) -> T
+        where F: FnOnce() -> T
+    {
+        match self.1 {
+            Some(ref source) => source.render(opt, &self.0, f),
+            None => f(),
+        }
+    }
+}
 
 #[repr(C)]
 pub struct resvg_handle(resvg::InitObject);
@@ -119,29 +157,16 @@ pub extern fn resvg_destroy(handle: *mut resvg_handle) {
 
 #[no_mangle]
 pub extern fn resvg_init_log() {
-    fern::Dispatch::new()
-        .format(log_format)
-        .level(log::LevelFilter::Warn)
-        .chain(std::io::stderr())
-        .apply().unwrap();
+    logger::set_stderr(resvg_log_level::RESVG_LOG_WARN);
 }
 
-fn log_format(out: fern::FormatCallback, message: &fmt::Arguments, record: &log::Record) {
-    let lvl = match record.level() {
-        log::Level::Error => "Error",
-        log::Level::Warn => "Warning",
-        log::Level::Info => "Info",
-        log::Level::Debug => "Debug",
-        log::Level::Trace => "Trace",
-    };
-
-    out.finish(format_args!(
-        "{} (in {}:{}): {}",
-        lvl,
-        record.target(),
-        record.line().unwrap_or(0),
-        message
-    ))
+#[no_mangle]
+pub extern fn resvg_set_log_callback(
+    level: resvg_log_level,
+    callback: resvg_log_callback,
+    ctx: *mut c_void,
+) {
+    logger::set_callback(level, callback, ctx);
 }
 
 #[no_mangle]
@@ -158,6 +183,13 @@ pub extern fn resvg_init_options(opt: *mut resvg_options) {
         (*opt).background.g = 0;
         (*opt).background.b = 0;
         (*opt).keep_named_groups = false;
+        (*opt).capture_dir = ptr::null();
+        (*opt).capture_time = 1000;
+        (*opt).capture_memory = 0;
+        (*opt).occlusion_culling = false;
+        (*opt).coverage_cache = false;
+        (*opt).decoding_threads = 1;
+        (*opt).trim = false;
     }
 }
 
@@ -172,17 +204,29 @@ pub extern fn resvg_parse_tree_from_file(
         None => return ErrorId::NotAnUtf8Str as i32,
     };
 
-    let opt = to_native_opt(unsafe {
+    let c_opt = unsafe {
         assert!(!opt.is_null());
         &*opt
-    });
+    };
+    let opt = to_native_opt(c_opt);
+
+    let start = Instant::now();
+    let tree = usvg::Tree::from_file(file_path, &opt.usvg);
+    let input = capture::Input::File(file_path.into());
+    let source = capture::Source::new(c_opt, input, start.elapsed());
+
+    if let Some(ref source) = source {
+        source.check_parsing(&opt, tree.as_ref().ok());
+    }
 
-    let tree = match usvg::Tree::from_file(file_path, &opt.usvg) {
+    let tree = match tree {
         Ok(tree) => tree,
         Err(e) => return convert_error(e) as i32,
     };
 
-    let tree_box = Box::new(resvg_render_tree(tree));
+    resvg::passes::simplify_effects(&tree);
+
+    let tree_box = Box::new(resvg_render_tree(tree, source));
     unsafe { *raw_tree = Box::into_raw(tree_box); }
 
     ErrorId::Ok as i32
@@ -197,22 +241,75 @@ pub extern fn resvg_parse_tree_from_data(
 ) -> i32 {
     let data = unsafe { slice::from_raw_parts(data as *const u8, len) };
 
-    let opt = to_native_opt(unsafe {
+    let c_opt = unsafe {
         assert!(!opt.is_null());
         &*opt
-    });
+    };
+    let opt = to_native_opt(c_opt);
+
+    let start = Instant::now();
+    let tree = usvg::Tree::from_data(data, &opt.usvg);
+    let parse_time = start.elapsed();
 
-    let tree = match usvg::Tree::from_data(data, &opt.usvg) {
+    // Copy the input only when capturing is enabled.
+    let source = if c_opt.capture_dir.is_null() {
+        None
+    } else {
+        capture::Source::new(c_opt, capture::Input::Data(data.to_vec()), parse_time)
+    };
+
+    if let Some(ref source) = source {
+        source.check_parsing(&opt, tree.as_ref().ok());
+    }
+
+    let tree = match tree {
         Ok(tree) => tree,
         Err(e) => return convert_error(e) as i32,
     };
 
-    let tree_box = Box::new(resvg_render_tree(tree));
+    resvg::passes::simplify_effects(&tree);
+
+    let tree_box = Box::new(resvg_render_tree(tree, source));
     unsafe { *raw_tree = Box::into_raw(tree_box); }
 
     ErrorId::Ok as i32
 }
 
+#[no_mangle]
+pub extern fn resvg_tree_clone(
+    tree: *const resvg_render_tree,
+) -> *mut resvg_render_tree {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    let new_tree = resvg::utils::clone_tree(&tree.0);
+    let source = tree.1.as_ref().map(|s| s.clone_for_tree());
+
+    Box::into_raw(Box::new(resvg_render_tree(new_tree, source)))
+}
+
+#[no_mangle]
+pub extern fn resvg_bake_clip_paths(tree: *mut resvg_render_tree) -> u32 {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    resvg::passes::bake_clip_paths(&tree.0)
+}
+
+#[no_mangle]
+pub extern fn resvg_simplify_covering_effects(tree: *mut resvg_render_tree) -> u32 {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    resvg::passes::simplify_covering_effects(&tree.0)
+}
+
 #[no_mangle]
 pub extern fn resvg_tree_destroy(tree: *mut resvg_render_tree) {
     unsafe {
@@ -221,6 +318,36 @@ pub extern fn resvg_tree_destroy(tree: *mut resvg_render_tree) {
     };
 }
 
+#[no_mangle]
+pub extern fn resvg_clear_coverage_cache() {
+    #[cfg(feature = "cairo-backend")]
+    resvg::backend_cairo::clear_coverage_cache();
+
+    #[cfg(feature = "qt-backend")]
+    resvg::backend_qt::clear_coverage_cache();
+}
+
+#[no_mangle]
+pub extern fn resvg_reset_render_stats() {
+    resvg::stats::reset();
+}
+
+#[no_mangle]
+pub extern fn resvg_get_render_stats(stats: *mut resvg_render_stats) {
+    let stats = unsafe {
+        assert!(!stats.is_null());
+        &mut *stats
+    };
+
+    let s = resvg::stats::get();
+    stats.layers = s.layers;
+    stats.patterns = s.patterns;
+    stats.surfaces_size = s.surfaces_size;
+    stats.culled_nodes = s.culled_nodes;
+    stats.coverage_cache_hits = s.coverage_cache_hits;
+    stats.coverage_cache_misses = s.coverage_cache_misses;
+}
+
 #[cfg(feature = "qt-backend")]
 #[no_mangle]
 pub extern fn resvg_qt_render_to_image(
@@ -259,12 +386,19 @@ fn render_to_image(
         None => return ErrorId::NotAnUtf8Str as i32,
     };
 
-    let opt = to_native_opt(unsafe {
+    let c_opt = unsafe {
         assert!(!opt.is_null());
         &*opt
-    });
+    };
+    let opt = to_native_opt(c_opt);
 
-    let img = backend.render_to_image(&tree.0, &opt);
+    let img = tree.render(&opt, || {
+        if c_opt.trim {
+            backend.render_trimmed_to_image(&tree.0, &opt).map(|(img, _)| img)
+        } else {
+            backend.render_to_image(&tree.0, &opt)
+        }
+    });
     let img = match img {
         Some(img) => img,
         None => {
@@ -298,7 +432,7 @@ pub extern fn resvg_qt_render_to_canvas(
         &*opt
     });
 
-    resvg::backend_qt::render_to_canvas(&tree.0, &opt, size, &painter);
+    tree.render(&opt, || resvg::backend_qt::render_to_canvas(&tree.0, &opt, size, &painter));
 }
 
 #[cfg(feature = "cairo-backend")]
@@ -324,7 +458,122 @@ pub extern fn resvg_cairo_render_to_canvas(
         &*opt
     });
 
-    resvg::backend_cairo::render_to_canvas(&tree.0, &opt, size, &cr);
+    tree.render(&opt, || resvg::backend_cairo::render_to_canvas(&tree.0, &opt, size, &cr));
+}
+
+#[cfg(feature = "qt-backend")]
+#[no_mangle]
+pub extern fn resvg_qt_render_to_buffer(
+    tree: *const resvg_render_tree,
+    opt: *const resvg_options,
+    size: resvg_size,
+    stride: u32,
+    buffer: *mut u8,
+) -> i32 {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    assert!(!buffer.is_null());
+
+    let buffer_len = match buffer_len(&size, stride) {
+        Some(len) => len,
+        None => return ErrorId::NoCanvas as i32,
+    };
+
+    let size = resvg::ScreenSize::new(size.width, size.height);
+    let opt = to_native_opt(unsafe {
+        assert!(!opt.is_null());
+        &*opt
+    });
+
+    let mut img = match qt::Image::new(size.width, size.height) {
+        Some(img) => img,
+        None => return ErrorId::NoCanvas as i32,
+    };
+    img.set_dpi(opt.usvg.dpi);
+
+    // QImage doesn't support external buffers via the Qt wrapper,
+    // so we have to copy the data in and out.
+    let row_len = (size.width * 4) as usize;
+    let buffer = unsafe { slice::from_raw_parts_mut(buffer, buffer_len) };
+
+    {
+        let mut data = img.data_mut();
+        for (src, dst) in buffer.chunks(stride as usize).zip(data.chunks_mut(row_len)) {
+            dst.copy_from_slice(&src[..row_len]);
+        }
+    }
+
+    {
+        let painter = qt::Painter::new(&img);
+        tree.render(&opt, || resvg::backend_qt::render_to_canvas(&tree.0, &opt, size, &painter));
+        painter.end();
+    }
+
+    let data = img.data_mut();
+    for (dst, src) in buffer.chunks_mut(stride as usize).zip(data.chunks(row_len)) {
+        dst[..row_len].copy_from_slice(src);
+    }
+
+    ErrorId::Ok as i32
+}
+
+#[cfg(feature = "cairo-backend")]
+#[no_mangle]
+pub extern fn resvg_cairo_render_to_buffer(
+    tree: *const resvg_render_tree,
+    opt: *const resvg_options,
+    size: resvg_size,
+    stride: u32,
+    buffer: *mut u8,
+) -> i32 {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    assert!(!buffer.is_null());
+
+    if buffer_len(&size, stride).is_none() {
+        return ErrorId::NoCanvas as i32;
+    }
+
+    use glib::translate::FromGlibPtrFull;
+
+    let opt = to_native_opt(unsafe {
+        assert!(!opt.is_null());
+        &*opt
+    });
+
+    // Draw directly on the caller's buffer.
+    let surface = unsafe {
+        cairo_sys::cairo_image_surface_create_for_data(
+            buffer, cairo::Format::ARgb32,
+            size.width as i32, size.height as i32, stride as i32,
+        )
+    };
+
+    // cairo never returns NULL, but an error surface instead.
+    if unsafe { cairo_sys::cairo_surface_status(surface) } != cairo::Status::Success {
+        unsafe { cairo_sys::cairo_surface_destroy(surface); }
+        return ErrorId::NoCanvas as i32;
+    }
+
+    let size = resvg::ScreenSize::new(size.width, size.height);
+
+    {
+        let cr = unsafe { cairo::Context::from_glib_full(cairo_sys::cairo_create(surface)) };
+        tree.render(&opt, || resvg::backend_cairo::render_to_canvas(&tree.0, &opt, size, &cr));
+    }
+
+    unsafe {
+        cairo_sys::cairo_surface_flush(surface);
+        cairo_sys::cairo_surface_destroy(surface);
+    }
+
+    ErrorId::Ok as i32
 }
 
 #[cfg(feature = "qt-backend")]
@@ -365,7 +614,9 @@ pub extern fn resvg_qt_render_to_canvas_by_id(
                 aspect: usvg::AspectRatio::default(),
             };
 
-            resvg::backend_qt::render_node_to_canvas(&node, &opt, vbox, size, &painter);
+            tree.render(&opt, || {
+                resvg::backend_qt::render_node_to_canvas(&node, &opt, vbox, size, &painter)
+            });
         } else {
             warn!("A node with '{}' ID doesn't have a valid bounding box.", id);
         }
@@ -415,7 +666,9 @@ pub extern fn resvg_cairo_render_to_canvas_by_id(
                 aspect: usvg::AspectRatio::default(),
             };
 
-            resvg::backend_cairo::render_node_to_canvas(&node, &opt, vbox, size, &cr);
+            tree.render(&opt, || {
+                resvg::backend_cairo::render_node_to_canvas(&node, &opt, vbox, size, &cr)
+            });
         } else {
             warn!("A node with '{}' ID doesn't have a valid bounding box.", id);
         }
@@ -549,6 +802,59 @@ fn get_node_bbox(
     }
 }
 
+#[cfg(feature = "qt-backend")]
+#[no_mangle]
+pub extern fn resvg_qt_get_trim_region(
+    tree: *const resvg_render_tree,
+    opt: *const resvg_options,
+    region: *mut resvg_rect,
+) -> bool {
+    let backend = Box::new(resvg::backend_qt::Backend);
+    get_trim_region(tree, opt, region, backend)
+}
+
+#[cfg(feature = "cairo-backend")]
+#[no_mangle]
+pub extern fn resvg_cairo_get_trim_region(
+    tree: *const resvg_render_tree,
+    opt: *const resvg_options,
+    region: *mut resvg_rect,
+) -> bool {
+    let backend = Box::new(resvg::backend_cairo::Backend);
+    get_trim_region(tree, opt, region, backend)
+}
+
+fn get_trim_region(
+    tree: *const resvg_render_tree,
+    opt: *const resvg_options,
+    region: *mut resvg_rect,
+    backend: Box<resvg::Render>,
+) -> bool {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    let opt = to_native_opt(unsafe {
+        assert!(!opt.is_null());
+        &*opt
+    });
+
+    match backend.trim_region(&tree.0, &opt) {
+        Some(r) => {
+            unsafe {
+                (*region).x = r.x as f64;
+                (*region).y = r.y as f64;
+                (*region).width = r.width as f64;
+                (*region).height = r.height as f64;
+            }
+
+            true
+        }
+        None => false,
+    }
+}
+
 #[no_mangle]
 pub extern fn resvg_node_exists(
     tree: *const resvg_render_tree,
@@ -617,6 +923,19 @@ fn cstr_to_str(text: *const c_char) -> Option<&'static str> {
     text.to_str().ok()
 }
 
+/// Returns the raw buffer length in bytes.
+///
+/// Returns `None` when `stride` is smaller than a row
+/// or the length doesn't fit into `usize`.
+fn buffer_len(size: &resvg_size, stride: u32) -> Option<usize> {
+    let row_len = (size.width as usize).checked_mul(4)?;
+    if (stride as usize) < row_len {
+        return None;
+    }
+
+    (stride as usize).checked_mul(size.height as usize)
+}
+
 fn to_native_opt(opt: &resvg_options) -> resvg::Options {
     let mut path: Option<path::PathBuf> = None;
 
@@ -664,6 +983,9 @@ fn to_native_opt(opt: &resvg_options) -> resvg::Options {
         },
         fit_to,
         background,
+        occlusion_culling: opt.occlusion_culling,
+        coverage_cache: opt.coverage_cache,
+        decoding_threads: opt.decoding_threads,
     }
 }
 
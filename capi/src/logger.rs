@@ -0,0 +1,270 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! A logger that forwards messages to a user callback.
+//!
+//! The logger is installed once and only the callback is replaced afterwards,
+//! so it can be reconfigured at any time.
+
+use std::collections::HashMap;
+use std::collections::hash_map::DefaultHasher;
+use std::ffi::CString;
+use std::hash::{
+    Hash,
+    Hasher,
+};
+use std::io::Write;
+use std::os::raw::{
+    c_char,
+    c_void,
+};
+use std::sync::{
+    Mutex,
+    Once,
+    ONCE_INIT,
+};
+use std::time::{
+    Duration,
+    Instant,
+};
+
+use log;
+
+
+/// Maximum number of messages of the same kind per `RATE_WINDOW_SECS`.
+const RATE_LIMIT: u32 = 10;
+const RATE_WINDOW_SECS: u64 = 1;
+/// Prevents unbounded growth when there are a lot of message kinds.
+const MAX_KINDS: usize = 1024;
+
+
+#[repr(C)]
+#[derive(Clone, Copy, PartialEq, Debug)]
+pub enum resvg_log_level {
+    RESVG_LOG_OFF,
+    RESVG_LOG_ERROR,
+    RESVG_LOG_WARN,
+    RESVG_LOG_INFO,
+    RESVG_LOG_DEBUG,
+    RESVG_LOG_TRACE,
+}
+
+impl resvg_log_level {
+    fn to_filter(&self) -> log::LevelFilter {
+        match *self {
+            resvg_log_level::RESVG_LOG_OFF => log::LevelFilter::Off,
+            resvg_log_level::RESVG_LOG_ERROR => log::LevelFilter::Error,
+            resvg_log_level::RESVG_LOG_WARN => log::LevelFilter::Warn,
+            resvg_log_level::RESVG_LOG_INFO => log::LevelFilter::Info,
+            resvg_log_level::RESVG_LOG_DEBUG => log::LevelFilter::Debug,
+            resvg_log_level::RESVG_LOG_TRACE => log::LevelFilter::Trace,
+        }
+    }
+
+    fn from_level(level: log::Level) -> Self {
+        match level {
+            log::Level::Error => resvg_log_level::RESVG_LOG_ERROR,
+            log::Level::Warn => resvg_log_level::RESVG_LOG_WARN,
+            log::Level::Info => resvg_log_level::RESVG_LOG_INFO,
+            log::Level::Debug => resvg_log_level::RESVG_LOG_DEBUG,
+            log::Level::Trace => resvg_log_level::RESVG_LOG_TRACE,
+        }
+    }
+}
+
+pub type resvg_log_callback = Option<extern "C" fn(
+    level: resvg_log_level,
+    target: *const c_char,
+    line: u32,
+    message: *const c_char,
+    ctx: *mut c_void,
+)>;
+
+
+#[derive(Clone, Copy)]
+enum Sink {
+    Stderr,
+    Callback(extern "C" fn(resvg_log_level, *const c_char, u32, *const c_char, *mut c_void),
+             *mut c_void),
+}
+
+// The callback context is owned by the caller, which guarantees
+// that the callback is thread-safe.
+unsafe impl Send for Sink {}
+
+struct Kind {
+    window_start: Instant,
+    count: u32,
+    suppressed: u32,
+}
+
+struct State {
+    /// `false` when the application has its own logger.
+    installed: bool,
+    sink: Option<Sink>,
+    kinds: HashMap<u64, Kind>,
+}
+
+struct CallbackLogger;
+
+static LOGGER: CallbackLogger = CallbackLogger;
+static INIT: Once = ONCE_INIT;
+static mut STATE: *const Mutex<State> = 0 as *const _;
+
+fn state() -> &'static Mutex<State> {
+    unsafe {
+        INIT.call_once(|| {
+            // Fails only when the application has its own logger already.
+            let installed = log::set_logger(&LOGGER).is_ok();
+
+            let state = State {
+                installed,
+                sink: None,
+                kinds: HashMap::new(),
+            };
+            STATE = Box::into_raw(Box::new(Mutex::new(state)));
+        });
+
+        &*STATE
+    }
+}
+
+/// Sets the log sink and the maximum level.
+///
+/// `None` sink disables logging.
+///
+/// Does nothing when the application has its own logger,
+/// since the max level is shared with it.
+fn set_sink(level: resvg_log_level, sink: Option<Sink>) {
+    let mut state = state().lock().unwrap();
+    if !state.installed {
+        return;
+    }
+
+    state.sink = sink;
+    state.kinds.clear();
+
+    // `log` macros check the max level before formatting the message,
+    // so filtered messages are free.
+    if sink.is_some() {
+        log::set_max_level(level.to_filter());
+    } else {
+        log::set_max_level(log::LevelFilter::Off);
+    }
+}
+
+pub fn set_callback(level: resvg_log_level, callback: resvg_log_callback, ctx: *mut c_void) {
+    set_sink(level, callback.map(|f| Sink::Callback(f, ctx)));
+}
+
+pub fn set_stderr(level: resvg_log_level) {
+    set_sink(level, Some(Sink::Stderr));
+}
+
+impl log::Log for CallbackLogger {
+    fn enabled(&self, metadata: &log::Metadata) -> bool {
+        metadata.level() <= log::max_level()
+    }
+
+    fn log(&self, record: &log::Record) {
+        if !self.enabled(record.metadata()) {
+            return;
+        }
+
+        let line = record.line().unwrap_or(0);
+
+        // Check the rate limit before formatting.
+        let (sink, suppressed) = {
+            let mut state = match state().lock() {
+                Ok(v) => v,
+                Err(_) => return,
+            };
+
+            let sink = match state.sink {
+                Some(sink) => sink,
+                None => return,
+            };
+
+            match check_rate(&mut state.kinds, record.target(), line) {
+                Some(suppressed) => (sink, suppressed),
+                None => return,
+            }
+        };
+
+        let level = resvg_log_level::from_level(record.level());
+
+        if suppressed != 0 {
+            let msg = format!("{} similar messages were suppressed.", suppressed);
+            write(sink, level, record.target(), line, &msg);
+        }
+
+        let msg = format!("{}", record.args());
+        write(sink, level, record.target(), line, &msg);
+    }
+
+    fn flush(&self) {}
+}
+
+/// Returns `None` if the message should be dropped,
+/// otherwise a number of messages suppressed during the previous window.
+fn check_rate(kinds: &mut HashMap<u64, Kind>, target: &str, line: u32) -> Option<u32> {
+    let mut hasher = DefaultHasher::new();
+    target.hash(&mut hasher);
+    line.hash(&mut hasher);
+    let key = hasher.finish();
+
+    if kinds.len() >= MAX_KINDS && !kinds.contains_key(&key) {
+        kinds.clear();
+    }
+
+    let now = Instant::now();
+    let kind = kinds.entry(key).or_insert(Kind {
+        window_start: now,
+        count: 0,
+        suppressed: 0,
+    });
+
+    let mut prev_suppressed = 0;
+    if now.duration_since(kind.window_start) >= Duration::from_secs(RATE_WINDOW_SECS) {
+        prev_suppressed = kind.suppressed;
+        kind.window_start = now;
+        kind.count = 0;
+        kind.suppressed = 0;
+    }
+
+    if kind.count >= RATE_LIMIT {
+        kind.suppressed += 1;
+        return None;
+    }
+
+    kind.count += 1;
+    Some(prev_suppressed)
+}
+
+fn write(sink: Sink, level: resvg_log_level, target: &str, line: u32, msg: &str) {
+    match sink {
+        Sink::Stderr => {
+            let lvl = match level {
+                resvg_log_level::RESVG_LOG_ERROR => "Error",
+                resvg_log_level::RESVG_LOG_WARN => "Warning",
+                resvg_log_level::RESVG_LOG_INFO => "Info",
+                resvg_log_level::RESVG_LOG_DEBUG => "Debug",
+                _ => "Trace",
+            };
+
+            let stderr = ::std::io::stderr();
+            let _ = writeln!(stderr.lock(), "{} (in {}:{}): {}", lvl, target, line, msg);
+        }
+        Sink::Callback(f, ctx) => {
+            let target = to_cstring(target);
+            let msg = to_cstring(msg);
+            f(level, target.as_ptr(), line, msg.as_ptr(), ctx);
+        }
+    }
+}
+
+fn to_cstring(s: &str) -> CString {
+    // Interior NUL bytes are not allowed in C strings.
+    CString::new(s).unwrap_or_else(|_| CString::new(s.replace('\0', "")).unwrap_or_default())
+}
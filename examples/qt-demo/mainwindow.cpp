@@ -56,3 +56,18 @@ void MainWindow::on_chBoxDrawBorder_toggled(bool checked)
 {
     ui->svgView->setDrawImageBorder(checked);
 }
+
+void MainWindow::on_chBoxWatchFile_toggled(bool checked)
+{
+    ui->svgView->setWatchFile(checked);
+}
+
+void MainWindow::on_chBoxShowStats_toggled(bool checked)
+{
+    ui->svgView->setShowStats(checked);
+}
+
+void MainWindow::on_chBoxCompareBackends_toggled(bool checked)
+{
+    ui->svgView->setCompareBackends(checked);
+}
@@ -19,6 +19,9 @@ private slots:
     void on_rBtnFitSize_toggled(bool checked);
     void on_cmbBoxBackground_currentIndexChanged(int index);
     void on_chBoxDrawBorder_toggled(bool checked);
+    void on_chBoxWatchFile_toggled(bool checked);
+    void on_chBoxShowStats_toggled(bool checked);
+    void on_chBoxCompareBackends_toggled(bool checked);
     void on_rBtnRenderViaResvg_toggled(bool checked);
 
 private:
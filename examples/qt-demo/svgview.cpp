@@ -1,9 +1,14 @@
 #include <QMessageBox>
 #include <QGuiApplication>
+#include <QCryptographicHash>
+#include <QFileSystemWatcher>
+#include <QFile>
 #include <QScreen>
 #include <QElapsedTimer>
 #include <QTextLayout>
 #include <QPainter>
+#include <QFontMetrics>
+#include <QStringList>
 #include <QFileInfo>
 #include <QMimeData>
 #include <QTimer>
@@ -15,82 +20,180 @@
 SvgViewWorker::SvgViewWorker(QObject *parent)
     : QObject(parent)
     , m_dpiRatio(qApp->screens().first()->devicePixelRatio())
+    , m_renderer(new ResvgRenderer())
 {
+    qRegisterMetaType<RenderInfo>();
 }
 
 QRect SvgViewWorker::viewBox() const
 {
     QMutexLocker lock(&m_mutex);
-    return m_renderer.viewBox();
+    return m_renderer->viewBox();
 }
 
 void SvgViewWorker::loadData(const QByteArray &data)
 {
     QMutexLocker lock(&m_mutex);
 
-    m_renderer.load(data);
-    if (!m_renderer.isValid()) {
-        emit errorMsg(m_renderer.errorString());
+    QElapsedTimer timer;
+    timer.start();
+    m_renderer->load(data);
+    m_parseTime = timer.nsecsElapsed();
+    if (!m_renderer->isValid()) {
+        emit errorMsg(m_renderer->errorString());
     }
 
+    timer.restart();
     m_qtRenderer.load(data);
+    m_qtParseTime = timer.nsecsElapsed();
+    m_hash.clear();
 }
 
+// Must be called from the loader thread.
+//
+// Parses the file into a new renderer and swaps it with the current one on success,
+// so the previous image can still be rendered while a large file is being parsed.
 void SvgViewWorker::loadFile(const QString &path)
 {
-    QMutexLocker lock(&m_mutex);
+    Q_ASSERT(QThread::currentThread() != qApp->thread());
+    Q_ASSERT(QThread::currentThread() != thread());
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        emit errorMsg(tr("Failed to open the file."));
+        return;
+    }
+
+    // Editors can emit multiple change notifications for a single save,
+    // so skip files with the same content.
+    const auto hash = QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha1);
+    file.close();
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if (hash == m_hash) {
+            return;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QScopedPointer<ResvgRenderer> renderer(new ResvgRenderer(path));
+    const qint64 parseTime = timer.nsecsElapsed();
+    if (!renderer->isValid()) {
+        // Keep the previous image.
+        emit errorMsg(renderer->errorString());
+        return;
+    }
 
-    m_renderer.load(path);
-    if (!m_renderer.isValid()) {
-        emit errorMsg(m_renderer.errorString());
+    {
+        QMutexLocker lock(&m_mutex);
+        m_renderer.swap(renderer);
+        m_hash = hash;
+        m_parseTime = parseTime;
     }
 
-    m_qtRenderer.load(path);
+    // QSvgRenderer belongs to the render thread.
+    QTimer::singleShot(0, this, [this, path](){
+        QMutexLocker lock(&m_mutex);
+        QElapsedTimer timer;
+        timer.start();
+        m_qtRenderer.load(path);
+        m_qtParseTime = timer.nsecsElapsed();
+    });
+
+    emit loaded();
+
+    // The previous renderer will be destroyed outside the lock.
 }
 
-void SvgViewWorker::render(const QSize &viewSize, RenderBackend backend)
+void SvgViewWorker::requestRender(const QSize &viewSize, RenderBackend backend, bool compare)
+{
+    m_queueDepth.ref();
+
+    // Run method in the worker thread scope.
+    QTimer::singleShot(1, this, [=](){
+        render(viewSize, backend, compare);
+    });
+}
+
+void SvgViewWorker::render(const QSize &viewSize, RenderBackend backend, bool compare)
 {
     Q_ASSERT(QThread::currentThread() != qApp->thread());
 
+    RenderInfo info;
+    info.backend = backend;
+    info.queueDepth = m_queueDepth.fetchAndAddOrdered(-1) - 1;
+
     QMutexLocker lock(&m_mutex);
 
-    if (backend == RenderBackend::Resvg) {
-        if (m_renderer.isEmpty()) {
-            return;
-        }
+    const QImage img = renderImage(viewSize, backend, info);
+    if (img.isNull()) {
+        return;
+    }
 
-        const auto s = m_renderer.defaultSize().scaled(viewSize, Qt::KeepAspectRatio);
-        QImage img(s * m_dpiRatio, QImage::Format_ARGB32_Premultiplied);
-        img.fill(Qt::transparent);
+    if (compare) {
+        const auto other = backend == RenderBackend::Resvg ? RenderBackend::QtSvg
+                                                           : RenderBackend::Resvg;
+        RenderInfo otherInfo;
+        if (!renderImage(viewSize, other, otherInfo).isNull()) {
+            info.otherRenderTime = otherInfo.renderTime;
+        }
+    }
 
-        QPainter p;
-        p.begin(&img);
-        p.setRenderHint(QPainter::Antialiasing);
-        m_renderer.render(&p);
-        p.end();
+    emit rendered(img, info);
+}
 
-        img.setDevicePixelRatio(m_dpiRatio);
+QImage SvgViewWorker::renderImage(const QSize &viewSize, RenderBackend backend, RenderInfo &info)
+{
+    QSize s;
+    if (backend == RenderBackend::Resvg) {
+        if (m_renderer->isEmpty()) {
+            return QImage();
+        }
 
-        emit rendered(img);
+        s = m_renderer->defaultSize().scaled(viewSize, Qt::KeepAspectRatio);
+        info.parseTime = m_parseTime;
     } else {
         if (!m_qtRenderer.isValid()) {
-            return;
+            return QImage();
         }
 
-        const auto s = m_qtRenderer.defaultSize().scaled(viewSize, Qt::KeepAspectRatio);
-        QImage img(s * m_dpiRatio, QImage::Format_ARGB32_Premultiplied);
-        img.fill(Qt::transparent);
+        s = m_qtRenderer.defaultSize().scaled(viewSize, Qt::KeepAspectRatio);
+        info.parseTime = m_qtParseTime;
+    }
 
-        QPainter p;
-        p.begin(&img);
-        p.setRenderHint(QPainter::Antialiasing);
-        m_qtRenderer.render(&p);
-        p.end();
+    QElapsedTimer timer;
+    timer.start();
 
-        img.setDevicePixelRatio(m_dpiRatio);
+    QImage img(s * m_dpiRatio, QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::transparent);
 
-        emit rendered(img);
+    QPainter p;
+    p.begin(&img);
+    p.setRenderHint(QPainter::Antialiasing);
+    info.prepareTime = timer.nsecsElapsed();
+
+    timer.restart();
+    if (backend == RenderBackend::Resvg) {
+        // Statistics are collected per thread, so the worker thread is fine.
+        resvg_reset_render_stats();
+        m_renderer->render(&p);
+        resvg_get_render_stats(&info.stats);
+        info.hasStats = true;
+    } else {
+        m_qtRenderer.render(&p);
     }
+    info.renderTime = timer.nsecsElapsed();
+
+    timer.restart();
+    p.end();
+    img.setDevicePixelRatio(m_dpiRatio);
+    info.finishTime = timer.nsecsElapsed();
+
+    info.imageSize = img.size();
+
+    return img;
 }
 
 static QImage genCheckedTexture()
@@ -114,6 +217,8 @@ SvgView::SvgView(QWidget *parent)
     : QFrame(parent)
     , m_checkboardImg(genCheckedTexture())
     , m_worker(new SvgViewWorker())
+    , m_loader(new QObject())
+    , m_watcher(new QFileSystemWatcher(this))
 {
     setAcceptDrops(true);
     setMinimumSize(10, 10);
@@ -122,14 +227,31 @@ SvgView::SvgView(QWidget *parent)
     m_worker->moveToThread(th);
     th->start();
 
+    // Files are parsed in a separate thread, so rendering is not blocked by parsing.
+    QThread *loaderTh = new QThread(this);
+    m_loader->moveToThread(loaderTh);
+    loaderTh->start();
+
     const auto *screen = qApp->screens().first();
     m_dpiRatio = screen->devicePixelRatio();
 
+    // Wait a bit for an editor to finish writing.
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(100);
+    connect(&m_reloadTimer, &QTimer::timeout, this, &SvgView::reloadFile);
+
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &SvgView::onFileChanged);
     connect(m_worker, &SvgViewWorker::rendered, this, &SvgView::onRendered);
+    connect(m_worker, &SvgViewWorker::loaded, this, &SvgView::requestUpdate);
 }
 
 SvgView::~SvgView()
 {
+    QThread *loaderTh = m_loader->thread();
+    loaderTh->quit();
+    loaderTh->wait(10000);
+    delete m_loader;
+
     QThread *th = m_worker->thread();
     th->quit();
     th->wait(10000);
@@ -165,16 +287,72 @@ void SvgView::setBackend(RenderBackend backend)
     requestUpdate();
 }
 
+void SvgView::setWatchFile(bool flag)
+{
+    m_isWatchFile = flag;
+    updateWatcher();
+}
+
+void SvgView::setShowStats(bool flag)
+{
+    m_isShowStats = flag;
+    update();
+}
+
+void SvgView::setCompareBackends(bool flag)
+{
+    m_isCompareBackends = flag;
+    requestUpdate();
+}
+
 void SvgView::loadData(const QByteArray &ba)
 {
+    m_path.clear();
+    updateWatcher();
+
     m_worker->loadData(ba);
     requestUpdate();
 }
 
 void SvgView::loadFile(const QString &path)
 {
-    m_worker->loadFile(path);
-    requestUpdate();
+    m_path = path;
+    updateWatcher();
+    reloadFile();
+}
+
+void SvgView::updateWatcher()
+{
+    if (!m_watcher->files().isEmpty()) {
+        m_watcher->removePaths(m_watcher->files());
+    }
+
+    if (m_isWatchFile && !m_path.isEmpty()) {
+        m_watcher->addPath(m_path);
+    }
+}
+
+void SvgView::onFileChanged()
+{
+    // Some editors save files by replacing them, which removes the file from the watcher.
+    if (m_watcher->files().isEmpty() && QFile::exists(m_path)) {
+        m_watcher->addPath(m_path);
+    }
+
+    m_reloadTimer.start();
+}
+
+void SvgView::reloadFile()
+{
+    if (m_path.isEmpty()) {
+        return;
+    }
+
+    // Run method in the m_loader thread scope.
+    const auto path = m_path;
+    QTimer::singleShot(0, m_loader, [=](){
+        m_worker->loadFile(path);
+    });
 }
 
 void SvgView::paintEvent(QPaintEvent *e)
@@ -215,9 +393,86 @@ void SvgView::paintEvent(QPaintEvent *e)
         p.drawRect(imgRect);
     }
 
+    if (m_isShowStats) {
+        p.resetTransform();
+        p.translate(r.topLeft());
+        drawStats(p);
+    }
+
     QFrame::paintEvent(e);
 }
 
+static QString formatTime(qint64 ns)
+{
+    return QString("%1ms").arg(ns / 1000000.0, 0, 'f', 2);
+}
+
+void SvgView::drawStats(QPainter &p)
+{
+    const auto &info = m_info;
+    const bool isResvg = info.backend == RenderBackend::Resvg;
+
+    QStringList lines;
+    if (info.parseTime >= 0) {
+        lines << QString("Parse: %1").arg(formatTime(info.parseTime));
+    }
+
+    lines << QString("Render: %1 (prepare %2, %3 %4, finish %5)")
+                 .arg(formatTime(info.prepareTime + info.renderTime + info.finishTime))
+                 .arg(formatTime(info.prepareTime))
+                 .arg(isResvg ? "resvg" : "QtSvg")
+                 .arg(formatTime(info.renderTime))
+                 .arg(formatTime(info.finishTime));
+
+    if (info.otherRenderTime >= 0) {
+        lines << QString("%1: %2, %3x")
+                     .arg(isResvg ? "QtSvg" : "resvg")
+                     .arg(formatTime(info.otherRenderTime))
+                     .arg(info.otherRenderTime / qMax(1.0, double(info.renderTime)), 0, 'f', 2);
+    }
+
+    if (info.hasStats) {
+        const auto &s = info.stats;
+        lines << QString("Layers: %1, %2 KiB").arg(s.layers).arg(s.surfaces_size / 1024);
+        lines << QString("Patterns: %1, culled nodes: %2").arg(s.patterns).arg(s.culled_nodes);
+
+        const auto lookups = s.coverage_cache_hits + s.coverage_cache_misses;
+        if (lookups != 0) {
+            lines << QString("Coverage cache: %1/%2 hits, %3%")
+                         .arg(s.coverage_cache_hits).arg(lookups)
+                         .arg(100 * s.coverage_cache_hits / lookups);
+        } else {
+            lines << QString("Coverage cache: not used");
+        }
+    }
+
+    lines << QString("Image: %1x%2 px").arg(info.imageSize.width()).arg(info.imageSize.height());
+    lines << QString("Queue: %1").arg(info.queueDepth);
+
+    QFont font("monospace");
+    font.setStyleHint(QFont::Monospace);
+    p.setFont(font);
+
+    const int padding = 6;
+    const QFontMetrics fm(font);
+    int w = 0;
+    for (const auto &line : lines) {
+        w = qMax(w, fm.width(line));
+    }
+
+    const QRect hudRect(0, 0, w + padding * 2, fm.height() * lines.size() + padding * 2);
+    p.setPen(Qt::NoPen);
+    p.setBrush(QColor(0, 0, 0, 180));
+    p.drawRect(hudRect);
+
+    p.setPen(Qt::white);
+    int y = padding + fm.ascent();
+    for (const auto &line : lines) {
+        p.drawText(padding, y, line);
+        y += fm.height();
+    }
+}
+
 void SvgView::dragEnterEvent(QDragEnterEvent *event)
 {
     event->accept();
@@ -269,16 +524,13 @@ void SvgView::resizeEvent(QResizeEvent *)
 void SvgView::requestUpdate()
 {
     const auto s = m_isFitToView ? size() : m_worker->viewBox().size();
-
-    // Run method in the m_worker thread scope.
-    QTimer::singleShot(1, m_worker, [=](){
-        m_worker->render(s, m_backend);
-    });
+    m_worker->requestRender(s, m_backend, m_isCompareBackends);
 }
 
-void SvgView::onRendered(const QImage &img)
+void SvgView::onRendered(const QImage &img, const RenderInfo &info)
 {
     m_img = img;
+    m_info = info;
     update();
 }
 
@@ -3,6 +3,9 @@
 #include <QFrame>
 #include <QSvgRenderer>
 #include <QMutex>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QMetaType>
 
 #include <ResvgQt.h>
 
@@ -12,6 +15,28 @@ enum class RenderBackend
     QtSvg,
 };
 
+class QFileSystemWatcher;
+
+// Statistics of the last rendering. All times are in nanoseconds.
+struct RenderInfo
+{
+    RenderBackend backend = RenderBackend::Resvg;
+    qint64 parseTime = -1;
+    qint64 prepareTime = 0;
+    qint64 renderTime = 0;
+    qint64 finishTime = 0;
+    // Render time of the other backend. Only when backends comparison is enabled.
+    qint64 otherRenderTime = -1;
+    // Only the resvg backend has statistics.
+    bool hasStats = false;
+    resvg_render_stats stats = {};
+    QSize imageSize;
+    // Number of render requests that are still waiting in the queue.
+    int queueDepth = 0;
+};
+
+Q_DECLARE_METATYPE(RenderInfo)
+
 class SvgViewWorker : public QObject
 {
     Q_OBJECT
@@ -21,20 +46,31 @@ public:
 
     QRect viewBox() const;
 
+    // Can be called from any thread.
+    void requestRender(const QSize &viewSize, RenderBackend backend, bool compare);
+
 public slots:
     void loadData(const QByteArray &data);
     void loadFile(const QString &path);
-    void render(const QSize &viewSize, RenderBackend backend);
+    void render(const QSize &viewSize, RenderBackend backend, bool compare);
 
 signals:
-    void rendered(QImage);
+    void rendered(QImage, RenderInfo);
     void errorMsg(QString);
+    void loaded();
+
+private:
+    QImage renderImage(const QSize &viewSize, RenderBackend backend, RenderInfo &info);
 
 private:
     const float m_dpiRatio;
     mutable QMutex m_mutex;
-    ResvgRenderer m_renderer;
+    QScopedPointer<ResvgRenderer> m_renderer;
     QSvgRenderer m_qtRenderer;
+    QByteArray m_hash;
+    qint64 m_parseTime = -1;
+    qint64 m_qtParseTime = -1;
+    QAtomicInt m_queueDepth;
 };
 
 class SvgView : public QFrame
@@ -58,6 +94,9 @@ public:
     void setBackgound(Backgound backgound);
     void setDrawImageBorder(bool flag);
     void setBackend(RenderBackend backend);
+    void setWatchFile(bool flag);
+    void setShowStats(bool flag);
+    void setCompareBackends(bool flag);
 
     void loadData(const QByteArray &data);
     void loadFile(const QString &path);
@@ -74,13 +113,20 @@ protected:
 
 private:
     void requestUpdate();
+    void updateWatcher();
+    void drawStats(QPainter &p);
 
 private slots:
-    void onRendered(const QImage &img);
+    void onRendered(const QImage &img, const RenderInfo &info);
+    void onFileChanged();
+    void reloadFile();
 
 private:
     const QImage m_checkboardImg;
     SvgViewWorker * const m_worker;
+    QObject * const m_loader;
+    QFileSystemWatcher * const m_watcher;
+    QTimer m_reloadTimer;
 
     QString m_path;
     RenderBackend m_backend = RenderBackend::Resvg;
@@ -88,5 +134,9 @@ private:
     bool m_isFitToView = true;
     Backgound m_backgound = Backgound::CheckBoard;
     bool m_isDrawImageBorder = false;
+    bool m_isWatchFile = false;
+    bool m_isShowStats = false;
+    bool m_isCompareBackends = false;
     QImage m_img;
+    RenderInfo m_info;
 };
@@ -0,0 +1,32 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Checks that parsing cost is proportional to the input size.
+//!
+//! Includes the passes that are run by the C API after parsing.
+
+#![no_main]
+#[macro_use] extern crate libfuzzer_sys;
+extern crate resvg;
+extern crate resvg_fuzz;
+
+use resvg::usvg;
+use resvg_fuzz::{
+    Budget,
+    CountingAlloc,
+};
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+fuzz_target!(|data: &[u8]| {
+    let budget = Budget::from_env();
+    let opt = usvg::Options::default();
+
+    let cost = resvg_fuzz::measure(|| {
+        let _ = resvg_fuzz::parse(data, &opt);
+    });
+
+    budget.check(&cost, data.len());
+});
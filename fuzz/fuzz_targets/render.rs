@@ -0,0 +1,48 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Checks that rendering cost is proportional to the input size.
+//!
+//! Images are downscaled to `MAX_SIZE`, so the canvas size alone
+//! cannot exceed the budget.
+
+#![no_main]
+#[macro_use] extern crate libfuzzer_sys;
+extern crate resvg;
+extern crate resvg_fuzz;
+
+use resvg::usvg;
+use resvg_fuzz::{
+    Budget,
+    CountingAlloc,
+};
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+const MAX_SIZE: f64 = 256.0;
+
+fuzz_target!(|data: &[u8]| {
+    let budget = Budget::from_env();
+    let mut opt = resvg::Options::default();
+
+    // Parsing is checked by the `parse` target.
+    let tree = match resvg_fuzz::parse(data, &opt.usvg) {
+        Some(tree) => tree,
+        None => return,
+    };
+
+    let size = tree.svg_node().size;
+    let max = size.width.max(size.height);
+    if max > MAX_SIZE {
+        opt.fit_to = resvg::FitTo::Zoom((MAX_SIZE / max) as f32);
+    }
+
+    let backend = resvg::default_backend();
+    let cost = resvg_fuzz::measure(|| {
+        let _ = backend.render_to_image(&tree, &opt);
+    });
+
+    budget.check(&cost, data.len());
+});
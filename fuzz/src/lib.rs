@@ -0,0 +1,138 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Cost measurement for fuzz targets.
+//!
+//! Targets panic when an input is too expensive relative to its size,
+//! so libFuzzer saves it to `artifacts/` and `cargo fuzz tmin` can minimize it.
+//!
+//! The budget is `base + per_byte * input_len` for each metric
+//! and can be adjusted using environment variables:
+//!
+//! - `RESVG_FUZZ_TIME_BASE_MS` and `RESVG_FUZZ_TIME_PER_BYTE_US`
+//! - `RESVG_FUZZ_ALLOC_BASE_KB` and `RESVG_FUZZ_ALLOC_PER_BYTE`
+//! - `RESVG_FUZZ_ALLOCS_BASE` and `RESVG_FUZZ_ALLOCS_PER_BYTE`
+//! - `RESVG_FUZZ_LAYERS_BASE` and `RESVG_FUZZ_LAYERS_PER_BYTE`
+
+extern crate resvg;
+
+use std::env;
+use std::time::Instant;
+
+use resvg::alloc_stats;
+use resvg::stats;
+use resvg::usvg;
+
+pub use resvg::alloc_stats::CountingAlloc;
+
+
+/// Parses an SVG data the same way as `resvg_parse_tree_from_data` does.
+pub fn parse(data: &[u8], opt: &usvg::Options) -> Option<usvg::Tree> {
+    let tree = usvg::Tree::from_data(data, opt).ok()?;
+    resvg::passes::simplify_effects(&tree);
+    Some(tree)
+}
+
+
+/// A cost of processing a single input.
+#[derive(Clone, Copy, Debug)]
+pub struct Cost {
+    /// Wall time in nanoseconds.
+    pub time_ns: u64,
+    /// Number of heap allocations.
+    pub allocs: u64,
+    /// Heap memory plus canvas memory, in bytes.
+    pub bytes: u64,
+    /// Number of allocated layers and pattern tiles.
+    pub layers: u64,
+}
+
+/// A cost budget.
+pub struct Budget {
+    time_base_ns: u64,
+    time_per_byte_ns: u64,
+    alloc_base: u64,
+    alloc_per_byte: u64,
+    allocs_base: u64,
+    allocs_per_byte: u64,
+    layers_base: u64,
+    layers_per_byte: u64,
+}
+
+impl Budget {
+    /// Loads a budget from environment variables.
+    pub fn from_env() -> Self {
+        Budget {
+            time_base_ns: env_u64("RESVG_FUZZ_TIME_BASE_MS", 100) * 1_000_000,
+            time_per_byte_ns: env_u64("RESVG_FUZZ_TIME_PER_BYTE_US", 100) * 1000,
+            alloc_base: env_u64("RESVG_FUZZ_ALLOC_BASE_KB", 32 * 1024) * 1024,
+            alloc_per_byte: env_u64("RESVG_FUZZ_ALLOC_PER_BYTE", 16 * 1024),
+            allocs_base: env_u64("RESVG_FUZZ_ALLOCS_BASE", 64 * 1024),
+            allocs_per_byte: env_u64("RESVG_FUZZ_ALLOCS_PER_BYTE", 256),
+            layers_base: env_u64("RESVG_FUZZ_LAYERS_BASE", 32),
+            layers_per_byte: env_u64("RESVG_FUZZ_LAYERS_PER_BYTE", 1),
+        }
+    }
+
+    /// Panics if the cost exceeds the budget for an input of the specified size.
+    pub fn check(&self, cost: &Cost, input_len: usize) {
+        let len = input_len as u64;
+
+        let time_limit = self.time_base_ns + self.time_per_byte_ns * len;
+        let alloc_limit = self.alloc_base + self.alloc_per_byte * len;
+        let allocs_limit = self.allocs_base + self.allocs_per_byte * len;
+        let layers_limit = self.layers_base + self.layers_per_byte * len;
+
+        let mut exceeded = Vec::new();
+        if cost.time_ns > time_limit {
+            exceeded.push(format!("time {}ms > {}ms",
+                                  cost.time_ns / 1_000_000, time_limit / 1_000_000));
+        }
+
+        if cost.bytes > alloc_limit {
+            exceeded.push(format!("memory {}KiB > {}KiB",
+                                  cost.bytes / 1024, alloc_limit / 1024));
+        }
+
+        if cost.allocs > allocs_limit {
+            exceeded.push(format!("allocations {} > {}", cost.allocs, allocs_limit));
+        }
+
+        if cost.layers > layers_limit {
+            exceeded.push(format!("layers {} > {}", cost.layers, layers_limit));
+        }
+
+        if !exceeded.is_empty() {
+            panic!("cost budget exceeded for a {}b input: {}. {:?}",
+                   input_len, exceeded.join(", "), cost);
+        }
+    }
+}
+
+fn env_u64(name: &str, default: u64) -> u64 {
+    env::var(name).ok().and_then(|v| v.parse().ok()).unwrap_or(default)
+}
+
+/// Runs `f` and returns its cost.
+///
+/// The `CountingAlloc` must be set as a global allocator.
+pub fn measure<F: FnOnce()>(f: F) -> Cost {
+    stats::reset();
+    let start = alloc_stats::get();
+    let now = Instant::now();
+
+    f();
+
+    let elapsed = now.elapsed();
+    let render_stats = stats::get();
+    let end = alloc_stats::get();
+
+    Cost {
+        time_ns: elapsed.as_secs() * 1_000_000_000 + elapsed.subsec_nanos() as u64,
+        allocs: (end.total_count() - start.total_count()) as u64,
+        // Canvas memory is allocated by the backend and not by the Rust allocator.
+        bytes: (end.total_bytes() - start.total_bytes()) as u64 + render_stats.surfaces_size,
+        layers: (render_stats.layers + render_stats.patterns) as u64,
+    }
+}
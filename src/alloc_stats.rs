@@ -0,0 +1,142 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! A counting global allocator.
+//!
+//! Allocations are grouped by `stats::Site`.
+//!
+//! Available only with the `alloc-stats` build feature.
+//!
+//! # Example
+//!
+//! ```ignore
+//! #[global_allocator]
+//! static GLOBAL: resvg::alloc_stats::CountingAlloc = resvg::alloc_stats::CountingAlloc;
+//! ```
+
+use std::alloc::{
+    GlobalAlloc,
+    Layout,
+    System,
+};
+use std::sync::atomic::{
+    AtomicUsize,
+    Ordering,
+    ATOMIC_USIZE_INIT,
+};
+
+use stats;
+
+
+/// Number of allocation sites.
+pub const SITES_COUNT: usize = 6;
+
+struct Counter {
+    count: AtomicUsize,
+    bytes: AtomicUsize,
+}
+
+const COUNTER_INIT: Counter = Counter {
+    count: ATOMIC_USIZE_INIT,
+    bytes: ATOMIC_USIZE_INIT,
+};
+
+static SITES: [Counter; SITES_COUNT] = [COUNTER_INIT, COUNTER_INIT, COUNTER_INIT,
+                                        COUNTER_INIT, COUNTER_INIT, COUNTER_INIT];
+static LIVE: AtomicUsize = ATOMIC_USIZE_INIT;
+static PEAK: AtomicUsize = ATOMIC_USIZE_INIT;
+
+
+/// A global allocator that counts allocations per `stats::Site`.
+pub struct CountingAlloc;
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let ptr = System.alloc(layout);
+        if !ptr.is_null() {
+            on_alloc(layout.size());
+        }
+
+        ptr
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        let ptr = System.alloc_zeroed(layout);
+        if !ptr.is_null() {
+            on_alloc(layout.size());
+        }
+
+        ptr
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout);
+        LIVE.fetch_sub(layout.size(), Ordering::Relaxed);
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let new_ptr = System.realloc(ptr, layout, new_size);
+        if !new_ptr.is_null() {
+            // Count realloc as a new allocation, since it usually is one.
+            LIVE.fetch_sub(layout.size(), Ordering::Relaxed);
+            on_alloc(new_size);
+        }
+
+        new_ptr
+    }
+}
+
+fn on_alloc(size: usize) {
+    let site = &SITES[stats::site() as usize];
+    site.count.fetch_add(1, Ordering::Relaxed);
+    site.bytes.fetch_add(size, Ordering::Relaxed);
+
+    let live = LIVE.fetch_add(size, Ordering::Relaxed) + size;
+    // Not exact under contention, which is fine for statistics.
+    if live > PEAK.load(Ordering::Relaxed) {
+        PEAK.store(live, Ordering::Relaxed);
+    }
+}
+
+
+/// Allocation statistics snapshot.
+///
+/// Unlike `stats::RenderStats`, counters are global and not per thread.
+#[derive(Clone, Copy, Default, Debug)]
+pub struct AllocStats {
+    /// Number of allocations per site, in the `Site::all` order.
+    pub count: [usize; SITES_COUNT],
+    /// Allocated bytes per site, in the `Site::all` order.
+    pub bytes: [usize; SITES_COUNT],
+    /// Peak live heap since the last `reset_peak` call.
+    pub peak: usize,
+}
+
+impl AllocStats {
+    /// Returns a total number of allocations.
+    pub fn total_count(&self) -> usize {
+        self.count.iter().sum()
+    }
+
+    /// Returns a total number of allocated bytes.
+    pub fn total_bytes(&self) -> usize {
+        self.bytes.iter().sum()
+    }
+}
+
+/// Returns current statistics.
+pub fn get() -> AllocStats {
+    let mut s = AllocStats::default();
+    for (i, site) in SITES.iter().enumerate() {
+        s.count[i] = site.count.load(Ordering::Relaxed);
+        s.bytes[i] = site.bytes.load(Ordering::Relaxed);
+    }
+    s.peak = PEAK.load(Ordering::Relaxed);
+    s
+}
+
+/// Sets the peak live heap to the current live heap.
+pub fn reset_peak() {
+    PEAK.store(LIVE.load(Ordering::Relaxed), Ordering::Relaxed);
+}
@@ -12,32 +12,85 @@ use usvg::prelude::*;
 
 // self
 use super::prelude::*;
+use layers;
 use super::{
     path,
     text,
 };
 
 
+/// Applies the clip path to the `group` layer.
+///
+/// `ts` is the group canvas space transform and `cr` draws on the group layer.
 pub fn apply(
     node: &usvg::Node,
     cp: &usvg::ClipPath,
     opt: &Options,
     bbox: Rect,
+    ts: &usvg::Transform,
+    group: &CairoLayer,
     layers: &mut CairoLayers,
     cr: &cairo::Context,
 ) {
     // a-clip-path-001.svg
     // e-clipPath-001.svg
 
-    let clip_surface = try_opt!(layers.get(), ());
-    let clip_surface = clip_surface.borrow_mut();
+    let key = if opt.coverage_cache {
+        let img_size = layers.image_size();
+        Some(super::COVERAGE_CACHE.with(|c| {
+            c.borrow_mut().key(node, ts, bbox, None, opt.usvg.dpi, img_size)
+        }))
+    } else {
+        None
+    };
 
-    let clip_cr = cairo::Context::new(&*clip_surface);
+    if let Some(ref key) = key {
+        if let Some(clip_surface) = super::COVERAGE_CACHE.with(|c| c.borrow_mut().get(key)) {
+            let offset = layers::area_offset(layers.image_area(), group.area());
+            draw_clip(&clip_surface, offset, cr);
+            return;
+        }
+    }
+
+    // Cached layers can be reused by groups with a different content,
+    // so they are rendered fully.
+    let area = if key.is_some() { layers.image_area() } else { group.area() };
+    let clip_layer = try_opt!(layers.get(area), ());
+    if key.is_some() {
+        clip_layer.touch(None);
+    } else {
+        clip_layer.touch_from(group);
+    }
+
+    let clip_surface = clip_layer.borrow_mut();
+
+    let clip_ts = layers::area_transform(ts, area);
+    render_clip(node, cp, opt, bbox, &clip_ts, &clip_layer.regions(), &*clip_surface);
+    draw_clip(&*clip_surface, layers::area_offset(area, group.area()), cr);
+
+    if let Some(key) = key {
+        if let Some(copy) = super::copy_subsurface(&*clip_surface, layers.image_size()) {
+            super::COVERAGE_CACHE.with(|c| c.borrow_mut().insert(key, copy));
+        }
+    }
+}
+
+fn render_clip(
+    node: &usvg::Node,
+    cp: &usvg::ClipPath,
+    opt: &Options,
+    bbox: Rect,
+    ts: &usvg::Transform,
+    regions: &[ScreenRect],
+    clip_surface: &cairo::ImageSurface,
+) {
+    let clip_cr = cairo::Context::new(clip_surface);
+    super::clip_regions(regions, &clip_cr);
     clip_cr.set_source_rgba(0.0, 0.0, 0.0, 1.0);
     clip_cr.paint();
     // e-clipPath-006.svg
     // e-clipPath-007.svg
-    clip_cr.set_matrix(cr.get_matrix());
+    clip_cr.set_matrix(ts.to_native());
     // e-clipPath-008.svg
     clip_cr.transform(cp.transform.to_native());
 
@@ -71,9 +124,11 @@ pub fn apply(
 
         clip_cr.set_matrix(matrix);
     }
+}
 
+fn draw_clip(clip_surface: &cairo::ImageSurface, offset: (f64, f64), cr: &cairo::Context) {
     cr.set_matrix(cairo::Matrix::identity());
-    cr.set_source_surface(&*clip_surface, 0.0, 0.0);
+    cr.set_source_surface(clip_surface, offset.0, offset.1);
     cr.set_operator(cairo::Operator::DestOut);
     cr.paint();
 
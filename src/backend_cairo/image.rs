@@ -2,6 +2,14 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+use std::cell::RefCell;
+use std::cmp;
+use std::collections::HashMap;
+use std::panic;
+use std::path;
+use std::slice;
+use std::thread;
+
 // external
 use cairo;
 use gdk_pixbuf::{
@@ -14,6 +22,7 @@ use usvg;
 // self
 use super::prelude::*;
 use backend_utils::image;
+use stats;
 
 
 pub fn draw(
@@ -21,34 +30,272 @@ pub fn draw(
     opt: &Options,
     cr: &cairo::Context,
 ) -> Rect {
+    let _site = stats::enter_site(stats::Site::Image);
+
     if image.format == usvg::ImageFormat::SVG {
         draw_svg(image, opt, cr);
-    } else {
+    } else if is_visible(image.view_box.rect, cr) {
         draw_raster(image, opt, cr);
     }
 
     image.view_box.rect
 }
 
+/// Checks that the image rect intersects the visible area.
+///
+/// Raster images are decoded on each draw, so there is no point
+/// in decoding an image that is outside the canvas.
+/// SVG images are not checked, because they are not clipped by the view box.
+fn is_visible(r: Rect, cr: &cairo::Context) -> bool {
+    let (x1, y1, x2, y2) = cr.clip_extents();
+    r.x < x2 && r.x + r.width > x1 && r.y < y2 && r.y + r.height > y1
+}
+
 fn draw_raster(
     image: &usvg::Image,
     opt: &Options,
     cr: &cairo::Context,
 ) {
+    let key = image_key(image);
+    let is_decoded = DECODED.with(|d| {
+        match d.borrow().get(&key) {
+            Some(img) => { draw_decoded(img, cr); true }
+            None => false,
+        }
+    });
+
+    if is_decoded {
+        return;
+    }
+
     let img = match image.data {
         usvg::ImageData::Path(ref path) => {
             let path = image::get_abs_path(path, opt);
-            try_opt_warn!(gdk_pixbuf::Pixbuf::new_from_file(path.clone()).ok(), (),
-                "Failed to load an external image: {:?}.", path)
+            decode(Source::Path(&path), image.view_box)
         }
         usvg::ImageData::Raw(ref data) => {
-            try_opt_warn!(load_raster_data(data), (),
+            decode(Source::Raw(data), image.view_box)
+        }
+    };
+
+    if let Some(img) = img {
+        draw_decoded(&img, cr);
+    }
+}
+
+/// Decodes raster images of the `root` subtree in parallel.
+///
+/// `cr` must have the view box transform applied.
+///
+/// Uses `Options::decoding_threads` threads, including the current one.
+/// Threads are spawned on each call and joined before returning.
+///
+/// Only images that intersect the current clip extents are decoded.
+/// Images inside patterns, masks and clip paths, as well as images that
+/// will be skipped by the occlusion culling, are decoded during rendering.
+///
+/// Decoded images are used by `draw` until the returned guard is dropped,
+/// so the peak memory usage is the sum of all decoded images,
+/// which are `width * height * 4` bytes each.
+pub fn decode_images(
+    root: &usvg::Node,
+    opt: &Options,
+    cr: &cairo::Context,
+) -> Option<DecodedImages> {
+    let _site = stats::enter_site(stats::Site::Image);
+
+    let mut ts = usvg::Transform::from_native(&cr.get_matrix());
+    ts.append(&utils::abs_transform(root));
+    ts.append(&root.transform());
+
+    cr.save();
+    cr.identity_matrix();
+    let (x1, y1, x2, y2) = cr.clip_extents();
+    cr.restore();
+    let clip = Rect::new(x1, y1, x2 - x1, y2 - y1);
+
+    let mut jobs = Vec::new();
+    collect_jobs(root, &ts, clip, opt, &mut jobs);
+
+    let threads = cmp::min(opt.decoding_threads as usize, jobs.len());
+    if threads < 2 {
+        return None;
+    }
+
+    let keys: Vec<_> = jobs.iter().map(|job| job.key).collect();
+
+    let mut buckets: Vec<Vec<_>> = (0..threads).map(|_| Vec::new()).collect();
+    for (i, job) in jobs.into_iter().enumerate() {
+        buckets[i % threads].push(job);
+    }
+
+    fn decode_bucket(bucket: Vec<Job>) -> Vec<(usize, DecodedImage)> {
+        bucket.into_iter().filter_map(|job| {
+            let img = match job.data {
+                JobData::Path(ref path) => decode(Source::Path(path), job.view_box),
+                JobData::Raw(ref data) => decode(Source::Raw(unsafe { data.as_slice() }),
+                                                 job.view_box),
+            };
+
+            img.map(|img| (job.key, img))
+        }).collect()
+    }
+
+    // The last bucket is decoded by the current thread.
+    let own_bucket = buckets.pop().unwrap();
+    // Images from a thread that failed to start will be decoded during rendering.
+    let handles: Vec<_> = buckets.into_iter().filter_map(|bucket| {
+        thread::Builder::new().spawn(move || decode_bucket(bucket)).ok()
+    }).collect();
+
+    // Threads must be joined even on panic, since they borrow the tree data.
+    let own = panic::catch_unwind(panic::AssertUnwindSafe(|| decode_bucket(own_bucket)));
+
+    let mut decoded = Vec::new();
+    for handle in handles {
+        // Images from a failed thread will be decoded during rendering.
+        if let Ok(list) = handle.join() {
+            decoded.extend(list);
+        }
+    }
+
+    match own {
+        Ok(list) => decoded.extend(list),
+        Err(e) => panic::resume_unwind(e),
+    }
+
+    DECODED.with(|d| d.borrow_mut().extend(decoded));
+
+    Some(DecodedImages(keys))
+}
+
+fn collect_jobs(
+    parent: &usvg::Node,
+    ts: &usvg::Transform,
+    clip: Rect,
+    opt: &Options,
+    jobs: &mut Vec<Job>,
+) {
+    for node in parent.children() {
+        let mut node_ts = *ts;
+        node_ts.append(&node.transform());
+
+        match *node.borrow() {
+            usvg::NodeKind::Image(ref img) => {
+                if img.format == usvg::ImageFormat::SVG {
+                    continue;
+                }
+
+                let r = utils::transform_rect(img.view_box.rect, &node_ts);
+                let is_visible = r.x < clip.x + clip.width && r.x + r.width > clip.x
+                              && r.y < clip.y + clip.height && r.y + r.height > clip.y;
+                if !is_visible {
+                    continue;
+                }
+
+                let data = match img.data {
+                    usvg::ImageData::Path(ref path) => {
+                        JobData::Path(image::get_abs_path(path, opt))
+                    }
+                    usvg::ImageData::Raw(ref data) => {
+                        JobData::Raw(RawData(data.as_ptr(), data.len()))
+                    }
+                };
+
+                jobs.push(Job { key: image_key(img), data, view_box: img.view_box });
+            }
+            usvg::NodeKind::Group(_) => {
+                collect_jobs(&node, &node_ts, clip, opt, jobs);
+            }
+            _ => {}
+        }
+    }
+}
+
+struct Job {
+    key: usize,
+    data: JobData,
+    view_box: usvg::ViewBox,
+}
+
+enum JobData {
+    Path(path::PathBuf),
+    Raw(RawData),
+}
+
+/// Embedded image data owned by the tree.
+///
+/// Used instead of a copy, since the tree outlives decoding threads
+/// and is not modified during the rendering.
+struct RawData(*const u8, usize);
+
+unsafe impl Send for RawData {}
+
+impl RawData {
+    unsafe fn as_slice(&self) -> &[u8] {
+        slice::from_raw_parts(self.0, self.1)
+    }
+}
+
+/// Frees images decoded by `decode_images` on drop.
+///
+/// Only own images are freed, since `decode_images` is called
+/// for nested SVG images as well.
+pub struct DecodedImages(Vec<usize>);
+
+impl Drop for DecodedImages {
+    fn drop(&mut self) {
+        DECODED.with(|d| {
+            let mut d = d.borrow_mut();
+            for key in &self.0 {
+                d.remove(key);
+            }
+        });
+    }
+}
+
+/// A raster image ready to be drawn.
+struct DecodedImage {
+    /// Premultiplied BGRA pixels with a `width * 4` stride.
+    data: Vec<u8>,
+    size: ScreenSize,
+    view_box: usvg::ViewBox,
+}
+
+// Decoded images by the `usvg::Image` address,
+// which is stable while the tree is being rendered.
+thread_local!(static DECODED: RefCell<HashMap<usize, DecodedImage>> = RefCell::new(HashMap::new()));
+
+fn image_key(image: &usvg::Image) -> usize {
+    image as *const usvg::Image as usize
+}
+
+enum Source<'a> {
+    /// An absolute path.
+    Path(&'a path::Path),
+    Raw(&'a [u8]),
+}
+
+/// Loads and scales an image.
+///
+/// Doesn't depend on a canvas, so can be called from any thread.
+fn decode(
+    data: Source,
+    view_box: usvg::ViewBox,
+) -> Option<DecodedImage> {
+    let img = match data {
+        Source::Path(path) => {
+            try_opt_warn!(gdk_pixbuf::Pixbuf::new_from_file(path).ok(), None,
+                "Failed to load an external image: {:?}.", path)
+        }
+        Source::Raw(data) => {
+            try_opt_warn!(load_raster_data(data), None,
                 "Failed to load an embedded image.")
         }
     };
 
     let img_size = ScreenSize::new(img.get_width() as u32, img.get_height() as u32);
-    let mut view_box = image.view_box;
+    let mut view_box = view_box;
     image::prepare_image_viewbox(img_size, &mut view_box);
     let r = view_box.rect;
 
@@ -56,70 +303,56 @@ fn draw_raster(
 
     let img = img.scale_simple(new_size.width as i32, new_size.height as i32,
                                gdk_pixbuf::InterpType::Bilinear);
-    let img = try_opt_warn!(img, (), "Failed to scale an image.");
+    let img = try_opt_warn!(img, None, "Failed to scale an image.");
 
-    let mut surface = try_create_surface!(new_size, ());
+    let scaled_size = ScreenSize::new(img.get_width() as u32, img.get_height() as u32);
 
-    {
-        // Scaled image will be bigger than viewbox, so we have to
-        // cut only the part specified by align rule.
-        let (start_x, start_y, end_x, end_y) = if view_box.aspect.slice {
-            let pos = utils::aligned_pos(
-                view_box.aspect.align,
-                0.0, 0.0, new_size.width as f64 - r.width, new_size.height as f64 - r.height,
-            );
-
-            (pos.x as u32, pos.y as u32, (pos.x + r.width) as u32, (pos.y + r.height) as u32)
-        } else {
-            (0, 0, img.get_width() as u32, img.get_height() as u32)
-        };
+    // Scaled image will be bigger than viewbox, so we have to
+    // cut only the part specified by align rule.
+    let (start_x, start_y, end_x, end_y) = if view_box.aspect.slice {
+        let pos = utils::aligned_pos(
+            view_box.aspect.align,
+            0.0, 0.0, new_size.width as f64 - r.width, new_size.height as f64 - r.height,
+        );
 
-        let mut surface_data = surface.get_data().unwrap();
+        (pos.x as u32, pos.y as u32, (pos.x + r.width) as u32, (pos.y + r.height) as u32)
+    } else {
+        (0, 0, scaled_size.width, scaled_size.height)
+    };
 
-        let channels = img.get_n_channels() as u32;
-        let w = img.get_width() as u32;
-        let h = img.get_height() as u32;
-        let stride = img.get_rowstride() as u32;
-        let img_pixels = unsafe { img.get_pixels() };
-        // We can't iterate over pixels directly, because width may not be equal to stride.
-        let mut i = 0;
-        for y in 0..h {
-            for x in 0..w {
-                if x >= start_x && y >= start_y && x <= end_x && y <= end_y {
-                    let idx = (y * stride + x * channels) as usize;
-
-                    // NOTE: will not work on big endian.
-                    if channels == 4 {
-                        let r = img_pixels[idx + 0] as u32;
-                        let g = img_pixels[idx + 1] as u32;
-                        let b = img_pixels[idx + 2] as u32;
-                        let a = img_pixels[idx + 3] as u32;
-
-                        // https://www.cairographics.org/manual/cairo-Image-Surfaces.html#cairo-format-t
-                        let tr = a * r + 0x80;
-                        let tg = a * g + 0x80;
-                        let tb = a * b + 0x80;
-                        surface_data[i + 0] = (((tb >> 8) + tb) >> 8) as u8;
-                        surface_data[i + 1] = (((tg >> 8) + tg) >> 8) as u8;
-                        surface_data[i + 2] = (((tr >> 8) + tr) >> 8) as u8;
-                        surface_data[i + 3] = a as u8;
-                    } else {
-                        surface_data[i + 0] = img_pixels[idx + 2];
-                        surface_data[i + 1] = img_pixels[idx + 1];
-                        surface_data[i + 2] = img_pixels[idx + 0];
-                        surface_data[i + 3] = 255;
-                    }
-                }
+    let mut data = vec![0; (scaled_size.width * scaled_size.height * 4) as usize];
+    image::copy_to_bgra_premultiplied(
+        unsafe { img.get_pixels() },
+        scaled_size,
+        img.get_rowstride() as u32,
+        img.get_n_channels() as u32,
+        (start_x, start_y, end_x, end_y),
+        &mut data,
+    );
 
-                // Surface is always ARGB.
-                i += 4;
-            }
-        }
+    Some(DecodedImage {
+        data,
+        size: scaled_size,
+        view_box,
+    })
+}
+
+fn draw_decoded(
+    img: &DecodedImage,
+    cr: &cairo::Context,
+) {
+    let mut surface = try_create_surface!(img.size, ());
+
+    {
+        let mut surface_data = surface.get_data().unwrap();
+        surface_data.copy_from_slice(&img.data);
     }
 
+    let view_box = img.view_box;
+    let r = view_box.rect;
     let pos = utils::aligned_pos(
         view_box.aspect.align,
-        r.x, r.y, r.width - img.get_width() as f64, r.height - img.get_height() as f64,
+        r.x, r.y, r.width - img.size.width as f64, r.height - img.size.height as f64,
     );
 
     // We have to clip the image before rendering otherwise it will be
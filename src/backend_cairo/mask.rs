@@ -12,25 +12,52 @@ use usvg;
 // self
 use super::prelude::*;
 use backend_utils::mask;
+use layers;
 
 
+/// Masks the `group` layer while drawing it on `cr`.
+///
+/// `ts` is the group canvas space transform and `area` is the canvas area of `cr`.
 pub fn apply(
     node: &usvg::Node,
     mask: &usvg::Mask,
     opt: &Options,
     bbox: Rect,
+    ts: &usvg::Transform,
     opacity: Option<usvg::Opacity>,
+    group: &CairoLayer,
     layers: &mut CairoLayers,
+    area: ScreenRect,
     cr: &cairo::Context,
 ) {
     // a-mask-001.svg
 
-    let mask_surface = try_opt!(layers.get(), ());
-    let mut mask_surface = mask_surface.borrow_mut();
+    let key = if opt.coverage_cache {
+        let img_size = layers.image_size();
+        Some(super::COVERAGE_CACHE.with(|c| {
+            c.borrow_mut().key(node, ts, bbox, opacity, opt.usvg.dpi, img_size)
+        }))
+    } else {
+        None
+    };
+
+    if let Some(ref key) = key {
+        if let Some(mask_surface) = super::COVERAGE_CACHE.with(|c| c.borrow_mut().get(key)) {
+            draw_mask(&mask_surface, layers::area_offset(layers.image_area(), area), cr);
+            return;
+        }
+    }
+
+    // The mask is needed only over the group.
+    // Cached layers can be reused by groups with a different content,
+    // so they are converted fully.
+    let mask_area = if key.is_some() { layers.image_area() } else { group.area() };
+    let mask_layer = try_opt!(layers.get(mask_area), ());
+    let mut mask_surface = mask_layer.borrow_mut();
 
     {
         let mask_cr = cairo::Context::new(&*mask_surface);
-        mask_cr.set_matrix(cr.get_matrix());
+        mask_cr.set_matrix(layers::area_transform(ts, mask_area).to_native());
 
         let r = if mask.units == usvg::Units::ObjectBoundingBox {
             mask.rect.transform(usvg::Transform::from_bbox(bbox))
@@ -45,17 +72,40 @@ pub fn apply(
             mask_cr.transform(cairo::Matrix::from_bbox(bbox));
         }
 
-        super::render_group(node, opt, layers, &mask_cr);
+        if key.is_some() {
+            mask_layer.touch(None);
+        } else {
+            let content_ts = usvg::Transform::from_native(&mask_cr.get_matrix());
+            let content_ts = layers::canvas_transform(&content_ts, mask_area);
+            layers.touch_children(&mask_layer, node, &content_ts);
+        }
+
+        super::render_group(node, opt, layers, mask_area, &mask_cr);
     }
 
     {
+        let size = ScreenSize::new(mask_surface.get_width() as u32,
+                                   mask_surface.get_height() as u32);
         let mut data = try_opt_warn!(mask_surface.get_data().ok(), (),
                                      "Failed to borrow a surface for mask: {:?}.", mask.id);
-        mask::image_to_mask(&mut data, layers.image_size(), opacity);
+        for region in mask_layer.regions() {
+            mask::image_to_mask(&mut data, size, region, opacity);
+        }
+    }
+
+    draw_mask(&*mask_surface, layers::area_offset(mask_area, area), cr);
+
+    if let Some(key) = key {
+        if let Some(copy) = super::copy_subsurface(&*mask_surface, layers.image_size()) {
+            super::COVERAGE_CACHE.with(|c| c.borrow_mut().insert(key, copy));
+        }
     }
+}
 
-    let patt = cairo::SurfacePattern::create(&*mask_surface);
+fn draw_mask(mask_surface: &cairo::ImageSurface, offset: (f64, f64), cr: &cairo::Context) {
+    let patt = cairo::SurfacePattern::create(mask_surface);
     cr.set_matrix(cairo::Matrix::identity());
+    cr.translate(offset.0, offset.1);
     cr.mask(&patt);
     cr.reset_source_rgba();
 }
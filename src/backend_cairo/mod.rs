@@ -4,6 +4,9 @@
 
 //! Cairo backend implementation.
 
+use std::cell::RefCell;
+use std::f64;
+
 // external
 use cairo::{
     self,
@@ -15,8 +18,11 @@ use usvg::prelude::*;
 
 // self
 use prelude::*;
+use backend_utils::coverage::CoverageCache;
+use backend_utils::occlusion;
 use {
     layers,
+    stats,
     OutputImage,
     Render,
 };
@@ -50,12 +56,16 @@ mod text;
 mod prelude {
     pub use super::super::prelude::*;
     pub type CairoLayers = super::layers::Layers<super::cairo::ImageSurface>;
+    pub type CairoLayer = super::layers::Layer<super::cairo::ImageSurface>;
     pub use super::ext::*;
 }
 
 
 type CairoLayers = layers::Layers<cairo::ImageSurface>;
 
+thread_local!(static COVERAGE_CACHE: RefCell<CoverageCache<cairo::ImageSurface>>
+    = RefCell::new(CoverageCache::new()));
+
 
 impl ConvTransform<cairo::Matrix> for usvg::Transform {
     fn to_native(&self) -> cairo::Matrix {
@@ -91,6 +101,25 @@ impl Render for Backend {
         Some(Box::new(img))
     }
 
+    fn render_trimmed_to_image(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+    ) -> Option<(Box<OutputImage>, ScreenRect)> {
+        let (img, region) = render_trimmed_to_image(tree, opt)?;
+        Some((Box::new(img), region))
+    }
+
+    fn render_region_to_image(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+        region: ScreenRect,
+    ) -> Option<Box<OutputImage>> {
+        let img = render_region_to_image(tree, opt, region)?;
+        Some(Box::new(img))
+    }
+
     fn render_node_to_image(
         &self,
         node: &usvg::Node,
@@ -107,6 +136,14 @@ impl Render for Backend {
     ) -> Option<Rect> {
         calc_node_bbox(node, opt)
     }
+
+    fn trim_region(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+    ) -> Option<ScreenRect> {
+        trim_region(tree, opt)
+    }
 }
 
 impl OutputImage for cairo::ImageSurface {
@@ -147,6 +184,63 @@ pub fn render_to_image(
     Some(surface)
 }
 
+/// Renders only the part of the SVG that contains the content.
+///
+/// Returns the image and its region inside the full image.
+/// See `utils::trim_region` for details.
+pub fn render_trimmed_to_image(
+    tree: &usvg::Tree,
+    opt: &Options,
+) -> Option<(cairo::ImageSurface, ScreenRect)> {
+    let region = match trim_region(tree, opt) {
+        Some(v) => v,
+        None => {
+            warn!("The image has no visible content.");
+            return None;
+        }
+    };
+
+    let img = render_region_to_image(tree, opt, region)?;
+    Some((img, region))
+}
+
+/// Returns the region of the image that contains all rendered pixels.
+///
+/// Unlike `calc_node_bbox`, includes stroke miter joins and square caps.
+/// See `utils::trim_region` for details.
+pub fn trim_region(
+    tree: &usvg::Tree,
+    opt: &Options,
+) -> Option<ScreenRect> {
+    let bbox = calc_node_bbox_impl(&tree.root(), opt, true)?;
+    utils::trim_region(tree, bbox, opt.fit_to)
+}
+
+/// Renders only the `region` of the image.
+///
+/// The region is in the pixels of the image returned by `render_to_image`.
+pub fn render_region_to_image(
+    tree: &usvg::Tree,
+    opt: &Options,
+    region: ScreenRect,
+) -> Option<cairo::ImageSurface> {
+    let img_size = region.size();
+    let surface = try_create_surface!(img_size, None);
+
+    let cr = cairo::Context::new(&surface);
+
+    // Fill background.
+    if let Some(color) = opt.background {
+        cr.set_source_color(&color, 1.0.into());
+        cr.paint();
+    }
+
+    let view_box = utils::region_view_box(tree, region, opt.fit_to);
+    render_node_to_canvas(&tree.root(), opt, view_box, img_size, &cr);
+
+    Some(surface)
+}
+
 /// Renders SVG to image.
 pub fn render_node_to_image(
     node: &usvg::Node,
@@ -179,6 +273,13 @@ pub fn render_node_to_image(
     Some(surface)
 }
 
+/// Frees clip path and mask layers cached by the current thread.
+///
+/// See `Options::coverage_cache`.
+pub fn clear_coverage_cache() {
+    COVERAGE_CACHE.with(|c| c.borrow_mut().clear());
+}
+
 /// Renders SVG to canvas.
 pub fn render_to_canvas(
     tree: &usvg::Tree,
@@ -200,14 +301,25 @@ pub fn render_node_to_canvas(
 ) {
     let mut layers = create_layers(img_size, opt);
 
+    if opt.coverage_cache {
+        COVERAGE_CACHE.with(|c| c.borrow_mut().start_render());
+    }
+
     apply_viewbox_transform(view_box, img_size, &cr);
 
+    let _decoded = if opt.decoding_threads > 1 {
+        image::decode_images(node, opt, cr)
+    } else {
+        None
+    };
+
     let curr_ts = cr.get_matrix();
     let mut ts = utils::abs_transform(node);
     ts.append(&node.transform());
 
     cr.transform(ts.to_native());
-    render_node(node, opt, &mut layers, cr);
+    let area = layers.image_area();
+    render_node(node, opt, &mut layers, area, cr);
     cr.set_matrix(curr_ts);
 }
 
@@ -234,15 +346,19 @@ fn apply_viewbox_transform(
     cr.transform(ts.to_native());
 }
 
+/// Renders a node.
+///
+/// `area` is the canvas area covered by the `cr` target.
 fn render_node(
     node: &usvg::Node,
     opt: &Options,
     layers: &mut CairoLayers,
+    area: ScreenRect,
     cr: &cairo::Context,
 ) -> Option<Rect> {
     match *node.borrow() {
         usvg::NodeKind::Svg(_) => {
-            Some(render_group(node, opt, layers, cr))
+            Some(render_group(node, opt, layers, area, cr))
         }
         usvg::NodeKind::Path(ref path) => {
             Some(path::draw(&node.tree(), path, opt, cr))
@@ -254,7 +370,7 @@ fn render_node(
             Some(image::draw(img, opt, cr))
         }
         usvg::NodeKind::Group(ref g) => {
-            render_group_impl(node, g, opt, layers, cr)
+            render_group_impl(node, g, opt, layers, area, cr)
         }
         _ => None,
     }
@@ -264,19 +380,36 @@ fn render_group(
     parent: &usvg::Node,
     opt: &Options,
     layers: &mut CairoLayers,
+    area: ScreenRect,
     cr: &cairo::Context,
 ) -> Rect {
     let curr_ts = cr.get_matrix();
     let mut g_bbox = Rect::new_bbox();
 
-    for node in parent.children() {
+    let hidden = if opt.occlusion_culling {
+        let ts = usvg::Transform::from_native(&curr_ts);
+        occlusion::find_hidden(parent, &ts)
+    } else {
+        Vec::new()
+    };
+
+    for (idx, node) in parent.children().enumerate() {
+        if hidden.get(idx).cloned().unwrap_or(false) {
+            if let Some(bbox) = occlusion::culled_bbox(&node) {
+                g_bbox.expand(bbox);
+            }
+
+            stats::update(|s| s.culled_nodes += 1);
+            continue;
+        }
+
         // a-transform-001.svg
         // a-transform-010.svg
         // a-transform-016.svg
         // e-line-009.svg
         cr.transform(node.transform().to_native());
 
-        let bbox = render_node(&node, opt, layers, cr);
+        let bbox = render_node(&node, opt, layers, area, cr);
 
         if let Some(bbox) = bbox {
             g_bbox.expand(bbox);
@@ -294,33 +427,48 @@ fn render_group_impl(
     g: &usvg::Group,
     opt: &Options,
     layers: &mut CairoLayers,
+    area: ScreenRect,
     cr: &cairo::Context,
 ) -> Option<Rect> {
-    let sub_surface = layers.get()?;
-    let sub_surface = sub_surface.borrow_mut();
+    let curr_matrix = cr.get_matrix();
+    let ts = layers::canvas_transform(&usvg::Transform::from_native(&curr_matrix), area);
+
+    // The layer covers only the group content
+    // and only the tiles under the children are drawn on.
+    let bounds = layers.content_bounds(node, &ts);
+    let layer = layers.get(layers::layer_area(bounds, area))?;
+    layers.touch_children(&layer, node, &ts);
+    let regions = layer.regions();
+
+    let sub_surface = layer.borrow_mut();
 
     let sub_cr = cairo::Context::new(&*sub_surface);
-    sub_cr.set_matrix(cr.get_matrix());
+    // Keeps pixels outside the touched tiles transparent.
+    clip_regions(&regions, &sub_cr);
+    sub_cr.set_matrix(layers::area_transform(&ts, layer.area()).to_native());
 
-    let bbox = render_group(node, opt, layers, &sub_cr);
+    let bbox = render_group(node, opt, layers, layer.area(), &sub_cr);
 
     if let Some(ref id) = g.clip_path {
         if let Some(clip_node) = node.tree().defs_by_id(id) {
             if let usvg::NodeKind::ClipPath(ref cp) = *clip_node.borrow() {
-                clippath::apply(&clip_node, cp, opt, bbox, layers, &sub_cr);
+                clippath::apply(&clip_node, cp, opt, bbox, &ts, &layer, layers, &sub_cr);
             }
         }
     }
 
-    let curr_matrix = cr.get_matrix();
+    // Only the touched tiles have to be composited.
+    let (dx, dy) = layers::area_offset(layer.area(), area);
+    cr.save();
     cr.set_matrix(cairo::Matrix::identity());
+    cr.translate(dx, dy);
+    clip_regions(&regions, cr);
     cr.set_source_surface(&*sub_surface, 0.0, 0.0);
 
     if let Some(ref id) = g.mask {
         if let Some(mask_node) = node.tree().defs_by_id(id) {
             if let usvg::NodeKind::Mask(ref mask) = *mask_node.borrow() {
-                cr.set_matrix(curr_matrix);
-                mask::apply(&mask_node, mask, opt, bbox, g.opacity, layers, cr);
+                mask::apply(&mask_node, mask, opt, bbox, &ts, g.opacity, &layer, layers, area, cr);
             }
         }
     } else {
@@ -333,6 +481,7 @@ fn render_group_impl(
         }
     }
 
+    cr.restore();
     cr.set_matrix(curr_matrix);
 
     // All layers must be unlinked from the main context/cr after used.
@@ -348,15 +497,34 @@ fn render_group_impl(
 pub fn calc_node_bbox(
     node: &usvg::Node,
     opt: &Options,
+) -> Option<Rect> {
+    calc_node_bbox_impl(node, opt, false)
+}
+
+/// Calculates node's absolute bounding box.
+///
+/// When `conservative` is set, strokes include miter joins and square caps
+/// and are scaled by the node transform, so the result covers every rendered pixel.
+fn calc_node_bbox_impl(
+    node: &usvg::Node,
+    opt: &Options,
+    conservative: bool,
 ) -> Option<Rect> {
     let tree = node.tree();
 
     // We can't use 1x1 image, like in Qt backend because otherwise
-    // text layouts will be truncated.
-    let (surface, img_view) = create_surface(
-        tree.svg_node().size.to_screen_size(),
-        opt,
-    ).unwrap();
+    // text layouts will be truncated. But without text it's fine.
+    let has_text = node.descendants().any(|n| {
+        if let usvg::NodeKind::Text(_) = *n.borrow() { true } else { false }
+    });
+
+    let (surface, img_view) = if has_text {
+        create_surface(tree.svg_node().size.to_screen_size(), opt).unwrap()
+    } else {
+        let surface = cairo::ImageSurface::create(cairo::Format::ARgb32, 1, 1).unwrap();
+        let img_view = utils::fit_to(tree.svg_node().size.to_screen_size(), opt.fit_to);
+        (surface, img_view)
+    };
     let cr = cairo::Context::new(&surface);
 
     // We also have to apply the viewbox transform,
@@ -364,13 +532,14 @@ pub fn calc_node_bbox(
     apply_viewbox_transform(tree.svg_node().view_box, img_view, &cr);
 
     let abs_ts = utils::abs_transform(node);
-    _calc_node_bbox(node, opt, abs_ts, &cr)
+    _calc_node_bbox(node, opt, abs_ts, conservative, &cr)
 }
 
 fn _calc_node_bbox(
     node: &usvg::Node,
     opt: &Options,
     ts: usvg::Transform,
+    conservative: bool,
     cr: &cairo::Context,
 ) -> Option<Rect> {
     let mut ts2 = ts;
@@ -378,7 +547,12 @@ fn _calc_node_bbox(
 
     match *node.borrow() {
         usvg::NodeKind::Path(ref path) => {
-            Some(utils::path_bbox(&path.segments, path.stroke.as_ref(), &ts2))
+            let stroke = path.stroke.as_ref();
+            if conservative {
+                Some(utils::path_bounds(&path.segments, stroke, &ts2))
+            } else {
+                Some(utils::path_bbox(&path.segments, stroke, &ts2))
+            }
         }
         usvg::NodeKind::Text(ref text) => {
             let mut bbox = Rect::new_bbox();
@@ -401,7 +575,12 @@ fn _calc_node_bbox(
                 t.translate(block.bbox.x, block.bbox.y);
 
                 if !segments.is_empty() {
-                    let c_bbox = utils::path_bbox(&segments, block.stroke.as_ref(), &t);
+                    let stroke = block.stroke.as_ref();
+                    let c_bbox = if conservative {
+                        utils::path_bounds(&segments, stroke, &t)
+                    } else {
+                        utils::path_bbox(&segments, stroke, &t)
+                    };
                     bbox.expand(c_bbox);
                 }
             });
@@ -412,15 +591,20 @@ fn _calc_node_bbox(
             let segments = utils::rect_to_path(img.view_box.rect);
             Some(utils::path_bbox(&segments, None, &ts2))
         }
-        usvg::NodeKind::Group(_) => {
+        usvg::NodeKind::Svg(_) | usvg::NodeKind::Group(_) => {
             let mut bbox = Rect::new_bbox();
 
             for child in node.children() {
-                if let Some(c_bbox) = _calc_node_bbox(&child, opt, ts2, cr) {
+                if let Some(c_bbox) = _calc_node_bbox(&child, opt, ts2, conservative, cr) {
                     bbox.expand(c_bbox);
                 }
             }
 
+            // An empty group.
+            if bbox.x == f64::MAX {
+                return None;
+            }
+
             Some(bbox)
         }
         _ => None
@@ -464,9 +648,35 @@ fn create_subsurface(
     Some(try_create_surface!(size, None))
 }
 
-fn clear_subsurface(surface: &mut cairo::ImageSurface) {
+/// Copies a layer so it can be stored in the coverage cache.
+fn copy_subsurface(surface: &cairo::ImageSurface, size: ScreenSize) -> Option<cairo::ImageSurface> {
+    let copy = try_create_surface!(size, None);
+
+    {
+        let cr = cairo::Context::new(&copy);
+        cr.set_operator(cairo::Operator::Source);
+        cr.set_source_surface(surface, 0.0, 0.0);
+        cr.paint();
+    }
+
+    Some(copy)
+}
+
+fn clear_subsurface(surface: &mut cairo::ImageSurface, regions: &[ScreenRect]) {
     let cr = cairo::Context::new(&surface);
+    clip_regions(regions, &cr);
     cr.set_operator(cairo::Operator::Clear);
     cr.set_source_rgba(0.0, 0.0, 0.0, 0.0);
     cr.paint();
 }
+
+/// Clips the context to the layer regions.
+///
+/// Regions are in pixels, so the context must have an identity matrix.
+fn clip_regions(regions: &[ScreenRect], cr: &cairo::Context) {
+    for r in regions {
+        cr.rectangle(r.x as f64, r.y as f64, r.width as f64, r.height as f64);
+    }
+
+    cr.clip();
+}
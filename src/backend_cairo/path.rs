@@ -20,8 +20,19 @@ pub fn draw(
     opt: &Options,
     cr: &cairo::Context,
 ) -> Rect {
-    init_path(&path.segments, cr);
+    match rect_path(path) {
+        Some(r) => {
+            // cairo detects rectangles and fills them using a faster code path,
+            // but we can skip the path conversion at least.
+            cr.rectangle(r.x, r.y, r.width, r.height);
+        }
+        None => {
+            init_path(&path.segments, cr);
+        }
+    }
 
+    // The bbox must be the same as for other paths, since it's used
+    // by objectBoundingBox units and by `occlusion::culled_bbox`.
     let bbox = utils::path_bbox(&path.segments, None, &usvg::Transform::default());
 
     fill::apply(tree, &path.fill, opt, bbox, cr);
@@ -37,6 +48,19 @@ pub fn draw(
     bbox
 }
 
+/// Returns a rect if the path can be replaced with `cairo_rectangle`.
+fn rect_path(path: &usvg::Path) -> Option<Rect> {
+    let r = utils::path_to_rect(&path.segments)?;
+
+    // The stroke depends on the segments order, which must be the same
+    // as in `cairo_rectangle`.
+    if path.stroke.is_some() && !utils::is_rect_path(&path.segments, r) {
+        return None;
+    }
+
+    Some(r)
+}
+
 pub fn init_path(
     list: &[usvg::PathSegment],
     cr: &cairo::Context,
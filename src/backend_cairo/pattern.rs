@@ -13,6 +13,8 @@ use usvg::prelude::*;
 
 // self
 use super::prelude::*;
+use backend_utils;
+use stats;
 
 
 pub fn apply(
@@ -23,6 +25,8 @@ pub fn apply(
     bbox: Rect,
     cr: &cairo::Context,
 ) {
+    let _site = stats::enter_site(stats::Site::Pattern);
+
     let r = if pattern.units == usvg::Units::ObjectBoundingBox {
         pattern.rect.transform(usvg::Transform::from_bbox(bbox))
     } else {
@@ -38,29 +42,74 @@ pub fn apply(
         return;
     }
 
-    let img_size = Size::new(r.width * sx, r.height * sy).to_screen_size();
+    let full_size = Size::new(r.width * sx, r.height * sy).to_screen_size();
+
+    // Render only a part of the tile that is actually visible,
+    // so the tile size doesn't depend on the zoom level.
+    let region = {
+        let (x1, y1, x2, y2) = cr.clip_extents();
+        let visible = Rect::new(x1, y1, x2 - x1, y2 - y1);
+        backend_utils::pattern::visible_tile_region(
+            r, &pattern.transform, visible, full_size, sx, sy,
+        )
+    };
+
+    let img_size = match region {
+        Some(region) => region.size,
+        None => full_size,
+    };
+
     let surface = try_create_surface!(img_size, ());
+    stats::update(|s| {
+        s.patterns += 1;
+        s.surfaces_size += stats::surface_size(img_size.width, img_size.height);
+    });
 
     let sub_cr = cairo::Context::new(&surface);
     sub_cr.transform(cairo::Matrix::new(sx, 0.0, 0.0, sy, 0.0, 0.0));
-
-    if let Some(vbox) = pattern.view_box {
-        let ts = utils::view_box_to_transform(vbox.rect, vbox.aspect, r.size());
-        sub_cr.transform(ts.to_native());
-    } else if pattern.content_units == usvg::Units::ObjectBoundingBox {
-        // 'Note that this attribute has no effect if attribute `viewBox` is specified.'
-
-        // We don't use Transform::from_bbox(bbox) because `x` and `y` should be
-        // ignored for some reasons...
-        sub_cr.scale(bbox.width, bbox.height);
+    if let Some(region) = region {
+        sub_cr.translate(-(region.x as f64) / sx, -(region.y as f64) / sy);
     }
 
     let mut layers = super::create_layers(img_size, opt);
-    super::render_group(node, opt, &mut layers, &sub_cr);
+    let area = layers.image_area();
+
+    // A region can span several tile instances, so the tile content is repeated manually.
+    let (cols, rows) = region.map(|v| (v.cols, v.rows)).unwrap_or((1, 1));
+    let tile_matrix = sub_cr.get_matrix();
+    for row in 0..rows {
+        for col in 0..cols {
+            sub_cr.set_matrix(tile_matrix);
+
+            if region.is_some() {
+                sub_cr.translate(col as f64 * r.width, row as f64 * r.height);
+                sub_cr.rectangle(0.0, 0.0, r.width, r.height);
+                sub_cr.clip();
+            }
+
+            if let Some(vbox) = pattern.view_box {
+                let ts = utils::view_box_to_transform(vbox.rect, vbox.aspect, r.size());
+                sub_cr.transform(ts.to_native());
+            } else if pattern.content_units == usvg::Units::ObjectBoundingBox {
+                // 'Note that this attribute has no effect if attribute `viewBox` is specified.'
+
+                // We don't use Transform::from_bbox(bbox) because `x` and `y` should be
+                // ignored for some reasons...
+                sub_cr.scale(bbox.width, bbox.height);
+            }
+
+            super::render_group(node, opt, &mut layers, area, &sub_cr);
+            sub_cr.reset_clip();
+        }
+    }
 
     let mut ts = usvg::Transform::default();
     ts.append(&pattern.transform);
     ts.translate(r.x, r.y);
+    if let Some(region) = region {
+        ts.translate(region.origin.x + region.x as f64 / sx,
+                     region.origin.y + region.y as f64 / sy);
+    }
     ts.scale(1.0 / sx, 1.0 / sy);
 
 
@@ -83,7 +132,12 @@ pub fn apply(
 
 
     let patt = cairo::SurfacePattern::create(&surface);
-    patt.set_extend(cairo::Extend::Repeat);
+    if region.is_some() {
+        // The visible area is covered by a single tile.
+        patt.set_extend(cairo::Extend::None);
+    } else {
+        patt.set_extend(cairo::Extend::Repeat);
+    }
     patt.set_filter(cairo::Filter::Best);
 
     let mut m: cairo::Matrix = ts.to_native();
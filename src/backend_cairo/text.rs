@@ -25,6 +25,7 @@ use super::{
     fill,
     stroke,
 };
+use stats;
 
 pub use backend_utils::text::draw_blocks;
 
@@ -82,6 +83,8 @@ pub fn draw(
     opt: &Options,
     cr: &cairo::Context,
 ) -> Rect {
+    let _site = stats::enter_site(stats::Site::Text);
+
     let mut fm = PangoFontMetrics::new(opt, cr);
     draw_blocks(text_node, &mut fm, |block| draw_block(tree, block, opt, cr))
 }
@@ -9,31 +9,85 @@ use usvg::prelude::*;
 
 // self
 use super::prelude::*;
+use layers;
 use super::{
     path,
     text,
 };
 
 
+/// Applies the clip path to the `group` layer.
+///
+/// `ts` is the group canvas space transform and `p` draws on the group layer.
 pub fn apply(
     node: &usvg::Node,
     cp: &usvg::ClipPath,
     opt: &Options,
     bbox: Rect,
+    ts: &usvg::Transform,
+    group: &QtLayer,
     layers: &mut QtLayers,
     p: &qt::Painter,
 ) {
     // a-clip-path-001.svg
     // e-clipPath-001.svg
 
-    let clip_img = try_opt!(layers.get(), ());
-    let mut clip_img = clip_img.borrow_mut();
-    clip_img.fill(0, 0, 0, 255);
+    let key = if opt.coverage_cache {
+        let img_size = layers.image_size();
+        Some(super::COVERAGE_CACHE.with(|c| {
+            c.borrow_mut().key(node, ts, bbox, None, opt.usvg.dpi, img_size)
+        }))
+    } else {
+        None
+    };
 
-    let clip_p = qt::Painter::new(&clip_img);
+    if let Some(ref key) = key {
+        if let Some(clip_img) = super::COVERAGE_CACHE.with(|c| c.borrow_mut().get(key)) {
+            let offset = layers::area_offset(layers.image_area(), group.area());
+            draw_clip(&clip_img, offset, &group.regions(), p);
+            return;
+        }
+    }
+
+    // Cached layers can be reused by groups with a different content,
+    // so they are rendered fully.
+    let area = if key.is_some() { layers.image_area() } else { group.area() };
+    let clip_layer = try_opt!(layers.get(area), ());
+    if key.is_some() {
+        clip_layer.touch(None);
+    } else {
+        clip_layer.touch_from(group);
+    }
+
+    let mut clip_img = clip_layer.borrow_mut();
+
+    let clip_ts = layers::area_transform(ts, area);
+    render_clip(node, cp, opt, bbox, &clip_ts, &clip_layer.regions(), &mut clip_img);
+    draw_clip(&clip_img, layers::area_offset(area, group.area()), &group.regions(), p);
+
+    if let Some(key) = key {
+        if let Some(copy) = super::copy_image(&mut clip_img, layers.image_size()) {
+            super::COVERAGE_CACHE.with(|c| c.borrow_mut().insert(key, copy));
+        }
+    }
+}
+
+fn render_clip(
+    node: &usvg::Node,
+    cp: &usvg::ClipPath,
+    opt: &Options,
+    bbox: Rect,
+    ts: &usvg::Transform,
+    regions: &[ScreenRect],
+    clip_img: &mut qt::Image,
+) {
+    let img_size = ScreenSize::new(clip_img.width(), clip_img.height());
+    layers::fill_regions(&mut clip_img.data_mut(), img_size, regions, [0, 0, 0, 255]);
+
+    let clip_p = qt::Painter::new(clip_img);
     // e-clipPath-006.svg
     // e-clipPath-007.svg
-    clip_p.set_transform(&p.get_transform());
+    clip_p.set_transform(&ts.to_native());
     // e-clipPath-008.svg
     clip_p.apply_transform(&cp.transform.to_native());
 
@@ -64,8 +118,10 @@ pub fn apply(
     }
 
     clip_p.end();
+}
 
+fn draw_clip(clip_img: &qt::Image, offset: (f64, f64), regions: &[ScreenRect], p: &qt::Painter) {
     p.set_transform(&qt::Transform::default());
     p.set_composition_mode(qt::CompositionMode::CompositionMode_DestinationOut);
-    p.draw_image(0.0, 0.0, &clip_img);
+    super::draw_regions(clip_img, offset, regions, p);
 }
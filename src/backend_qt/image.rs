@@ -9,6 +9,7 @@ use usvg;
 // self
 use super::prelude::*;
 use backend_utils::image;
+use stats;
 
 
 pub fn draw(
@@ -16,6 +17,8 @@ pub fn draw(
     opt: &Options,
     p: &qt::Painter,
 ) -> Rect {
+    let _site = stats::enter_site(stats::Site::Image);
+
     if image.format == usvg::ImageFormat::SVG {
         draw_svg(image, opt, p);
     } else {
@@ -9,25 +9,51 @@ use usvg;
 // self
 use super::prelude::*;
 use backend_utils::mask;
+use layers;
 
 
+/// Masks the `group` layer.
+///
+/// `ts` is the group canvas space transform and `sub_p` draws on the group layer.
 pub fn apply(
     node: &usvg::Node,
     mask: &usvg::Mask,
     opt: &Options,
     bbox: Rect,
+    ts: &usvg::Transform,
+    group: &QtLayer,
     layers: &mut QtLayers,
     sub_p: &qt::Painter,
-    p: &qt::Painter,
 ) {
     // a-mask-001.svg
 
-    let mask_img = try_opt!(layers.get(), ());
-    let mut mask_img = mask_img.borrow_mut();
+    let key = if opt.coverage_cache {
+        let img_size = layers.image_size();
+        Some(super::COVERAGE_CACHE.with(|c| {
+            c.borrow_mut().key(node, ts, bbox, None, opt.usvg.dpi, img_size)
+        }))
+    } else {
+        None
+    };
+
+    if let Some(ref key) = key {
+        if let Some(mask_img) = super::COVERAGE_CACHE.with(|c| c.borrow_mut().get(key)) {
+            let offset = layers::area_offset(layers.image_area(), group.area());
+            draw_mask(&mask_img, offset, &group.regions(), sub_p);
+            return;
+        }
+    }
+
+    // The mask is needed only over the group.
+    // Cached layers can be reused by groups with a different content,
+    // so they are converted fully.
+    let area = if key.is_some() { layers.image_area() } else { group.area() };
+    let mask_layer = try_opt!(layers.get(area), ());
+    let mut mask_img = mask_layer.borrow_mut();
 
     {
         let mask_p = qt::Painter::new(&mask_img);
-        mask_p.set_transform(&p.get_transform());
+        mask_p.set_transform(&layers::area_transform(ts, area).to_native());
 
         let r = if mask.units == usvg::Units::ObjectBoundingBox {
             mask.rect.transform(usvg::Transform::from_bbox(bbox))
@@ -41,12 +67,33 @@ pub fn apply(
             mask_p.apply_transform(&qt::Transform::from_bbox(bbox));
         }
 
-        super::render_group(node, opt, layers, &mask_p);
+        if key.is_some() {
+            mask_layer.touch(None);
+        } else {
+            let content_ts = usvg::Transform::from_native(&mask_p.get_transform());
+            let content_ts = layers::canvas_transform(&content_ts, area);
+            layers.touch_children(&mask_layer, node, &content_ts);
+        }
+
+        super::render_group(node, opt, layers, area, &mask_p);
     }
 
-    mask::image_to_mask(&mut mask_img.data_mut(), layers.image_size(), None);
+    let size = ScreenSize::new(mask_img.width(), mask_img.height());
+    for region in mask_layer.regions() {
+        mask::image_to_mask(&mut mask_img.data_mut(), size, region, None);
+    }
+
+    draw_mask(&mask_img, layers::area_offset(area, group.area()), &group.regions(), sub_p);
+
+    if let Some(key) = key {
+        if let Some(copy) = super::copy_image(&mut mask_img, layers.image_size()) {
+            super::COVERAGE_CACHE.with(|c| c.borrow_mut().insert(key, copy));
+        }
+    }
+}
 
+fn draw_mask(mask_img: &qt::Image, offset: (f64, f64), regions: &[ScreenRect], sub_p: &qt::Painter) {
     sub_p.set_transform(&qt::Transform::default());
     sub_p.set_composition_mode(qt::CompositionMode::CompositionMode_DestinationIn);
-    sub_p.draw_image(0.0, 0.0, &mask_img);
+    super::draw_regions(mask_img, offset, regions, sub_p);
 }
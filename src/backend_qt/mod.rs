@@ -4,6 +4,10 @@
 
 //! Qt backend implementation.
 
+use std::cell::RefCell;
+use std::f64;
+use std::rc::Rc;
+
 // external
 use qt;
 use usvg;
@@ -11,8 +15,11 @@ use usvg::prelude::*;
 
 // self
 use prelude::*;
+use backend_utils::coverage::CoverageCache;
+use backend_utils::occlusion;
 use {
     layers,
+    stats,
     OutputImage,
     Render,
 };
@@ -42,11 +49,22 @@ mod text;
 mod prelude {
     pub use super::super::prelude::*;
     pub type QtLayers = super::layers::Layers<super::qt::Image>;
+    pub type QtLayer = super::layers::Layer<super::qt::Image>;
 }
 
 
 type QtLayers = layers::Layers<qt::Image>;
 
+thread_local!(static COVERAGE_CACHE: RefCell<CoverageCache<Rc<qt::Image>>>
+    = RefCell::new(CoverageCache::new()));
+
+/// Frees clip path and mask layers cached by the current thread.
+///
+/// See `Options::coverage_cache`.
+pub fn clear_coverage_cache() {
+    COVERAGE_CACHE.with(|c| c.borrow_mut().clear());
+}
+
 impl ConvTransform<qt::Transform> for usvg::Transform {
     fn to_native(&self) -> qt::Transform {
         qt::Transform::new(self.a, self.b, self.c, self.d, self.e, self.f)
@@ -81,6 +99,25 @@ impl Render for Backend {
         Some(Box::new(img))
     }
 
+    fn render_trimmed_to_image(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+    ) -> Option<(Box<OutputImage>, ScreenRect)> {
+        let (img, region) = render_trimmed_to_image(tree, opt)?;
+        Some((Box::new(img), region))
+    }
+
+    fn render_region_to_image(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+        region: ScreenRect,
+    ) -> Option<Box<OutputImage>> {
+        let img = render_region_to_image(tree, opt, region)?;
+        Some(Box::new(img))
+    }
+
     fn render_node_to_image(
         &self,
         node: &usvg::Node,
@@ -97,6 +134,14 @@ impl Render for Backend {
     ) -> Option<Rect> {
         calc_node_bbox(node, opt)
     }
+
+    fn trim_region(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+    ) -> Option<ScreenRect> {
+        trim_region(tree, opt)
+    }
 }
 
 impl OutputImage for qt::Image {
@@ -119,6 +164,57 @@ pub fn render_to_image(
     Some(img)
 }
 
+/// Renders only the part of the SVG that contains the content.
+///
+/// Returns the image and its region inside the full image.
+/// See `utils::trim_region` for details.
+pub fn render_trimmed_to_image(
+    tree: &usvg::Tree,
+    opt: &Options,
+) -> Option<(qt::Image, ScreenRect)> {
+    let region = match trim_region(tree, opt) {
+        Some(v) => v,
+        None => {
+            warn!("The image has no visible content.");
+            return None;
+        }
+    };
+
+    let img = render_region_to_image(tree, opt, region)?;
+    Some((img, region))
+}
+
+/// Returns the region of the image that contains all rendered pixels.
+///
+/// Unlike `calc_node_bbox`, includes stroke miter joins and square caps.
+/// See `utils::trim_region` for details.
+pub fn trim_region(
+    tree: &usvg::Tree,
+    opt: &Options,
+) -> Option<ScreenRect> {
+    let bbox = calc_node_bbox_impl(&tree.root(), opt, true)?;
+    utils::trim_region(tree, bbox, opt.fit_to)
+}
+
+/// Renders only the `region` of the image.
+///
+/// The region is in the pixels of the image returned by `render_to_image`.
+pub fn render_region_to_image(
+    tree: &usvg::Tree,
+    opt: &Options,
+    region: ScreenRect,
+) -> Option<qt::Image> {
+    let img_size = region.size();
+    let img = create_image(img_size, opt)?;
+
+    let view_box = utils::region_view_box(tree, region, opt.fit_to);
+    let painter = qt::Painter::new(&img);
+    render_node_to_canvas(&tree.root(), opt, view_box, img_size, &painter);
+    painter.end();
+
+    Some(img)
+}
+
 /// Renders SVG node to image.
 pub fn render_node_to_image(
     node: &usvg::Node,
@@ -166,6 +262,10 @@ pub fn render_node_to_canvas(
 ) {
     let mut layers = create_layers(img_size, opt);
 
+    if opt.coverage_cache {
+        COVERAGE_CACHE.with(|c| c.borrow_mut().start_render());
+    }
+
     apply_viewbox_transform(view_box, img_size, &painter);
 
     let curr_ts = painter.get_transform();
@@ -173,7 +273,8 @@ pub fn render_node_to_canvas(
     ts.append(&node.transform());
 
     painter.apply_transform(&ts.to_native());
-    render_node(node, opt, &mut layers, painter);
+    let area = layers.image_area();
+    render_node(node, opt, &mut layers, area, painter);
     painter.set_transform(&curr_ts);
 }
 
@@ -186,6 +287,14 @@ fn create_root_image(
     debug_assert_ne!(img_size.width, 0);
     debug_assert_ne!(img_size.height, 0);
 
+    let img = create_image(img_size, opt)?;
+    Some((img, img_size))
+}
+
+fn create_image(
+    img_size: ScreenSize,
+    opt: &Options,
+) -> Option<qt::Image> {
     let mut img = try_create_image!(img_size, None);
 
     // Fill background.
@@ -196,7 +305,7 @@ fn create_root_image(
     }
     img.set_dpi(opt.usvg.dpi);
 
-    Some((img, img_size))
+    Some(img)
 }
 
 /// Applies viewbox transformation to the painter.
@@ -209,15 +318,19 @@ fn apply_viewbox_transform(
     painter.apply_transform(&ts.to_native());
 }
 
+/// Renders a node.
+///
+/// `area` is the canvas area covered by the `p` target.
 fn render_node(
     node: &usvg::Node,
     opt: &Options,
     layers: &mut QtLayers,
+    area: ScreenRect,
     p: &qt::Painter,
 ) -> Option<Rect> {
     match *node.borrow() {
         usvg::NodeKind::Svg(_) => {
-            Some(render_group(node, opt, layers, p))
+            Some(render_group(node, opt, layers, area, p))
         }
         usvg::NodeKind::Path(ref path) => {
             Some(path::draw(&node.tree(), path, opt, p))
@@ -229,7 +342,7 @@ fn render_node(
             Some(image::draw(img, opt, p))
         }
         usvg::NodeKind::Group(ref g) => {
-            render_group_impl(node, g, opt, layers, p)
+            render_group_impl(node, g, opt, layers, area, p)
         }
         _ => None,
     }
@@ -239,19 +352,36 @@ fn render_group(
     parent: &usvg::Node,
     opt: &Options,
     layers: &mut QtLayers,
+    area: ScreenRect,
     p: &qt::Painter,
 ) -> Rect {
     let curr_ts = p.get_transform();
     let mut g_bbox = Rect::new_bbox();
 
-    for node in parent.children() {
+    let hidden = if opt.occlusion_culling {
+        let ts = usvg::Transform::from_native(&curr_ts);
+        occlusion::find_hidden(parent, &ts)
+    } else {
+        Vec::new()
+    };
+
+    for (idx, node) in parent.children().enumerate() {
+        if hidden.get(idx).cloned().unwrap_or(false) {
+            if let Some(bbox) = occlusion::culled_bbox(&node) {
+                g_bbox.expand(bbox);
+            }
+
+            stats::update(|s| s.culled_nodes += 1);
+            continue;
+        }
+
         // a-transform-001.svg
         // a-transform-010.svg
         // a-transform-016.svg
         // e-line-009.svg
         p.apply_transform(&node.transform().to_native());
 
-        let bbox = render_node(&node, opt, layers, p);
+        let bbox = render_node(&node, opt, layers, area, p);
         if let Some(bbox) = bbox {
             g_bbox.expand(bbox);
         }
@@ -268,20 +398,28 @@ fn render_group_impl(
     g: &usvg::Group,
     opt: &Options,
     layers: &mut QtLayers,
+    area: ScreenRect,
     p: &qt::Painter,
 ) -> Option<Rect> {
-    let sub_img = layers.get()?;
-    let sub_img = sub_img.borrow_mut();
+    let ts = layers::canvas_transform(&usvg::Transform::from_native(&p.get_transform()), area);
+
+    // The layer covers only the group content
+    // and only the tiles under the children are drawn on.
+    let bounds = layers.content_bounds(node, &ts);
+    let layer = layers.get(layers::layer_area(bounds, area))?;
+    layers.touch_children(&layer, node, &ts);
+
+    let sub_img = layer.borrow_mut();
 
     let sub_p = qt::Painter::new(&sub_img);
-    sub_p.set_transform(&p.get_transform());
+    sub_p.set_transform(&layers::area_transform(&ts, layer.area()).to_native());
 
-    let bbox = render_group(node, opt, layers, &sub_p);
+    let bbox = render_group(node, opt, layers, layer.area(), &sub_p);
 
     if let Some(ref id) = g.clip_path {
         if let Some(clip_node) = node.tree().defs_by_id(id) {
             if let usvg::NodeKind::ClipPath(ref cp) = *clip_node.borrow() {
-                clippath::apply(&clip_node, cp, opt, bbox, layers, &sub_p);
+                clippath::apply(&clip_node, cp, opt, bbox, &ts, &layer, layers, &sub_p);
             }
         }
     }
@@ -289,7 +427,7 @@ fn render_group_impl(
     if let Some(ref id) = g.mask {
         if let Some(mask_node) = node.tree().defs_by_id(id) {
             if let usvg::NodeKind::Mask(ref mask) = *mask_node.borrow() {
-                mask::apply(&mask_node, mask, opt, bbox, layers, &sub_p, p);
+                mask::apply(&mask_node, mask, opt, bbox, &ts, &layer, layers, &sub_p);
             }
         }
     }
@@ -305,7 +443,8 @@ fn render_group_impl(
     let curr_ts = p.get_transform();
     p.set_transform(&qt::Transform::default());
 
-    p.draw_image(0.0, 0.0, &sub_img);
+    // Only the touched tiles have to be composited.
+    draw_layer(&sub_img, layers::area_offset(layer.area(), area), &layer.regions(), p);
 
     p.set_opacity(1.0);
     p.set_transform(&curr_ts);
@@ -319,6 +458,18 @@ fn render_group_impl(
 pub fn calc_node_bbox(
     node: &usvg::Node,
     opt: &Options,
+) -> Option<Rect> {
+    calc_node_bbox_impl(node, opt, false)
+}
+
+/// Calculates node's absolute bounding box.
+///
+/// When `conservative` is set, strokes include miter joins and square caps
+/// and are scaled by the node transform, so the result covers every rendered pixel.
+fn calc_node_bbox_impl(
+    node: &usvg::Node,
+    opt: &Options,
+    conservative: bool,
 ) -> Option<Rect> {
     // Unwrap can't fail, because `None` will be returned only on OOM,
     // and we cannot hit it with a such small image.
@@ -327,13 +478,14 @@ pub fn calc_node_bbox(
     let p = qt::Painter::new(&img);
 
     let abs_ts = utils::abs_transform(node);
-    _calc_node_bbox(node, opt, abs_ts, &p)
+    _calc_node_bbox(node, opt, abs_ts, conservative, &p)
 }
 
 fn _calc_node_bbox(
     node: &usvg::Node,
     opt: &Options,
     ts: usvg::Transform,
+    conservative: bool,
     p: &qt::Painter,
 ) -> Option<Rect> {
     let mut ts2 = ts;
@@ -341,7 +493,12 @@ fn _calc_node_bbox(
 
     match *node.borrow() {
         usvg::NodeKind::Path(ref path) => {
-            Some(utils::path_bbox(&path.segments, path.stroke.as_ref(), &ts2))
+            let stroke = path.stroke.as_ref();
+            if conservative {
+                Some(utils::path_bounds(&path.segments, stroke, &ts2))
+            } else {
+                Some(utils::path_bbox(&path.segments, stroke, &ts2))
+            }
         }
         usvg::NodeKind::Text(ref text) => {
             let mut bbox = Rect::new_bbox();
@@ -361,7 +518,12 @@ fn _calc_node_bbox(
 
                 let segments = from_qt_path(&p_path);
                 if !segments.is_empty() {
-                    let c_bbox = utils::path_bbox(&segments, block.stroke.as_ref(), &t);
+                    let stroke = block.stroke.as_ref();
+                    let c_bbox = if conservative {
+                        utils::path_bounds(&segments, stroke, &t)
+                    } else {
+                        utils::path_bbox(&segments, stroke, &t)
+                    };
                     bbox.expand(c_bbox);
                 }
             });
@@ -372,15 +534,20 @@ fn _calc_node_bbox(
             let segments = utils::rect_to_path(img.view_box.rect);
             Some(utils::path_bbox(&segments, None, &ts2))
         }
-        usvg::NodeKind::Group(_) => {
+        usvg::NodeKind::Svg(_) | usvg::NodeKind::Group(_) => {
             let mut bbox = Rect::new_bbox();
 
             for child in node.children() {
-                if let Some(c_bbox) = _calc_node_bbox(&child, opt, ts2, p) {
+                if let Some(c_bbox) = _calc_node_bbox(&child, opt, ts2, conservative, p) {
                     bbox.expand(c_bbox);
                 }
             }
 
+            // An empty group.
+            if bbox.x == f64::MAX {
+                return None;
+            }
+
             Some(bbox)
         }
         _ => None
@@ -436,6 +603,45 @@ fn create_subimage(
     Some(img)
 }
 
-fn clear_image(img: &mut qt::Image) {
-    img.fill(0, 0, 0, 0);
+/// Copies a layer so it can be stored in the coverage cache.
+fn copy_image(img: &mut qt::Image, size: ScreenSize) -> Option<Rc<qt::Image>> {
+    let mut copy = try_create_image!(size, None);
+    copy.data_mut().copy_from_slice(&img.data_mut());
+    Some(Rc::new(copy))
+}
+
+fn clear_image(img: &mut qt::Image, regions: &[ScreenRect]) {
+    let size = ScreenSize::new(img.width(), img.height());
+    layers::fill_regions(&mut img.data_mut(), size, regions, [0, 0, 0, 0]);
+}
+
+/// Draws the layer regions of an image at `offset`.
+///
+/// Unlike `draw_regions`, keeps the painter clipping,
+/// since the painter can be provided by the caller.
+fn draw_layer(img: &qt::Image, offset: (f64, f64), regions: &[ScreenRect], p: &qt::Painter) {
+    for r in regions {
+        if r.x == 0 && r.y == 0 && r.width == img.width() && r.height == img.height() {
+            p.draw_image(offset.0, offset.1, img);
+            continue;
+        }
+
+        match img.copy(r.x, r.y, r.width, r.height) {
+            Some(part) => p.draw_image(offset.0 + r.x as f64, offset.1 + r.y as f64, &part),
+            None => warn!("Failed to copy a part of a layer."),
+        }
+    }
+}
+
+/// Draws an image at `offset` only over the layer regions.
+///
+/// The painter must have an identity transform and no clipping,
+/// since the clipping will be reset.
+fn draw_regions(img: &qt::Image, offset: (f64, f64), regions: &[ScreenRect], p: &qt::Painter) {
+    for r in regions {
+        p.set_clip_rect(r.x as f64, r.y as f64, r.width as f64, r.height as f64);
+        p.draw_image(offset.0, offset.1, img);
+    }
+
+    p.reset_clip_path();
 }
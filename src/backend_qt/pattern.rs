@@ -9,6 +9,7 @@ use usvg::prelude::*;
 
 // self
 use super::prelude::*;
+use stats;
 
 pub fn apply(
     pattern_node: &usvg::Node,
@@ -19,6 +20,8 @@ pub fn apply(
     opacity: usvg::Opacity,
     brush: &mut qt::Brush,
 ) {
+    let _site = stats::enter_site(stats::Site::Pattern);
+
     let r = if pattern.units == usvg::Units::ObjectBoundingBox {
         pattern.rect.transform(usvg::Transform::from_bbox(bbox))
     } else {
@@ -36,6 +39,10 @@ pub fn apply(
 
     let img_size = Size::new(r.width * sx, r.height * sy).to_screen_size();
     let mut img = try_create_image!(img_size, ());
+    stats::update(|s| {
+        s.patterns += 1;
+        s.surfaces_size += stats::surface_size(img_size.width, img_size.height);
+    });
 
     img.set_dpi(opt.usvg.dpi);
     img.fill(0, 0, 0, 0);
@@ -55,7 +62,8 @@ pub fn apply(
     }
 
     let mut layers = super::create_layers(img_size, opt);
-    super::render_group(pattern_node, opt, &mut layers, &p);
+    let area = layers.image_area();
+    super::render_group(pattern_node, opt, &mut layers, area, &p);
     p.end();
 
     let img = if opacity.fuzzy_ne(&1.0) {
@@ -17,6 +17,7 @@ use super::{
     fill,
     stroke,
 };
+use stats;
 
 pub use backend_utils::text::draw_blocks;
 
@@ -60,6 +61,8 @@ pub fn draw(
     opt: &Options,
     p: &qt::Painter,
 ) -> Rect {
+    let _site = stats::enter_site(stats::Site::Text);
+
     let mut fm = QtFontMetrics::new(p);
     draw_blocks(text_node, &mut fm, |block| draw_block(tree, block, opt, p))
 }
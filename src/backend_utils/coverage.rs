@@ -0,0 +1,440 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Clip path and mask coverage cache.
+//!
+//! Clip paths and masks are rendered into a separate layer first.
+//! When the same tree is rendered repeatedly using the same transform,
+//! those layers are identical, so they can be reused.
+
+use std::collections::HashMap;
+use std::collections::hash_map::DefaultHasher;
+use std::hash::{
+    Hash,
+    Hasher,
+};
+
+// external
+use usvg;
+use usvg::prelude::*;
+
+// self
+use geom::*;
+use stats;
+
+
+/// Maximum number of cached layers.
+const MAX_ENTRIES: usize = 32;
+/// Maximum amount of memory used by cached layers, in bytes.
+const MAX_BYTES: u64 = 128 * 1024 * 1024;
+
+
+/// A coverage cache key.
+///
+/// Contains everything a clip path or a mask layer depends on.
+pub struct CoverageKey {
+    node: usvg::Node,
+    fingerprint: u64,
+    params: Vec<u64>,
+    img_size: ScreenSize,
+}
+
+impl PartialEq for CoverageKey {
+    fn eq(&self, other: &Self) -> bool {
+        self.node == other.node
+            && self.fingerprint == other.fingerprint
+            && self.params == other.params
+            && self.img_size == other.img_size
+    }
+}
+
+struct Entry<T> {
+    key: CoverageKey,
+    value: T,
+    size: u64,
+    last_used: u64,
+}
+
+/// A least recently used coverage cache.
+///
+/// `T` is a cheaply cloneable reference to a layer.
+///
+/// Keys hold references to the `clipPath` and `mask` nodes, so their subtrees
+/// are kept alive, even after the tree itself was dropped, until the entry
+/// is evicted or the cache is cleared.
+pub struct CoverageCache<T> {
+    entries: Vec<Entry<T>>,
+    bytes: u64,
+    tick: u64,
+    /// Node fingerprints by ID, calculated during the current render.
+    fingerprints: HashMap<String, (usvg::Node, u64)>,
+}
+
+impl<T: Clone> CoverageCache<T> {
+    /// Creates an empty cache.
+    pub fn new() -> Self {
+        CoverageCache {
+            entries: Vec::new(),
+            bytes: 0,
+            tick: 0,
+            fingerprints: HashMap::new(),
+        }
+    }
+
+    /// Must be called before each render.
+    ///
+    /// The tree cannot be modified during the rendering, so fingerprints
+    /// are calculated only once per render and per node.
+    pub fn start_render(&mut self) {
+        self.fingerprints.clear();
+    }
+
+    /// Creates a key.
+    ///
+    /// `node` is a `clipPath` or `mask` element and `ts` is a canvas transform.
+    pub fn key(
+        &mut self,
+        node: &usvg::Node,
+        ts: &usvg::Transform,
+        bbox: Rect,
+        opacity: Option<usvg::Opacity>,
+        dpi: f64,
+        img_size: ScreenSize,
+    ) -> CoverageKey {
+        let opacity = opacity.map(|v| v.value()).unwrap_or(-1.0);
+
+        let params = [
+            ts.a, ts.b, ts.c, ts.d, ts.e, ts.f,
+            bbox.x, bbox.y, bbox.width, bbox.height,
+            opacity, dpi,
+        ];
+
+        // IDs are not unique between trees, so the node is checked as well.
+        let cached = match self.fingerprints.get(&*node.id()) {
+            Some(&(ref n, v)) if n == node => Some(v),
+            _ => None,
+        };
+
+        let fingerprint = match cached {
+            Some(v) => v,
+            None => {
+                let v = fingerprint(node);
+                self.fingerprints.insert(node.id().to_string(), (node.clone(), v));
+                v
+            }
+        };
+
+        CoverageKey {
+            node: node.clone(),
+            fingerprint,
+            params: params.iter().map(|v| v.to_bits()).collect(),
+            img_size,
+        }
+    }
+
+    /// Returns a cached layer.
+    pub fn get(&mut self, key: &CoverageKey) -> Option<T> {
+        self.tick += 1;
+        let tick = self.tick;
+
+        match self.entries.iter_mut().find(|e| e.key == *key) {
+            Some(entry) => {
+                entry.last_used = tick;
+                stats::update(|s| s.coverage_cache_hits += 1);
+                Some(entry.value.clone())
+            }
+            None => {
+                stats::update(|s| s.coverage_cache_misses += 1);
+                None
+            }
+        }
+    }
+
+    /// Stores a layer, evicting least recently used ones when the cache is full.
+    pub fn insert(&mut self, key: CoverageKey, value: T) {
+        let size = stats::surface_size(key.img_size.width, key.img_size.height);
+        if size > MAX_BYTES {
+            return;
+        }
+
+        // Entries with the same node are outdated now.
+        self.entries.retain(|e| e.key.node != key.node || e.key.fingerprint == key.fingerprint);
+
+        while !self.entries.is_empty()
+            && (self.entries.len() >= MAX_ENTRIES || self.bytes + size > MAX_BYTES)
+        {
+            let idx = self.entries.iter().enumerate()
+                .min_by_key(|&(_, e)| e.last_used)
+                .map(|(idx, _)| idx)
+                .unwrap();
+            self.entries.remove(idx);
+            self.bytes = self.entries.iter().map(|e| e.size).sum();
+        }
+
+        self.tick += 1;
+        self.entries.push(Entry {
+            key,
+            value,
+            size,
+            last_used: self.tick,
+        });
+        self.bytes = self.entries.iter().map(|e| e.size).sum();
+    }
+
+    /// Removes all cached layers.
+    pub fn clear(&mut self) {
+        self.entries.clear();
+        self.bytes = 0;
+        self.fingerprints.clear();
+    }
+}
+
+
+/// Calculates a hash of the node content, including referenced elements.
+///
+/// Used to invalidate cached layers when the tree has been modified.
+fn fingerprint(node: &usvg::Node) -> u64 {
+    let tree = node.tree();
+    let mut hasher = DefaultHasher::new();
+    let mut visited: Vec<String> = Vec::new();
+    let mut stack = vec![node.clone()];
+
+    while let Some(root) = stack.pop() {
+        for n in root.descendants() {
+            let kind = n.borrow();
+            hash_kind(&kind, &mut hasher);
+
+            for id in links(&kind) {
+                if !visited.iter().any(|v| v == id) {
+                    visited.push(id.to_string());
+                    if let Some(link) = tree.defs_by_id(id) {
+                        stack.push(link);
+                    }
+                }
+            }
+        }
+    }
+
+    hasher.finish()
+}
+
+/// Hashes fields that affect the rendering.
+///
+/// Numbers are hashed directly, since formatting is too slow for large paths.
+fn hash_kind(kind: &usvg::NodeKind, h: &mut DefaultHasher) {
+    match *kind {
+        usvg::NodeKind::Svg(_) | usvg::NodeKind::Defs => {
+            0u8.hash(h);
+        }
+        usvg::NodeKind::LinearGradient(ref lg) => {
+            1u8.hash(h);
+            hash_f64s(&[lg.x1, lg.y1, lg.x2, lg.y2], h);
+            hash_base_gradient(&lg.base, h);
+        }
+        usvg::NodeKind::RadialGradient(ref rg) => {
+            2u8.hash(h);
+            hash_f64s(&[rg.cx, rg.cy, rg.r, rg.fx, rg.fy], h);
+            hash_base_gradient(&rg.base, h);
+        }
+        usvg::NodeKind::ClipPath(ref cp) => {
+            3u8.hash(h);
+            (cp.units as u8).hash(h);
+            hash_ts(&cp.transform, h);
+        }
+        usvg::NodeKind::Mask(ref mask) => {
+            4u8.hash(h);
+            (mask.units as u8).hash(h);
+            (mask.content_units as u8).hash(h);
+            hash_rect(mask.rect, h);
+        }
+        usvg::NodeKind::Pattern(ref patt) => {
+            5u8.hash(h);
+            (patt.units as u8).hash(h);
+            (patt.content_units as u8).hash(h);
+            hash_ts(&patt.transform, h);
+            hash_rect(patt.rect, h);
+            match patt.view_box {
+                Some(vb) => {
+                    true.hash(h);
+                    hash_view_box(vb, h);
+                }
+                None => false.hash(h),
+            }
+        }
+        usvg::NodeKind::Path(ref path) => {
+            6u8.hash(h);
+            hash_ts(&path.transform, h);
+            hash_fill(&path.fill, h);
+            hash_stroke(&path.stroke, h);
+
+            path.segments.len().hash(h);
+            for seg in &path.segments {
+                match *seg {
+                    usvg::PathSegment::MoveTo { x, y } => {
+                        0u8.hash(h);
+                        hash_f64s(&[x, y], h);
+                    }
+                    usvg::PathSegment::LineTo { x, y } => {
+                        1u8.hash(h);
+                        hash_f64s(&[x, y], h);
+                    }
+                    usvg::PathSegment::CurveTo { x1, y1, x2, y2, x, y } => {
+                        2u8.hash(h);
+                        hash_f64s(&[x1, y1, x2, y2, x, y], h);
+                    }
+                    usvg::PathSegment::ClosePath => {
+                        3u8.hash(h);
+                    }
+                }
+            }
+        }
+        usvg::NodeKind::Text(ref text) => {
+            // Text is rare in clip paths and masks and has a lot of fields,
+            // so the formatting cost is acceptable.
+            7u8.hash(h);
+            format!("{:?}", text).hash(h);
+        }
+        usvg::NodeKind::Image(ref img) => {
+            8u8.hash(h);
+            hash_ts(&img.transform, h);
+            hash_view_box(img.view_box, h);
+            (img.format as u8).hash(h);
+
+            // Do not hash the image data itself.
+            match img.data {
+                usvg::ImageData::Path(ref path) => path.hash(h),
+                usvg::ImageData::Raw(ref data) => {
+                    (data.as_ptr() as usize).hash(h);
+                    data.len().hash(h);
+                }
+            }
+        }
+        usvg::NodeKind::Group(ref g) => {
+            9u8.hash(h);
+            hash_ts(&g.transform, h);
+            g.opacity.map(|v| v.value().to_bits()).hash(h);
+            g.clip_path.hash(h);
+            g.mask.hash(h);
+        }
+    }
+}
+
+fn hash_f64s(values: &[f64], h: &mut DefaultHasher) {
+    for v in values {
+        v.to_bits().hash(h);
+    }
+}
+
+fn hash_ts(ts: &usvg::Transform, h: &mut DefaultHasher) {
+    hash_f64s(&[ts.a, ts.b, ts.c, ts.d, ts.e, ts.f], h);
+}
+
+fn hash_rect(r: Rect, h: &mut DefaultHasher) {
+    hash_f64s(&[r.x, r.y, r.width, r.height], h);
+}
+
+fn hash_view_box(vb: usvg::ViewBox, h: &mut DefaultHasher) {
+    hash_rect(vb.rect, h);
+    (vb.aspect.align as u8).hash(h);
+    vb.aspect.defer.hash(h);
+    vb.aspect.slice.hash(h);
+}
+
+fn hash_base_gradient(g: &usvg::BaseGradient, h: &mut DefaultHasher) {
+    (g.units as u8).hash(h);
+    hash_ts(&g.transform, h);
+    (g.spread_method as u8).hash(h);
+
+    g.stops.len().hash(h);
+    for stop in &g.stops {
+        hash_f64s(&[stop.offset.value(), stop.opacity.value()], h);
+        hash_color(stop.color, h);
+    }
+}
+
+fn hash_paint(paint: &usvg::Paint, h: &mut DefaultHasher) {
+    match *paint {
+        usvg::Paint::Color(c) => hash_color(c, h),
+        usvg::Paint::Link(ref id) => id.hash(h),
+    }
+}
+
+fn hash_color(c: usvg::Color, h: &mut DefaultHasher) {
+    (c.red, c.green, c.blue).hash(h);
+}
+
+fn hash_fill(fill: &Option<usvg::Fill>, h: &mut DefaultHasher) {
+    if let Some(ref fill) = *fill {
+        true.hash(h);
+        hash_paint(&fill.paint, h);
+        fill.opacity.value().to_bits().hash(h);
+        (fill.rule as u8).hash(h);
+    } else {
+        false.hash(h);
+    }
+}
+
+fn hash_stroke(stroke: &Option<usvg::Stroke>, h: &mut DefaultHasher) {
+    if let Some(ref stroke) = *stroke {
+        true.hash(h);
+        hash_paint(&stroke.paint, h);
+        hash_f64s(&[stroke.width, stroke.miterlimit, stroke.dashoffset,
+                    stroke.opacity.value()], h);
+        (stroke.linecap as u8).hash(h);
+        (stroke.linejoin as u8).hash(h);
+
+        if let Some(ref list) = stroke.dasharray {
+            list.len().hash(h);
+            hash_f64s(list, h);
+        }
+    } else {
+        false.hash(h);
+    }
+}
+
+fn links(kind: &usvg::NodeKind) -> Vec<&str> {
+    fn push_paint<'a>(paint: &'a usvg::Paint, list: &mut Vec<&'a str>) {
+        if let usvg::Paint::Link(ref id) = *paint {
+            list.push(id);
+        }
+    }
+
+    let mut list = Vec::new();
+    match *kind {
+        usvg::NodeKind::Path(ref path) => {
+            if let Some(ref fill) = path.fill {
+                push_paint(&fill.paint, &mut list);
+            }
+
+            if let Some(ref stroke) = path.stroke {
+                push_paint(&stroke.paint, &mut list);
+            }
+        }
+        usvg::NodeKind::Text(ref text) => {
+            for chunk in &text.chunks {
+                for span in &chunk.spans {
+                    if let Some(ref fill) = span.fill {
+                        push_paint(&fill.paint, &mut list);
+                    }
+
+                    if let Some(ref stroke) = span.stroke {
+                        push_paint(&stroke.paint, &mut list);
+                    }
+                }
+            }
+        }
+        usvg::NodeKind::Group(ref g) => {
+            if let Some(ref id) = g.clip_path {
+                list.push(id);
+            }
+
+            if let Some(ref id) = g.mask {
+                list.push(id);
+            }
+        }
+        _ => {}
+    }
+
+    list
+}
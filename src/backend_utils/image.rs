@@ -11,6 +11,7 @@ use usvg::prelude::*;
 // self
 use utils;
 use geom::*;
+use passes;
 use {
     FitTo,
     Options,
@@ -28,6 +29,9 @@ pub fn load_sub_svg(
         },
         fit_to: FitTo::Original,
         background: None,
+        occlusion_culling: opt.occlusion_culling,
+        coverage_cache: false,
+        decoding_threads: 1,
     };
 
     let tree = match image.data {
@@ -42,6 +46,7 @@ pub fn load_sub_svg(
     };
 
     sanitize_sub_svg(&tree);
+    passes::simplify_effects(&tree);
 
     Some((tree, sub_opt))
 }
@@ -114,6 +119,57 @@ pub fn prepare_sub_svg_geom(
     (ts, clip)
 }
 
+/// Copies an RGB or RGBA image into a premultiplied BGRA one.
+///
+/// The destination image has the same size and a `width * 4` stride,
+/// which matches the cairo's `ARGB32` format on little endian.
+/// Only pixels inside the inclusive `region` are copied.
+pub fn copy_to_bgra_premultiplied(
+    src: &[u8],
+    size: ScreenSize,
+    stride: u32,
+    channels: u32,
+    region: (u32, u32, u32, u32),
+    dst: &mut [u8],
+) {
+    let (start_x, start_y, end_x, end_y) = region;
+
+    // We can't iterate over pixels directly, because width may not be equal to stride.
+    let mut i = 0;
+    for y in 0..size.height {
+        for x in 0..size.width {
+            if x >= start_x && y >= start_y && x <= end_x && y <= end_y {
+                let idx = (y * stride + x * channels) as usize;
+
+                // NOTE: will not work on big endian.
+                if channels == 4 {
+                    let r = src[idx + 0] as u32;
+                    let g = src[idx + 1] as u32;
+                    let b = src[idx + 2] as u32;
+                    let a = src[idx + 3] as u32;
+
+                    // https://www.cairographics.org/manual/cairo-Image-Surfaces.html#cairo-format-t
+                    let tr = a * r + 0x80;
+                    let tg = a * g + 0x80;
+                    let tb = a * b + 0x80;
+                    dst[i + 0] = (((tb >> 8) + tb) >> 8) as u8;
+                    dst[i + 1] = (((tg >> 8) + tg) >> 8) as u8;
+                    dst[i + 2] = (((tr >> 8) + tr) >> 8) as u8;
+                    dst[i + 3] = a as u8;
+                } else {
+                    dst[i + 0] = src[idx + 2];
+                    dst[i + 1] = src[idx + 1];
+                    dst[i + 2] = src[idx + 0];
+                    dst[i + 3] = 255;
+                }
+            }
+
+            // Destination is always BGRA.
+            i += 4;
+        }
+    }
+}
+
 pub fn get_abs_path(
     rel_path: &path::Path,
     opt: &Options,
@@ -9,22 +9,21 @@ use usvg;
 use geom::*;
 
 
-/// Converts an image to an alpha mask.
+/// Converts an image region to an alpha mask.
 pub fn image_to_mask(
     data: &mut [u8],
     img_size: ScreenSize,
+    region: ScreenRect,
     opacity: Option<usvg::Opacity>,
 ) {
-    let width = img_size.width;
-    let height = img_size.height;
-    let stride = width * 4;
+    let stride = img_size.width * 4;
 
     let coeff_r = 0.2125 / 255.0;
     let coeff_g = 0.7154 / 255.0;
     let coeff_b = 0.0721 / 255.0;
 
-    for y in 0..height {
-        for x in 0..width {
+    for y in region.y..region.y + region.height {
+        for x in region.x..region.x + region.width {
             let idx = (y * stride + x * 4) as usize;
 
             let r = data[idx + 2] as f64;
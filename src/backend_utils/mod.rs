@@ -2,6 +2,9 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+pub mod coverage;
 pub mod image;
 pub mod mask;
+pub mod occlusion;
+pub mod pattern;
 pub mod text;
@@ -0,0 +1,153 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Occlusion culling.
+//!
+//! Finds group children that are fully covered by later opaque siblings.
+//!
+//! Only simple cases are handled, so the result is always identical
+//! to the full rendering:
+//!
+//! - an occluder is a rectangular path with an opaque solid fill
+//!   that stays axis-aligned in the device space;
+//! - only paths and raster images can be culled;
+//! - a culled node must be inside a single occluder;
+//! - group children are never culled and never occlude.
+
+// external
+use usvg;
+use usvg::prelude::*;
+
+// self
+use geom::*;
+use utils;
+
+
+/// Returns a list of flags for each child of the `parent`.
+///
+/// `true` indicates that the child is hidden and can be skipped.
+///
+/// `ts` is a `parent` canvas transform.
+pub fn find_hidden(parent: &usvg::Node, ts: &usvg::Transform) -> Vec<bool> {
+    let children: Vec<_> = parent.children().collect();
+    let mut hidden = vec![false; children.len()];
+
+    // Occluders in device pixels that are fully covered.
+    let mut occluders: Vec<(f64, f64, f64, f64)> = Vec::new();
+
+    for (idx, node) in children.iter().enumerate().rev() {
+        let mut node_ts = *ts;
+        node_ts.append(&node.transform());
+
+        if !occluders.is_empty() {
+            if let Some(r) = device_bounds(node, &node_ts) {
+                // Antialiasing can touch any pixel the bounds are intersecting with.
+                let x1 = r.x.floor();
+                let y1 = r.y.floor();
+                let x2 = (r.x + r.width).ceil();
+                let y2 = (r.y + r.height).ceil();
+
+                hidden[idx] = occluders.iter().any(|&(ox1, oy1, ox2, oy2)| {
+                    x1 >= ox1 && y1 >= oy1 && x2 <= ox2 && y2 <= oy2
+                });
+            }
+        }
+
+        if hidden[idx] {
+            continue;
+        }
+
+        if let Some(r) = occluder_rect(node, &node_ts) {
+            // Only pixels that are fully inside the rect are opaque.
+            let x1 = r.x.ceil();
+            let y1 = r.y.ceil();
+            let x2 = (r.x + r.width).floor();
+            let y2 = (r.y + r.height).floor();
+
+            if x2 > x1 && y2 > y1 {
+                occluders.push((x1, y1, x2, y2));
+            }
+        }
+    }
+
+    hidden
+}
+
+/// Returns a bbox that the backend rendering functions return for the culled node.
+///
+/// Group bbox is used for clipping and masking, so it should not depend on culling.
+pub fn culled_bbox(node: &usvg::Node) -> Option<Rect> {
+    match *node.borrow() {
+        usvg::NodeKind::Path(ref path) => {
+            Some(utils::path_bbox(&path.segments, None, &usvg::Transform::default()))
+        }
+        usvg::NodeKind::Image(ref img) => {
+            Some(img.view_box.rect)
+        }
+        _ => None,
+    }
+}
+
+/// Returns conservative node bounds in the device space.
+fn device_bounds(node: &usvg::Node, ts: &usvg::Transform) -> Option<Rect> {
+    match *node.borrow() {
+        usvg::NodeKind::Path(ref path) => {
+            if path.segments.len() < 2 {
+                return None;
+            }
+
+            let mut r = utils::path_bbox(&path.segments, None, ts);
+
+            if let Some(ref stroke) = path.stroke {
+                let (sx, sy) = ts.get_scale();
+                let w = utils::stroke_margin(stroke) * sx.max(sy);
+
+                r = Rect::new(r.x - w, r.y - w, r.width + w * 2.0, r.height + w * 2.0);
+            }
+
+            Some(r)
+        }
+        usvg::NodeKind::Image(ref img) => {
+            // SVG images are not clipped by the view box.
+            if img.format == usvg::ImageFormat::SVG {
+                return None;
+            }
+
+            Some(utils::transform_rect(img.view_box.rect, ts))
+        }
+        _ => None,
+    }
+}
+
+/// Returns an opaque device space rect covered by the node.
+fn occluder_rect(node: &usvg::Node, ts: &usvg::Transform) -> Option<Rect> {
+    let kind = node.borrow();
+    let path = match *kind {
+        usvg::NodeKind::Path(ref path) => path,
+        _ => return None,
+    };
+
+    match path.fill {
+        Some(ref fill) => {
+            match fill.paint {
+                usvg::Paint::Color(_) => {}
+                _ => return None,
+            }
+
+            if !fill.opacity.fuzzy_eq(&1.0) {
+                return None;
+            }
+        }
+        None => return None,
+    }
+
+    // The transform must keep the rect axis-aligned.
+    if !((ts.b.is_fuzzy_zero() && ts.c.is_fuzzy_zero()) ||
+         (ts.a.is_fuzzy_zero() && ts.d.is_fuzzy_zero())) {
+        return None;
+    }
+
+    let r = utils::path_to_rect(&path.segments)?;
+    Some(utils::transform_rect(r, ts))
+}
@@ -0,0 +1,210 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::f64;
+
+// external
+use usvg;
+use usvg::prelude::*;
+
+// self
+use geom::*;
+
+
+/// A visible part of a pattern.
+///
+/// The region starts inside a single tile instance and can span
+/// the following ones, which are rendered by repeating the tile content.
+#[derive(Clone, Copy, Debug)]
+pub struct TileRegion {
+    /// Region offset inside the first tile instance image, in pixels.
+    pub x: u32,
+    /// Region offset inside the first tile instance image, in pixels.
+    pub y: u32,
+    /// Region size, in pixels.
+    pub size: ScreenSize,
+    /// Origin of the first tile instance, relative to the pattern rect origin.
+    pub origin: Point,
+    /// Number of tile instance columns covered by the region.
+    pub cols: u32,
+    /// Number of tile instance rows covered by the region.
+    pub rows: u32,
+}
+
+/// Returns a part of the pattern that covers the visible area.
+///
+/// `tile` is a pattern rect, `ts` is a pattern transform and `visible` is a visible area
+/// in the user space of the filled element. `img_size` is the full tile image size
+/// and `sx`/`sy` is the device scale.
+///
+/// Returns `None` when the region isn't smaller than the whole tile.
+/// In this case, the whole tile should be rendered and repeated.
+pub fn visible_tile_region(
+    tile: Rect,
+    ts: &usvg::Transform,
+    visible: Rect,
+    img_size: ScreenSize,
+    sx: f64,
+    sy: f64,
+) -> Option<TileRegion> {
+    if !(tile.width > 0.0 && tile.height > 0.0) {
+        return None;
+    }
+
+    // Map the visible area into the tile coordinates.
+    let mut pts = ts.clone();
+    pts.translate(tile.x, tile.y);
+    let (a, b, c, d, e, f) = (pts.a, pts.b, pts.c, pts.d, pts.e, pts.f);
+    let det = a * d - b * c;
+    if det.is_fuzzy_zero() {
+        return None;
+    }
+
+    let map = |x: f64, y: f64| {
+        let x = x - e;
+        let y = y - f;
+        ((d * x - c * y) / det, (a * y - b * x) / det)
+    };
+
+    let mut x0 = f64::MAX;
+    let mut y0 = f64::MAX;
+    let mut x1 = f64::MIN;
+    let mut y1 = f64::MIN;
+    let corners = [
+        (visible.x, visible.y),
+        (visible.x + visible.width, visible.y),
+        (visible.x, visible.y + visible.height),
+        (visible.x + visible.width, visible.y + visible.height),
+    ];
+    for &(x, y) in &corners {
+        let (x, y) = map(x, y);
+        x0 = x0.min(x);
+        y0 = y0.min(y);
+        x1 = x1.max(x);
+        y1 = y1.max(y);
+    }
+
+    if !(x0.is_finite() && y0.is_finite() && x1.is_finite() && y1.is_finite()) {
+        return None;
+    }
+
+    // Move to the tile instance that contains the top-left corner.
+    let nx = (x0 / tile.width).floor();
+    let ny = (y0 / tile.height).floor();
+    let x0 = x0 - nx * tile.width;
+    let x1 = x1 - nx * tile.width;
+    let y0 = y0 - ny * tile.height;
+    let y1 = y1 - ny * tile.height;
+
+    // Tile instances covered by the visible area.
+    let cols = (x1 / tile.width).ceil().max(1.0);
+    let rows = (y1 / tile.height).ceil().max(1.0);
+
+    // Snap to pixels, with a one pixel margin for filtering.
+    let (w, h) = if cols == 1.0 && rows == 1.0 {
+        (img_size.width as f64, img_size.height as f64)
+    } else {
+        ((cols * tile.width * sx).ceil(), (rows * tile.height * sy).ceil())
+    };
+    let px0 = f64_bound(0.0, (x0 * sx).floor() - 1.0, w) as u32;
+    let py0 = f64_bound(0.0, (y0 * sy).floor() - 1.0, h) as u32;
+    let px1 = f64_bound(0.0, (x1 * sx).ceil() + 1.0, w) as u32;
+    let py1 = f64_bound(0.0, (y1 * sy).ceil() + 1.0, h) as u32;
+
+    let size = ScreenSize::new(
+        ::std::cmp::max(px1.saturating_sub(px0), 1),
+        ::std::cmp::max(py1.saturating_sub(py0), 1),
+    );
+
+    let region_len = size.width as u64 * size.height as u64;
+    let tile_len = img_size.width as u64 * img_size.height as u64;
+    if region_len >= tile_len {
+        return None;
+    }
+
+    Some(TileRegion {
+        x: px0,
+        y: py0,
+        size,
+        origin: Point::new(nx * tile.width, ny * tile.height),
+        cols: cols as u32,
+        rows: rows as u32,
+    })
+}
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn region(
+        tile: Rect,
+        ts: usvg::Transform,
+        visible: Rect,
+    ) -> Option<(u32, u32, u32, u32, (f64, f64), u32, u32)> {
+        // A 10x device scale.
+        let img_size = ScreenSize::new((tile.width * 10.0) as u32, (tile.height * 10.0) as u32);
+        visible_tile_region(tile, &ts, visible, img_size, 10.0, 10.0).map(|r| {
+            (r.x, r.y, r.size.width, r.size.height, (r.origin.x, r.origin.y), r.cols, r.rows)
+        })
+    }
+
+    fn translate(x: f64, y: f64) -> usvg::Transform {
+        usvg::Transform::new(1.0, 0.0, 0.0, 1.0, x, y)
+    }
+
+    #[test]
+    fn inside_tile() {
+        let tile = Rect::new(0.0, 0.0, 100.0, 100.0);
+
+        // Snapped to pixels with a one pixel margin.
+        assert_eq!(region(tile, translate(0.0, 0.0), Rect::new(20.0, 30.0, 10.0, 10.0)),
+                   Some((199, 299, 102, 102, (0.0, 0.0), 1, 1)));
+
+        // The margin is clipped by the tile.
+        assert_eq!(region(tile, translate(0.0, 0.0), Rect::new(0.0, 90.0, 10.0, 10.0)),
+                   Some((0, 899, 101, 101, (0.0, 0.0), 1, 1)));
+    }
+
+    #[test]
+    fn mapped_to_tile_instance() {
+        // The pattern transform and the rect origin are applied.
+        let tile = Rect::new(5.0, 5.0, 100.0, 100.0);
+        assert_eq!(region(tile, translate(10.0, 0.0), Rect::new(215.0, 35.0, 10.0, 10.0)),
+                   Some((0, 299, 101, 102, (200.0, 0.0), 1, 1)));
+
+        // A scaled pattern.
+        let tile = Rect::new(0.0, 0.0, 100.0, 100.0);
+        let ts = usvg::Transform::new(2.0, 0.0, 0.0, 2.0, 0.0, 0.0);
+        assert_eq!(region(tile, ts, Rect::new(40.0, 60.0, 20.0, 20.0)),
+                   Some((199, 299, 102, 102, (0.0, 0.0), 1, 1)));
+    }
+
+    #[test]
+    fn across_tile_edges() {
+        let tile = Rect::new(0.0, 0.0, 100.0, 100.0);
+
+        // The margin is not clipped between the instances.
+        assert_eq!(region(tile, translate(0.0, 0.0), Rect::new(90.0, 10.0, 20.0, 10.0)),
+                   Some((899, 99, 202, 102, (0.0, 0.0), 2, 1)));
+
+        assert_eq!(region(tile, translate(0.0, 0.0), Rect::new(-10.0, -10.0, 20.0, 20.0)),
+                   Some((899, 899, 202, 202, (-100.0, -100.0), 2, 2)));
+    }
+
+    #[test]
+    fn whole_tile() {
+        let tile = Rect::new(0.0, 0.0, 100.0, 100.0);
+
+        // Not smaller than the tile.
+        assert_eq!(region(tile, translate(0.0, 0.0), Rect::new(0.0, 0.0, 100.0, 100.0)), None);
+        assert_eq!(region(tile, translate(0.0, 0.0), Rect::new(50.0, 50.0, 500.0, 500.0)), None);
+
+        // Degenerate.
+        assert_eq!(region(Rect::new(0.0, 0.0, 0.0, 100.0), translate(0.0, 0.0),
+                          Rect::new(0.0, 0.0, 10.0, 10.0)), None);
+        assert_eq!(region(tile, usvg::Transform::new(1.0, 2.0, 2.0, 4.0, 0.0, 0.0),
+                          Rect::new(0.0, 0.0, 10.0, 10.0)), None);
+    }
+}
@@ -47,7 +47,7 @@ pub fn draw_blocks<Font, Draw>(
     bbox
 }
 
-fn prepare_blocks<Font>(
+pub fn prepare_blocks<Font>(
     text_kind: &usvg::Text,
     font_metrics: &mut FontMetrics<Font>,
 ) -> Vec<TextBlock<Font>> {
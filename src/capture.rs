@@ -0,0 +1,184 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Slow render capture.
+//!
+//! Writes a diagnostic bundle when parsing or rendering takes too long
+//! or allocates too much, so the input can be reproduced offline.
+
+use std::fs;
+use std::io::{
+    self,
+    Write,
+};
+use std::path;
+use std::time::{
+    Duration,
+    SystemTime,
+    UNIX_EPOCH,
+};
+
+// external
+use usvg;
+use svgdom::{
+    self,
+    WriteBuffer,
+};
+
+// self
+use stats::RenderStats;
+use {
+    FitTo,
+    Options,
+};
+
+
+/// Capture thresholds.
+#[derive(Clone, Copy, Default, Debug)]
+pub struct Thresholds {
+    /// A wall time of a single phase.
+    pub time: Option<Duration>,
+    /// An amount of memory allocated for layers and pattern tiles, in bytes.
+    ///
+    /// See `RenderStats::surfaces_size`.
+    pub memory: Option<u64>,
+}
+
+impl Thresholds {
+    /// Checks that any of the phases or the memory usage exceeds the thresholds.
+    pub fn is_exceeded(&self, timings: &[(&str, Duration)], stats: &RenderStats) -> bool {
+        if let Some(time) = self.time {
+            if timings.iter().any(|&(_, d)| d > time) {
+                return true;
+            }
+        }
+
+        if let Some(memory) = self.memory {
+            if stats.surfaces_size > memory {
+                return true;
+            }
+        }
+
+        false
+    }
+}
+
+
+/// A diagnostic bundle.
+pub struct Bundle<'a> {
+    /// Input SVG data.
+    ///
+    /// Can be SVG or SVGZ.
+    pub input: &'a [u8],
+    /// Rendering options.
+    pub opt: &'a Options,
+    /// Phases timings.
+    pub timings: &'a [(&'a str, Duration)],
+    /// Rendering statistics.
+    pub stats: RenderStats,
+    /// A preprocessed tree.
+    ///
+    /// `None` when parsing failed.
+    pub tree: Option<&'a usvg::Tree>,
+}
+
+impl<'a> Bundle<'a> {
+    /// Writes the bundle to a new subdirectory of `dir`.
+    ///
+    /// The bundle contains:
+    ///
+    /// - `input.svg` or `input.svgz` - the input data as is
+    /// - `options.txt` - rendering options
+    /// - `stats.txt` - phases timings and rendering statistics
+    /// - `tree.svg` - the preprocessed tree, if any
+    ///
+    /// Returns a path to the bundle directory.
+    pub fn write(&self, dir: &path::Path) -> io::Result<path::PathBuf> {
+        let bundle_dir = dir.join(bundle_name());
+        fs::create_dir_all(&bundle_dir)?;
+
+        // SVGZ starts with a GZip magic.
+        let input_name = if self.input.starts_with(&[0x1f, 0x8b]) { "input.svgz" } else { "input.svg" };
+        write_file(&bundle_dir.join(input_name), self.input)?;
+
+        write_file(&bundle_dir.join("options.txt"), options_to_string(self.opt).as_bytes())?;
+
+        let mut s = String::new();
+        for &(name, d) in self.timings {
+            s.push_str(&format!("{}: {:.2}ms\n", name, duration_to_ms(d)));
+        }
+        s.push_str(&format!("layers: {}\n", self.stats.layers));
+        s.push_str(&format!("patterns: {}\n", self.stats.patterns));
+        s.push_str(&format!("surfaces size: {}\n", self.stats.surfaces_size));
+        s.push_str(&format!("culled nodes: {}\n", self.stats.culled_nodes));
+        s.push_str(&format!("coverage cache hits: {}\n", self.stats.coverage_cache_hits));
+        s.push_str(&format!("coverage cache misses: {}\n", self.stats.coverage_cache_misses));
+        write_file(&bundle_dir.join("stats.txt"), s.as_bytes())?;
+
+        if let Some(tree) = self.tree {
+            write_file(&bundle_dir.join("tree.svg"), &dump_tree(tree))?;
+        }
+
+        Ok(bundle_dir)
+    }
+}
+
+/// Converts a tree to an SVG data.
+///
+/// Used to dump the preprocessed tree.
+pub fn dump_tree(tree: &usvg::Tree) -> Vec<u8> {
+    let opt = svgdom::WriteOptions {
+        indent: svgdom::Indent::Spaces(2),
+        attributes_indent: svgdom::Indent::Spaces(3),
+        attributes_order: svgdom::AttributesOrder::Specification,
+        .. svgdom::WriteOptions::default()
+    };
+
+    let svgdoc = tree.to_svgdom();
+
+    let mut out = Vec::new();
+    svgdoc.write_buf_opt(&opt, &mut out);
+    out
+}
+
+/// Converts `Duration` to milliseconds.
+pub fn duration_to_ms(d: Duration) -> f64 {
+    d.as_secs() as f64 * 1000.0 + d.subsec_nanos() as f64 / 1_000_000.0
+}
+
+fn bundle_name() -> String {
+    let ts = SystemTime::now().duration_since(UNIX_EPOCH).unwrap_or(Duration::from_secs(0));
+    format!("resvg-{}-{:09}", ts.as_secs(), ts.subsec_nanos())
+}
+
+fn options_to_string(opt: &Options) -> String {
+    let fit_to = match opt.fit_to {
+        FitTo::Original => "original".to_string(),
+        FitTo::Width(w) => format!("width {}", w),
+        FitTo::Height(h) => format!("height {}", h),
+        FitTo::Zoom(z) => format!("zoom {}", z),
+    };
+
+    let background = match opt.background {
+        Some(c) => format!("#{:02x}{:02x}{:02x}", c.red, c.green, c.blue),
+        None => "none".to_string(),
+    };
+
+    format!("\
+path: {:?}
+dpi: {}
+keep named groups: {}
+fit to: {}
+background: {}
+occlusion culling: {}
+coverage cache: {}
+decoding threads: {}
+", opt.usvg.path, opt.usvg.dpi, opt.usvg.keep_named_groups, fit_to, background,
+   opt.occlusion_culling, opt.coverage_cache, opt.decoding_threads)
+}
+
+fn write_file(path: &path::Path, data: &[u8]) -> io::Result<()> {
+    let mut f = fs::File::create(path)?;
+    f.write_all(data)
+}
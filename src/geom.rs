@@ -67,6 +67,41 @@ impl fmt::Display for ScreenSize {
 }
 
 
+/// A 2D screen rect representation.
+#[allow(missing_docs)]
+#[derive(Clone, Copy, PartialEq)]
+pub struct ScreenRect {
+    pub x: u32,
+    pub y: u32,
+    pub width: u32,
+    pub height: u32,
+}
+
+impl ScreenRect {
+    /// Creates a new `ScreenRect` from values.
+    pub fn new(x: u32, y: u32, width: u32, height: u32) -> Self {
+        ScreenRect { x, y, width, height }
+    }
+
+    /// Returns rect's size.
+    pub fn size(&self) -> ScreenSize {
+        ScreenSize::new(self.width, self.height)
+    }
+}
+
+impl fmt::Debug for ScreenRect {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "ScreenRect({} {} {} {})", self.x, self.y, self.width, self.height)
+    }
+}
+
+impl fmt::Display for ScreenRect {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "{:?}", self)
+    }
+}
+
+
 /// Additional `Size` methods.
 pub trait SizeExt {
     /// Converts `Size` to `ScreenSize`.
@@ -2,27 +2,170 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+use std::f64;
 use std::ops::Deref;
 use std::cell::RefCell;
 use std::rc::Rc;
 
-use ScreenSize;
+use usvg;
 
+use geom::*;
+use stats;
+use utils;
+
+
+/// Layer tile size in pixels.
+const TILE_SIZE: u32 = 64;
 
 type LayerData<T> = Rc<RefCell<T>>;
 
+/// Tiles of a layer that were drawn on.
+///
+/// Tiles are counted from the layer origin.
+/// Pixels outside the touched tiles are always transparent,
+/// so clearing, compositing and mask conversion can skip them.
+struct Tiles {
+    size: ScreenSize,
+    cols: u32,
+    rows: u32,
+    touched: Vec<bool>,
+    /// The bottom-right corner of the touched rects.
+    ///
+    /// Rects are clipped by the layer, but the drawing is not,
+    /// so it can reach the image part outside of the layer.
+    extent: (f64, f64),
+}
+
+impl Tiles {
+    fn new(size: ScreenSize) -> Self {
+        let mut tiles = Tiles {
+            size,
+            cols: 0,
+            rows: 0,
+            touched: Vec::new(),
+            extent: (0.0, 0.0),
+        };
+
+        tiles.reset(size);
+        tiles
+    }
+
+    /// Resizes tiles to the layer size and marks all of them as not drawn on.
+    fn reset(&mut self, size: ScreenSize) {
+        self.size = size;
+        self.cols = (size.width + TILE_SIZE - 1) / TILE_SIZE;
+        self.rows = (size.height + TILE_SIZE - 1) / TILE_SIZE;
+        self.touched.clear();
+        self.touched.resize((self.cols * self.rows) as usize, false);
+        self.extent = (0.0, 0.0);
+    }
+
+    /// Marks tiles that intersect the rect as drawn on.
+    ///
+    /// The rect is in the layer pixels. `None` marks all tiles.
+    fn touch(&mut self, r: Option<Rect>) {
+        let r = match r {
+            Some(r) => r,
+            None => {
+                for t in &mut self.touched {
+                    *t = true;
+                }
+
+                self.extent = (f64::MAX, f64::MAX);
+                return;
+            }
+        };
+
+        if !(r.width > 0.0 && r.height > 0.0) {
+            return;
+        }
+
+        self.extent.0 = self.extent.0.max(r.x + r.width);
+        self.extent.1 = self.extent.1.max(r.y + r.height);
+
+        let w = self.size.width as f64;
+        let h = self.size.height as f64;
+        let x1 = f64_bound(0.0, r.x.floor(), w) as u32;
+        let y1 = f64_bound(0.0, r.y.floor(), h) as u32;
+        let x2 = f64_bound(0.0, (r.x + r.width).ceil(), w) as u32;
+        let y2 = f64_bound(0.0, (r.y + r.height).ceil(), h) as u32;
+
+        if x2 <= x1 || y2 <= y1 {
+            return;
+        }
+
+        for row in y1 / TILE_SIZE..(y2 - 1) / TILE_SIZE + 1 {
+            for col in x1 / TILE_SIZE..(x2 - 1) / TILE_SIZE + 1 {
+                self.touched[(row * self.cols + col) as usize] = true;
+            }
+        }
+    }
+
+    /// Returns touched areas in the layer pixels.
+    ///
+    /// Neighbouring tiles are merged into rects.
+    fn regions(&self) -> Vec<ScreenRect> {
+        let mut regions: Vec<ScreenRect> = Vec::new();
+        for row in 0..self.rows {
+            let y = row * TILE_SIZE;
+            let height = TILE_SIZE.min(self.size.height - y);
+
+            let mut col = 0;
+            while col < self.cols {
+                if !self.touched[(row * self.cols + col) as usize] {
+                    col += 1;
+                    continue;
+                }
+
+                let start = col;
+                while col < self.cols && self.touched[(row * self.cols + col) as usize] {
+                    col += 1;
+                }
+
+                let x = start * TILE_SIZE;
+                let width = (col * TILE_SIZE).min(self.size.width) - x;
+
+                // Extend the same span from the previous row.
+                let prev = regions.iter_mut().find(|r| {
+                    r.x == x && r.width == width && r.y + r.height == y
+                });
+
+                match prev {
+                    Some(r) => r.height += height,
+                    None => regions.push(ScreenRect::new(x, y, width, height)),
+                }
+            }
+        }
+
+        regions
+    }
+}
+
 /// Stack of image layers.
 ///
 /// Instead of creating a new layer each time we need one,
 /// we are reusing an existing one.
+///
+/// A layer covers only its area of the canvas, so the memory usage
+/// follows the content size instead of the canvas size.
+/// A layer image can be larger than the area, when a free layer
+/// of a larger size is reused.
 pub struct Layers<T> {
     d: Vec<LayerData<T>>,
+    tiles: Vec<Rc<RefCell<Tiles>>>,
+    /// Layer image sizes.
+    sizes: Vec<ScreenSize>,
     /// Use Rc as a shared counter.
     counter: Rc<()>,
     img_size: ScreenSize,
     dpi: f64,
+    /// Size of the allocated layer images, in bytes.
+    data_size: u64,
+    /// Peak of `data_size`.
+    peak_data_size: u64,
+    bounds: utils::ContentBounds,
     new_img_fn: Box<Fn(ScreenSize, f64) -> Option<T>>,
-    clear_img_fn: Box<Fn(&mut T)>,
+    clear_img_fn: Box<Fn(&mut T, &[ScreenRect])>,
 }
 
 impl<T> Layers<T> {
@@ -34,53 +177,149 @@ impl<T> Layers<T> {
         clear_img_fn: F2,
     ) -> Self
         where F1: Fn(ScreenSize, f64) -> Option<T> + 'static,
-              F2: Fn(&mut T) + 'static,
+              F2: Fn(&mut T, &[ScreenRect]) + 'static,
     {
         Layers {
             d: Vec::new(),
+            tiles: Vec::new(),
+            sizes: Vec::new(),
             counter: Rc::new(()),
             img_size,
             dpi,
+            data_size: 0,
+            peak_data_size: 0,
+            bounds: utils::ContentBounds::new(),
             new_img_fn: Box::new(new_img_fn),
             clear_img_fn: Box::new(clear_img_fn),
         }
     }
 
-    /// Returns a layer size.
+    /// Returns a canvas size.
     pub fn image_size(&self) -> ScreenSize {
         self.img_size
     }
 
+    /// Returns the whole canvas area.
+    pub fn image_area(&self) -> ScreenRect {
+        ScreenRect::new(0, 0, self.img_size.width, self.img_size.height)
+    }
+
+    /// Returns conservative canvas space bounds of the `parent` children.
+    ///
+    /// See `utils::ContentBounds` for details.
+    pub fn content_bounds(&mut self, parent: &usvg::Node, ts: &usvg::Transform) -> Option<Rect> {
+        self.bounds.get(parent, ts)
+    }
+
+    /// Marks the `layer` tiles covered by the `parent` children.
+    ///
+    /// Unlike touching the `content_bounds`, tiles between the children are not marked.
+    /// `ts` is the `parent` canvas space transform.
+    pub fn touch_children(&mut self, layer: &Layer<T>, parent: &usvg::Node, ts: &usvg::Transform) {
+        for node in parent.children() {
+            layer.touch(self.bounds.child(&node, ts));
+        }
+    }
+
     /// Returns a first free layer to draw on.
     ///
+    /// The layer covers the `area`, which is in the canvas pixels.
+    /// Its image has at least the size of the area.
+    ///
+    /// - If there is a free layer that is large enough - it will clear its touched tiles before return.
     /// - If there are no free layers - will create a new one.
-    /// - If there is a free layer - it will clear it before return.
-    pub fn get(&mut self) -> Option<Layer<T>> {
-        let used_layers = Rc::strong_count(&self.counter) - 1;
-        if used_layers == self.d.len() {
-            match (self.new_img_fn)(self.img_size, self.dpi) {
-                Some(img) => {
-                    self.d.push(Rc::new(RefCell::new(img)));
-                    Some(Layer {
-                        d: self.d[self.d.len() - 1].clone(),
-                        _counter_holder: self.counter.clone(),
-                    })
-                }
-                None => {
-                    None
-                }
+    /// - Otherwise will replace the first free layer image with one that fits
+    ///   both the old and the new size.
+    pub fn get(&mut self, area: ScreenRect) -> Option<Layer<T>> {
+        let size = area.size();
+        let idx = Rc::strong_count(&self.counter) - 1;
+
+        // All layers starting from `idx` are free.
+        let fits = (idx..self.d.len()).find(|&i| {
+            let s = self.sizes[i];
+            s.width >= size.width && s.height >= size.height
+        });
+
+        if let Some(i) = fits {
+            self.d.swap(idx, i);
+            self.tiles.swap(idx, i);
+            self.sizes.swap(idx, i);
+
+            let regions = self.dirty_regions(idx);
+            if !regions.is_empty() {
+                (self.clear_img_fn)(&mut self.d[idx].borrow_mut(), &regions);
             }
+
+            self.tiles[idx].borrow_mut().reset(size);
+        } else if idx == self.d.len() {
+            let img = self.new_image(size, None)?;
+            stats::update(|s| s.layers += 1);
+
+            self.d.push(Rc::new(RefCell::new(img)));
+            self.tiles.push(Rc::new(RefCell::new(Tiles::new(size))));
+            self.sizes.push(size);
         } else {
-            {
-                let img = self.d[used_layers].clone();
-                (self.clear_img_fn)(&mut img.borrow_mut());
-            }
+            // Sibling groups can have different sizes,
+            // so the image grows instead of switching between them.
+            let old_size = self.sizes[idx];
+            let new_size = ScreenSize::new(old_size.width.max(size.width),
+                                           old_size.height.max(size.height));
+            let img = self.new_image(new_size, Some(old_size))?;
+            *self.d[idx].borrow_mut() = img;
+            self.sizes[idx] = new_size;
+
+            self.tiles[idx].borrow_mut().reset(size);
+        }
+
+        Some(Layer {
+            d: self.d[idx].clone(),
+            tiles: self.tiles[idx].clone(),
+            area,
+            _counter_holder: self.counter.clone(),
+        })
+    }
+
+    /// Returns image regions that were drawn on.
+    ///
+    /// Includes the image part outside of the layer that was reached
+    /// by the touched rects.
+    fn dirty_regions(&self, idx: usize) -> Vec<ScreenRect> {
+        let tiles = self.tiles[idx].borrow();
+        let area = tiles.size;
+        let size = self.sizes[idx];
+
+        let w = f64_bound(area.width as f64, tiles.extent.0.ceil(), size.width as f64) as u32;
+        let h = f64_bound(area.height as f64, tiles.extent.1.ceil(), size.height as f64) as u32;
+
+        let mut regions = tiles.regions();
+        if w > area.width {
+            regions.push(ScreenRect::new(area.width, 0, w - area.width, h));
+        }
+
+        if h > area.height {
+            regions.push(ScreenRect::new(0, area.height, area.width, h - area.height));
+        }
+
+        regions
+    }
+
+    fn new_image(&mut self, size: ScreenSize, old_size: Option<ScreenSize>) -> Option<T> {
+        let _site = stats::enter_site(stats::Site::Layers);
+        let img = (self.new_img_fn)(size, self.dpi)?;
+
+        if let Some(old_size) = old_size {
+            self.data_size -= stats::surface_size(old_size.width, old_size.height);
+        }
+        self.data_size += stats::surface_size(size.width, size.height);
 
-            Some(Layer {
-                d: self.d[used_layers].clone(),
-                _counter_holder: self.counter.clone(),
-            })
+        // Replaced images are freed, so only the peak usage is counted.
+        if self.data_size > self.peak_data_size {
+            let grow = self.data_size - self.peak_data_size;
+            stats::update(|s| s.surfaces_size += grow);
+            self.peak_data_size = self.data_size;
         }
+
+        Some(img)
     }
 }
 
@@ -93,10 +332,50 @@ impl<T> Drop for Layers<T> {
 /// The layer object.
 pub struct Layer<T> {
     d: LayerData<T>,
+    tiles: Rc<RefCell<Tiles>>,
+    area: ScreenRect,
     // When Layer goes out of scope, Layers::counter will be automatically decreased.
     _counter_holder: Rc<()>,
 }
 
+impl<T> Layer<T> {
+    /// Returns the canvas area covered by the layer.
+    pub fn area(&self) -> ScreenRect {
+        self.area
+    }
+
+    /// Marks tiles that intersect the canvas space rect as drawn on.
+    ///
+    /// `None` marks the whole layer.
+    pub fn touch(&self, r: Option<Rect>) {
+        let r = r.map(|r| {
+            Rect::new(r.x - self.area.x as f64, r.y - self.area.y as f64, r.width, r.height)
+        });
+
+        self.tiles.borrow_mut().touch(r);
+    }
+
+    /// Marks the same tiles as the `other` layer.
+    ///
+    /// Both layers must cover the same area.
+    pub fn touch_from(&self, other: &Layer<T>) {
+        debug_assert!(self.area == other.area);
+
+        let other = other.tiles.borrow();
+        let mut tiles = self.tiles.borrow_mut();
+        for (t, o) in tiles.touched.iter_mut().zip(other.touched.iter()) {
+            *t |= *o;
+        }
+    }
+
+    /// Returns touched areas in the layer pixels.
+    ///
+    /// Neighbouring tiles are merged into rects.
+    pub fn regions(&self) -> Vec<ScreenRect> {
+        self.tiles.borrow().regions()
+    }
+}
+
 impl<T> Deref for Layer<T> {
     type Target = LayerData<T>;
 
@@ -104,3 +383,332 @@ impl<T> Deref for Layer<T> {
         &self.d
     }
 }
+
+
+/// Returns the canvas area of a layer that is drawn on the `target` area.
+///
+/// The area covers the `bounds` inside the `target` or the whole `target`
+/// when the bounds are unknown. The result is never empty.
+pub fn layer_area(bounds: Option<Rect>, target: ScreenRect) -> ScreenRect {
+    let r = match bounds {
+        Some(r) => r,
+        None => return target,
+    };
+
+    let x1 = f64_bound(target.x as f64, r.x.floor(), (target.x + target.width) as f64);
+    let y1 = f64_bound(target.y as f64, r.y.floor(), (target.y + target.height) as f64);
+    let x2 = f64_bound(target.x as f64, (r.x + r.width).ceil(), (target.x + target.width) as f64);
+    let y2 = f64_bound(target.y as f64, (r.y + r.height).ceil(), (target.y + target.height) as f64);
+
+    if x2 <= x1 || y2 <= y1 {
+        // Nothing is visible, but the group still has to be rendered
+        // to calculate its bbox.
+        return ScreenRect::new(target.x, target.y, 1, 1);
+    }
+
+    ScreenRect::new(x1 as u32, y1 as u32, (x2 - x1) as u32, (y2 - y1) as u32)
+}
+
+/// Converts a canvas space transform into the `area` pixels space.
+pub fn area_transform(ts: &usvg::Transform, area: ScreenRect) -> usvg::Transform {
+    usvg::Transform::new(ts.a, ts.b, ts.c, ts.d, ts.e - area.x as f64, ts.f - area.y as f64)
+}
+
+/// Converts an `area` pixels space transform into the canvas space.
+pub fn canvas_transform(ts: &usvg::Transform, area: ScreenRect) -> usvg::Transform {
+    usvg::Transform::new(ts.a, ts.b, ts.c, ts.d, ts.e + area.x as f64, ts.f + area.y as f64)
+}
+
+/// Returns the `area` position inside the `target` area, in pixels.
+pub fn area_offset(area: ScreenRect, target: ScreenRect) -> (f64, f64) {
+    (area.x as f64 - target.x as f64, area.y as f64 - target.y as f64)
+}
+
+
+/// Fills regions of a BGRA image with a single pixel value.
+pub fn fill_regions(data: &mut [u8], img_size: ScreenSize, regions: &[ScreenRect], pixel: [u8; 4]) {
+    let stride = img_size.width as usize * 4;
+    for r in regions {
+        for y in r.y..r.y + r.height {
+            let start = y as usize * stride + r.x as usize * 4;
+            let end = start + r.width as usize * 4;
+            for p in data[start..end].chunks_mut(4) {
+                p.copy_from_slice(&pixel);
+            }
+        }
+    }
+}
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use usvg::prelude::*;
+
+    fn touched(tiles: &Tiles) -> Vec<u32> {
+        (0..tiles.touched.len() as u32).filter(|i| tiles.touched[*i as usize]).collect()
+    }
+
+    fn regions_tuple(regions: &[ScreenRect]) -> Vec<(u32, u32, u32, u32)> {
+        regions.iter().map(|r| (r.x, r.y, r.width, r.height)).collect()
+    }
+
+    /// Creates layers with images that record their size and the cleared regions.
+    fn layers(size: ScreenSize) -> Layers<(ScreenSize, Vec<ScreenRect>)> {
+        Layers::new(
+            size, 96.0,
+            |size, _| Some((size, Vec::new())),
+            |img: &mut (ScreenSize, Vec<ScreenRect>), regions| img.1.extend_from_slice(regions),
+        )
+    }
+
+    #[test]
+    fn touch_grid() {
+        // 3x2 tiles, the last column and row are partial.
+        let mut tiles = Tiles::new(ScreenSize::new(150, 100));
+        assert_eq!((tiles.cols, tiles.rows), (3, 2));
+
+        tiles.touch(Some(Rect::new(10.0, 10.0, 20.0, 20.0)));
+        assert_eq!(touched(&tiles), vec![0]);
+
+        // Edges are rounded outwards.
+        tiles.touch(Some(Rect::new(63.5, 10.0, 1.0, 1.0)));
+        assert_eq!(touched(&tiles), vec![0, 1]);
+
+        tiles.touch(Some(Rect::new(100.0, 70.0, 10.0, 10.0)));
+        assert_eq!(touched(&tiles), vec![0, 1, 4]);
+    }
+
+    #[test]
+    fn touch_tile_boundary() {
+        let mut tiles = Tiles::new(ScreenSize::new(150, 100));
+
+        // Ends exactly at the tile boundary.
+        tiles.touch(Some(Rect::new(0.0, 0.0, 64.0, 64.0)));
+        assert_eq!(touched(&tiles), vec![0]);
+
+        // Starts exactly at the tile boundary.
+        tiles.touch(Some(Rect::new(128.0, 64.0, 1.0, 1.0)));
+        assert_eq!(touched(&tiles), vec![0, 5]);
+    }
+
+    #[test]
+    fn touch_outside() {
+        let mut tiles = Tiles::new(ScreenSize::new(150, 100));
+
+        tiles.touch(Some(Rect::new(-50.0, -50.0, 40.0, 40.0)));
+        tiles.touch(Some(Rect::new(150.0, 0.0, 10.0, 10.0)));
+        tiles.touch(Some(Rect::new(10.0, 10.0, 0.0, 10.0)));
+        assert!(touched(&tiles).is_empty());
+
+        // Clipped by the layer.
+        tiles.touch(Some(Rect::new(-50.0, 90.0, 300.0, 100.0)));
+        assert_eq!(touched(&tiles), vec![3, 4, 5]);
+    }
+
+    #[test]
+    fn touch_all() {
+        let mut tiles = Tiles::new(ScreenSize::new(150, 100));
+        tiles.touch(None);
+        assert_eq!(touched(&tiles), vec![0, 1, 2, 3, 4, 5]);
+        assert_eq!(regions_tuple(&tiles.regions()), vec![(0, 0, 150, 100)]);
+
+        tiles.reset(ScreenSize::new(10, 10));
+        assert_eq!(touched(&tiles), Vec::<u32>::new());
+        assert_eq!(tiles.touched.len(), 1);
+    }
+
+    #[test]
+    fn regions_merge_spans() {
+        let mut tiles = Tiles::new(ScreenSize::new(150, 150));
+
+        // A 2x2 block.
+        tiles.touch(Some(Rect::new(10.0, 10.0, 100.0, 100.0)));
+        assert_eq!(regions_tuple(&tiles.regions()), vec![(0, 0, 128, 128)]);
+    }
+
+    #[test]
+    fn regions_separate_spans() {
+        let mut tiles = Tiles::new(ScreenSize::new(150, 150));
+
+        tiles.touch(Some(Rect::new(10.0, 10.0, 10.0, 10.0)));
+        tiles.touch(Some(Rect::new(140.0, 10.0, 5.0, 70.0)));
+        tiles.touch(Some(Rect::new(10.0, 140.0, 100.0, 5.0)));
+
+        // Spans of different widths are not merged.
+        assert_eq!(regions_tuple(&tiles.regions()), vec![
+            (0, 0, 64, 64),
+            (128, 0, 22, 128),
+            (0, 128, 128, 22),
+        ]);
+    }
+
+    #[test]
+    fn layer_touch_in_canvas_space() {
+        let mut layers = layers(ScreenSize::new(500, 500));
+        let layer = layers.get(ScreenRect::new(100, 200, 150, 100)).unwrap();
+        assert_eq!(layer.borrow().0, ScreenSize::new(150, 100));
+
+        layer.touch(Some(Rect::new(200.0, 280.0, 10.0, 10.0)));
+        assert_eq!(regions_tuple(&layer.regions()), vec![(64, 64, 64, 36)]);
+    }
+
+    #[test]
+    fn get_reuses_same_size() {
+        let mut layers = layers(ScreenSize::new(500, 500));
+        let area = ScreenRect::new(0, 0, 200, 200);
+
+        {
+            let layer = layers.get(area).unwrap();
+            layer.touch(Some(Rect::new(10.0, 10.0, 10.0, 10.0)));
+        }
+
+        // Only the touched tiles are cleared.
+        let layer = layers.get(ScreenRect::new(50, 50, 200, 200)).unwrap();
+        assert_eq!(regions_tuple(&layer.borrow().1), vec![(0, 0, 64, 64)]);
+        assert!(layer.regions().is_empty());
+        drop(layer);
+
+        assert_eq!(layers.d.len(), 1);
+    }
+
+    #[test]
+    fn get_reuses_larger_free_layer() {
+        let mut layers = layers(ScreenSize::new(500, 500));
+
+        {
+            let l1 = layers.get(ScreenRect::new(0, 0, 100, 100)).unwrap();
+            let l2 = layers.get(ScreenRect::new(0, 0, 200, 200)).unwrap();
+            l1.touch(None);
+            l2.touch(Some(Rect::new(10.0, 10.0, 10.0, 10.0)));
+        }
+
+        // The second layer is large enough, so it's moved to the top.
+        let layer = layers.get(ScreenRect::new(0, 0, 150, 150)).unwrap();
+        assert_eq!(layer.borrow().0, ScreenSize::new(200, 200));
+        assert_eq!(regions_tuple(&layer.borrow().1), vec![(0, 0, 64, 64)]);
+        assert!(layer.regions().is_empty());
+        drop(layer);
+
+        assert_eq!(layers.d.len(), 2);
+        assert_eq!(layers.d[1].borrow().0, ScreenSize::new(100, 100));
+        assert_eq!(layers.peak_data_size, (200 * 200 + 100 * 100) * 4);
+    }
+
+    #[test]
+    fn get_grows_smaller_layer() {
+        let mut layers = layers(ScreenSize::new(500, 500));
+
+        {
+            let layer = layers.get(ScreenRect::new(0, 0, 200, 100)).unwrap();
+            layer.touch(None);
+        }
+
+        let layer = layers.get(ScreenRect::new(0, 0, 100, 200)).unwrap();
+        assert_eq!(layer.borrow().0, ScreenSize::new(200, 200));
+        assert!(layer.borrow().1.is_empty());
+        layer.touch(None);
+        drop(layer);
+
+        // Both sizes fit now.
+        let layer = layers.get(ScreenRect::new(0, 0, 200, 100)).unwrap();
+        assert_eq!(layer.borrow().0, ScreenSize::new(200, 200));
+        drop(layer);
+
+        assert_eq!(layers.d.len(), 1);
+        assert_eq!(layers.data_size, 200 * 200 * 4);
+        assert_eq!(layers.peak_data_size, 200 * 200 * 4);
+    }
+
+    #[test]
+    fn get_clears_outside_area() {
+        let mut layers = layers(ScreenSize::new(500, 500));
+
+        {
+            let layer = layers.get(ScreenRect::new(0, 0, 200, 200)).unwrap();
+            layer.touch(None);
+        }
+
+        {
+            // The content is clipped by the area, but not by the image.
+            let layer = layers.get(ScreenRect::new(0, 0, 100, 50)).unwrap();
+            layer.touch(Some(Rect::new(90.0, 10.0, 20.0, 60.0)));
+            layer.borrow_mut().1.clear();
+        }
+
+        let layer = layers.get(ScreenRect::new(0, 0, 10, 10)).unwrap();
+        assert_eq!(regions_tuple(&layer.borrow().1), vec![
+            (64, 0, 36, 50),
+            (100, 0, 10, 70),
+            (0, 50, 100, 20),
+        ]);
+    }
+
+    #[test]
+    fn touch_children_separately() {
+        let tree = usvg::Tree::create(usvg::Svg {
+            size: Size::new(200.0, 200.0),
+            view_box: usvg::ViewBox {
+                rect: Rect::new(0.0, 0.0, 200.0, 200.0),
+                aspect: usvg::AspectRatio { defer: false, align: usvg::Align::None, slice: false },
+            },
+        });
+
+        for r in &[Rect::new(5.0, 5.0, 10.0, 10.0), Rect::new(180.0, 180.0, 10.0, 10.0)] {
+            tree.root().append_kind(usvg::NodeKind::Path(usvg::Path {
+                id: String::new(),
+                transform: usvg::Transform::default(),
+                fill: Some(usvg::Fill::default()),
+                stroke: None,
+                segments: utils::rect_to_path(*r),
+            }));
+        }
+
+        let mut layers = layers(ScreenSize::new(200, 200));
+        let layer = layers.get(ScreenRect::new(0, 0, 200, 200)).unwrap();
+        layers.touch_children(&layer, &tree.root(), &usvg::Transform::default());
+
+        // Tiles between the children are not touched.
+        assert_eq!(regions_tuple(&layer.regions()), vec![(0, 0, 64, 64), (128, 128, 64, 64)]);
+    }
+
+    #[test]
+    fn layer_area_inside_target() {
+        let target = ScreenRect::new(100, 100, 200, 200);
+
+        let a = layer_area(Some(Rect::new(150.5, 120.2, 20.0, 30.0)), target);
+        assert_eq!(regions_tuple(&[a]), vec![(150, 120, 21, 31)]);
+
+        // Clipped by the target.
+        let a = layer_area(Some(Rect::new(50.0, 250.0, 100.0, 100.0)), target);
+        assert_eq!(regions_tuple(&[a]), vec![(100, 250, 50, 50)]);
+
+        // Unknown bounds.
+        let a = layer_area(None, target);
+        assert_eq!(regions_tuple(&[a]), vec![(100, 100, 200, 200)]);
+    }
+
+    #[test]
+    fn layer_area_outside_target() {
+        let target = ScreenRect::new(100, 100, 200, 200);
+
+        let a = layer_area(Some(Rect::new(0.0, 0.0, 50.0, 50.0)), target);
+        assert_eq!(regions_tuple(&[a]), vec![(100, 100, 1, 1)]);
+
+        // Nothing is drawn.
+        let a = layer_area(Some(Rect::new(0.0, 0.0, 0.0, 0.0)), target);
+        assert_eq!(regions_tuple(&[a]), vec![(100, 100, 1, 1)]);
+    }
+
+    #[test]
+    fn area_transforms() {
+        let area = ScreenRect::new(30, 40, 10, 10);
+        let ts = usvg::Transform::new(2.0, 0.0, 0.0, 2.0, 5.0, 6.0);
+
+        let area_ts = area_transform(&ts, area);
+        assert_eq!(area_ts.apply(20.0, 20.0), (15.0, 6.0));
+        assert_eq!(canvas_transform(&area_ts, area), ts);
+
+        assert_eq!(area_offset(area, ScreenRect::new(10, 10, 100, 100)), (20.0, 30.0));
+    }
+}
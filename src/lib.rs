@@ -44,10 +44,15 @@ use usvg::{
 #[cfg(feature = "cairo-backend")] pub mod backend_cairo;
 #[cfg(feature = "qt-backend")] pub mod backend_qt;
 
+#[cfg(feature = "alloc-stats")] pub mod alloc_stats;
+pub mod capture;
+pub mod passes;
+pub mod stats;
 pub mod utils;
-mod backend_utils;
+// Public only for benchmarks.
+#[doc(hidden)] pub mod backend_utils;
+#[doc(hidden)] pub mod layers;
 mod geom;
-mod layers;
 mod options;
 mod traits;
 
@@ -91,6 +96,32 @@ pub trait Render {
         opt: &Options,
     ) -> Option<Box<OutputImage>>;
 
+    /// Renders only the part of the SVG that contains the content.
+    ///
+    /// The image has the same scale as the one returned by `render_to_image`,
+    /// but is cropped to the content bbox. Also returns the image region
+    /// inside the full image. See `utils::trim_region` for details.
+    ///
+    /// Returns `None` if the image has no content or an image allocation failed.
+    fn render_trimmed_to_image(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+    ) -> Option<(Box<OutputImage>, ScreenRect)>;
+
+    /// Renders only the `region` of the image.
+    ///
+    /// The region is in the pixels of the image returned by `render_to_image`.
+    /// Rendering all regions of a grid produces the same pixels as the full rendering.
+    ///
+    /// Returns `None` if an image allocation failed.
+    fn render_region_to_image(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+        region: ScreenRect,
+    ) -> Option<Box<OutputImage>>;
+
     /// Renders SVG node to image.
     ///
     /// Returns `None` if an image allocation failed.
@@ -108,6 +139,17 @@ pub trait Render {
         node: &usvg::Node,
         opt: &Options,
     ) -> Option<Rect>;
+
+    /// Returns the region of the image that contains all rendered pixels.
+    ///
+    /// This is the region used by `render_trimmed_to_image`.
+    ///
+    /// Returns `None` if the image has no content.
+    fn trim_region(
+        &self,
+        tree: &usvg::Tree,
+        opt: &Options,
+    ) -> Option<ScreenRect>;
 }
 
 /// A generic interface for output image.
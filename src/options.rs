@@ -35,6 +35,43 @@ pub struct Options {
     ///
     /// `None` equals to transparent.
     pub background: Option<Color>,
+
+    /// Skips elements that are fully covered by later opaque rectangles.
+    ///
+    /// The result is identical to the full rendering, but for documents without
+    /// overlapping opaque rectangles this is just an overhead.
+    ///
+    /// Default: `false`.
+    pub occlusion_culling: bool,
+
+    /// Reuses clip path and mask layers between renders.
+    ///
+    /// Useful when the same tree is rendered repeatedly using the same transform.
+    /// Cached layers are invalidated automatically when the tree is modified.
+    /// The cache is per thread and can be freed using `clear_coverage_cache`
+    /// of the selected backend.
+    ///
+    /// Cached layers hold references to their `clipPath` and `mask` elements,
+    /// which keeps those subtrees alive after the tree was dropped,
+    /// until they are evicted or the cache is freed.
+    ///
+    /// Default: `false`.
+    pub coverage_cache: bool,
+
+    /// Number of threads used to decode raster images before rendering.
+    ///
+    /// Images are decoded concurrently, but still drawn in the document order,
+    /// so the result is identical to the sequential rendering.
+    /// Only images of the rendered tree that intersect the canvas are decoded.
+    ///
+    /// Threads are spawned on each render and all decoded images are kept
+    /// in memory until the rendering is finished, so the peak memory usage
+    /// increases by `width * height * 4` bytes per image.
+    ///
+    /// Supported only by the cairo backend.
+    ///
+    /// Default: 1, which means no extra threads.
+    pub decoding_threads: u32,
 }
 
 impl Default for Options {
@@ -43,6 +80,9 @@ impl Default for Options {
             usvg: usvg::Options::default(),
             fit_to: FitTo::Original,
             background: None,
+            occlusion_culling: false,
+            coverage_cache: false,
+            decoding_threads: 1,
         }
     }
 }
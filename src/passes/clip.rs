@@ -0,0 +1,693 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::f64;
+
+// external
+use usvg;
+use usvg::prelude::*;
+
+// self
+use super::invert;
+
+
+type Polygon = Vec<(f64, f64)>;
+
+/// Replaces simple clip paths with the clipped geometry.
+///
+/// A group clip path is baked when:
+///
+/// - the clip path has `userSpaceOnUse` units and a single convex polygon child,
+///   like a rectangle;
+/// - the group has no mask;
+/// - no ancestor group has a clip path or a mask in `objectBoundingBox` units;
+/// - all group children are paths without curves and strokes
+///   and with a solid color fill.
+///
+/// Each child is intersected with the clip polygon and the group clip path is removed,
+/// so the rendering doesn't need a clip layer anymore. Other clip paths are kept as is.
+///
+/// Returns the number of baked clip paths.
+pub fn bake_clip_paths(tree: &usvg::Tree) -> u32 {
+    let groups: Vec<_> = tree.root().descendants().filter(|n| {
+        if let usvg::NodeKind::Group(ref g) = *n.borrow() {
+            g.clip_path.is_some() && g.mask.is_none()
+        } else {
+            false
+        }
+    }).collect();
+
+    let mut count = 0;
+    for mut node in groups {
+        if bake_group(tree, &mut node) {
+            count += 1;
+        }
+    }
+
+    count
+}
+
+fn bake_group(tree: &usvg::Tree, node: &mut usvg::Node) -> bool {
+    let clip_id = match *node.borrow() {
+        usvg::NodeKind::Group(ref g) => g.clip_path.clone(),
+        _ => None,
+    };
+
+    let clip_node = match clip_id.and_then(|id| tree.defs_by_id(&id)) {
+        Some(v) => v,
+        None => return false,
+    };
+
+    let clip = match clip_polygon(&clip_node) {
+        Some(v) => v,
+        None => return false,
+    };
+
+    if has_bbox_dependent_ancestor(tree, node) {
+        return false;
+    }
+
+    // Clip all children first, so the group is either fully baked or unchanged.
+    let mut baked = Vec::new();
+    for child in node.children() {
+        let segments = match *child.borrow() {
+            usvg::NodeKind::Path(ref path) => {
+                if !is_simple_fill(path) {
+                    return false;
+                }
+
+                // Map the clip polygon into the path coordinates.
+                let ts = match invert(&child.transform()) {
+                    Some(v) => v,
+                    None => return false,
+                };
+                let clip: Polygon = clip.iter().map(|&(x, y)| ts.apply(x, y)).collect();
+
+                clip_segments(&path.segments, &clip)
+            }
+            _ => return false,
+        };
+
+        baked.push((child, segments));
+    }
+
+    for (mut child, segments) in baked {
+        if segments.is_empty() {
+            child.detach();
+        } else if let usvg::NodeKind::Path(ref mut path) = *child.borrow_mut() {
+            path.segments = segments;
+        }
+    }
+
+    if let usvg::NodeKind::Group(ref mut g) = *node.borrow_mut() {
+        g.clip_path = None;
+    }
+
+    true
+}
+
+/// Checks that an ancestor group clip path or mask depends on its bbox.
+///
+/// Baking shrinks or removes the group children, which changes the bbox
+/// of all ancestor groups.
+fn has_bbox_dependent_ancestor(tree: &usvg::Tree, node: &usvg::Node) -> bool {
+    let is_bbox_dependent = |id: &Option<String>| {
+        let node = match id.as_ref().and_then(|id| tree.defs_by_id(id)) {
+            Some(v) => v,
+            None => return false,
+        };
+
+        let kind = node.borrow();
+        match *kind {
+            usvg::NodeKind::ClipPath(ref cp) => cp.units == usvg::Units::ObjectBoundingBox,
+            usvg::NodeKind::Mask(ref mask) => {
+                mask.units == usvg::Units::ObjectBoundingBox ||
+                mask.content_units == usvg::Units::ObjectBoundingBox
+            }
+            _ => false,
+        }
+    };
+
+    node.ancestors().skip(1).any(|n| {
+        match *n.borrow() {
+            usvg::NodeKind::Group(ref g) => is_bbox_dependent(&g.clip_path) || is_bbox_dependent(&g.mask),
+            _ => false,
+        }
+    })
+}
+
+/// Returns a convex clip polygon in the user space of the clipped element.
+fn clip_polygon(node: &usvg::Node) -> Option<Polygon> {
+    let cp_ts = match *node.borrow() {
+        usvg::NodeKind::ClipPath(ref cp) => {
+            // e-clipPath-005.svg
+            if cp.units != usvg::Units::UserSpaceOnUse {
+                return None;
+            }
+
+            cp.transform
+        }
+        _ => return None,
+    };
+
+    let mut children = node.children();
+    let child = children.next()?;
+    if children.next().is_some() {
+        return None;
+    }
+
+    let kind = child.borrow();
+    let path = match *kind {
+        usvg::NodeKind::Path(ref path) => path,
+        _ => return None,
+    };
+
+    // A clip path child without a fill hides everything.
+    if path.fill.is_none() {
+        return None;
+    }
+
+    let mut subpaths = subpaths(&path.segments)?;
+    if subpaths.len() != 1 {
+        return None;
+    }
+    let polygon = subpaths.pop().unwrap();
+
+    if !is_convex(&polygon) {
+        return None;
+    }
+
+    let mut ts = cp_ts;
+    ts.append(&child.transform());
+    Some(polygon.iter().map(|&(x, y)| ts.apply(x, y)).collect())
+}
+
+fn is_simple_fill(path: &usvg::Path) -> bool {
+    if path.stroke.is_some() {
+        return false;
+    }
+
+    // Paint servers can depend on the path bbox, which will change.
+    match path.fill {
+        Some(ref fill) => {
+            match fill.paint {
+                usvg::Paint::Color(_) => {}
+                _ => return false,
+            }
+        }
+        None => return false,
+    }
+
+    path.segments.iter().all(|seg| {
+        match *seg {
+            usvg::PathSegment::CurveTo { .. } => false,
+            _ => true,
+        }
+    })
+}
+
+/// Splits segments into polygons.
+///
+/// Returns `None` if there are curves.
+fn subpaths(segments: &[usvg::PathSegment]) -> Option<Vec<Polygon>> {
+    let mut list = Vec::new();
+    let mut polygon = Vec::new();
+    for seg in segments {
+        match *seg {
+            usvg::PathSegment::MoveTo { x, y } => {
+                if polygon.len() > 2 {
+                    list.push(polygon);
+                }
+
+                polygon = vec![(x, y)];
+            }
+            usvg::PathSegment::LineTo { x, y } => {
+                polygon.push((x, y));
+            }
+            usvg::PathSegment::ClosePath => {
+                // Filling closes subpaths implicitly.
+                if polygon.len() > 2 {
+                    list.push(polygon.clone());
+                }
+
+                // The next segment starts from the same point.
+                polygon.truncate(1);
+            }
+            usvg::PathSegment::CurveTo { .. } => return None,
+        }
+    }
+
+    if polygon.len() > 2 {
+        list.push(polygon);
+    }
+
+    Some(list)
+}
+
+fn is_convex(polygon: &[(f64, f64)]) -> bool {
+    // Zero-length edges have no direction.
+    let mut polygon = polygon.to_vec();
+    polygon.dedup();
+    if polygon.len() > 1 && polygon.first() == polygon.last() {
+        polygon.pop();
+    }
+
+    let len = polygon.len();
+    if len < 3 {
+        return false;
+    }
+
+    let mut sign = 0.0;
+    let mut turn = 0.0;
+    for i in 0..len {
+        let (x1, y1) = polygon[i];
+        let (x2, y2) = polygon[(i + 1) % len];
+        let (x3, y3) = polygon[(i + 2) % len];
+        let cross = (x2 - x1) * (y3 - y2) - (y2 - y1) * (x3 - x2);
+        let dot = (x2 - x1) * (x3 - x2) + (y2 - y1) * (y3 - y2);
+
+        if cross.is_fuzzy_zero() {
+            // Reversed direction.
+            if dot < 0.0 {
+                return false;
+            }
+
+            continue;
+        }
+
+        if sign == 0.0 {
+            sign = cross.signum();
+        } else if cross.signum() != sign {
+            return false;
+        }
+
+        turn += cross.atan2(dot);
+    }
+
+    // All points are on the same line.
+    if sign == 0.0 {
+        return false;
+    }
+
+    // A self-intersecting polygon, like a star, makes more than one turn.
+    (turn.abs() - 2.0 * f64::consts::PI).abs() < 1e-6
+}
+
+/// Clips each subpath by the convex polygon using the Sutherland–Hodgman algorithm.
+///
+/// Winding numbers inside the clip polygon are preserved,
+/// so the result works with both fill rules.
+fn clip_segments(segments: &[usvg::PathSegment], clip: &[(f64, f64)]) -> Vec<usvg::PathSegment> {
+    // Checked by `is_simple_fill`.
+    let subpaths = subpaths(segments).unwrap_or_default();
+
+    // The inside of the clip polygon is on the left side of its edges
+    // for a positive orientation.
+    let orientation = signed_area(clip).signum();
+
+    let mut new_segments = Vec::new();
+    for mut polygon in subpaths {
+        let len = clip.len();
+        for i in 0..len {
+            let a = clip[i];
+            let b = clip[(i + 1) % len];
+            polygon = clip_by_edge(&polygon, a, b, orientation);
+            if polygon.is_empty() {
+                break;
+            }
+        }
+
+        if polygon.len() < 3 {
+            continue;
+        }
+
+        new_segments.push(usvg::PathSegment::MoveTo { x: polygon[0].0, y: polygon[0].1 });
+        for &(x, y) in &polygon[1..] {
+            new_segments.push(usvg::PathSegment::LineTo { x, y });
+        }
+        new_segments.push(usvg::PathSegment::ClosePath);
+    }
+
+    new_segments
+}
+
+fn clip_by_edge(
+    polygon: &[(f64, f64)],
+    a: (f64, f64),
+    b: (f64, f64),
+    orientation: f64,
+) -> Polygon {
+    let side = |p: (f64, f64)| {
+        ((b.0 - a.0) * (p.1 - a.1) - (b.1 - a.1) * (p.0 - a.0)) * orientation
+    };
+
+    let intersect = |p: (f64, f64), q: (f64, f64), sp: f64, sq: f64| {
+        let t = sp / (sp - sq);
+        (p.0 + (q.0 - p.0) * t, p.1 + (q.1 - p.1) * t)
+    };
+
+    let mut out = Vec::with_capacity(polygon.len() + 2);
+    let len = polygon.len();
+    for i in 0..len {
+        let p = polygon[i];
+        let q = polygon[(i + 1) % len];
+        let sp = side(p);
+        let sq = side(q);
+
+        if sp >= 0.0 {
+            out.push(p);
+            if sq < 0.0 {
+                out.push(intersect(p, q, sp, sq));
+            }
+        } else if sq >= 0.0 {
+            out.push(intersect(p, q, sp, sq));
+        }
+    }
+
+    out
+}
+
+fn signed_area(polygon: &[(f64, f64)]) -> f64 {
+    let len = polygon.len();
+    let mut area = 0.0;
+    for i in 0..len {
+        let (x1, y1) = polygon[i];
+        let (x2, y2) = polygon[(i + 1) % len];
+        area += x1 * y2 - x2 * y1;
+    }
+
+    area / 2.0
+}
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use super::super::invert;
+    use geom::*;
+    use utils;
+
+    fn path(points: &[(f64, f64)]) -> Vec<usvg::PathSegment> {
+        let mut segments = Vec::new();
+        add_subpath(&mut segments, points);
+        segments
+    }
+
+    fn add_subpath(segments: &mut Vec<usvg::PathSegment>, points: &[(f64, f64)]) {
+        segments.push(usvg::PathSegment::MoveTo { x: points[0].0, y: points[0].1 });
+        for &(x, y) in &points[1..] {
+            segments.push(usvg::PathSegment::LineTo { x, y });
+        }
+        segments.push(usvg::PathSegment::ClosePath);
+    }
+
+    fn rect(x: f64, y: f64, w: f64, h: f64) -> Polygon {
+        vec![(x, y), (x + w, y), (x + w, y + h), (x, y + h)]
+    }
+
+    fn reversed(mut polygon: Polygon) -> Polygon {
+        polygon.reverse();
+        polygon
+    }
+
+    /// Returns a winding number of all subpaths around the point.
+    fn winding(segments: &[usvg::PathSegment], p: (f64, f64)) -> i32 {
+        let mut n = 0;
+        for polygon in subpaths(segments).unwrap() {
+            let len = polygon.len();
+            for i in 0..len {
+                let a = polygon[i];
+                let b = polygon[(i + 1) % len];
+                let side = (b.0 - a.0) * (p.1 - a.1) - (b.1 - a.1) * (p.0 - a.0);
+                if a.1 <= p.1 && b.1 > p.1 && side > 0.0 {
+                    n += 1;
+                } else if a.1 > p.1 && b.1 <= p.1 && side < 0.0 {
+                    n -= 1;
+                }
+            }
+        }
+
+        n
+    }
+
+    fn bounds(polygon: &[(f64, f64)]) -> (f64, f64, f64, f64) {
+        let mut r = (f64::MAX, f64::MAX, f64::MIN, f64::MIN);
+        for &(x, y) in polygon {
+            r = (r.0.min(x), r.1.min(y), r.2.max(x), r.3.max(y));
+        }
+
+        r
+    }
+
+    fn group_kind(clip_path: Option<&str>, mask: Option<&str>) -> usvg::NodeKind {
+        usvg::NodeKind::Group(usvg::Group {
+            id: String::new(),
+            transform: usvg::Transform::default(),
+            opacity: None,
+            clip_path: clip_path.map(|v| v.to_string()),
+            mask: mask.map(|v| v.to_string()),
+        })
+    }
+
+    fn rect_kind(r: Rect) -> usvg::NodeKind {
+        usvg::NodeKind::Path(usvg::Path {
+            id: String::new(),
+            transform: usvg::Transform::default(),
+            fill: Some(usvg::Fill::default()),
+            stroke: None,
+            segments: utils::rect_to_path(r),
+        })
+    }
+
+    /// Creates a tree with a clipped group inside a masked group.
+    ///
+    /// The `clip1` clip path keeps only a part of the rect.
+    fn masked_tree(mask_units: usvg::Units) -> usvg::Tree {
+        let mut tree = usvg::Tree::create(usvg::Svg {
+            size: Size::new(100.0, 100.0),
+            view_box: usvg::ViewBox {
+                rect: Rect::new(0.0, 0.0, 100.0, 100.0),
+                aspect: usvg::AspectRatio { defer: false, align: usvg::Align::None, slice: false },
+            },
+        });
+
+        let mut clip = tree.append_to_defs(usvg::NodeKind::ClipPath(usvg::ClipPath {
+            id: "clip1".to_string(),
+            units: usvg::Units::UserSpaceOnUse,
+            transform: usvg::Transform::default(),
+        }));
+        clip.append_kind(rect_kind(Rect::new(0.0, 0.0, 20.0, 20.0)));
+
+        let mut mask = tree.append_to_defs(usvg::NodeKind::Mask(usvg::Mask {
+            id: "mask1".to_string(),
+            units: mask_units,
+            content_units: usvg::Units::UserSpaceOnUse,
+            rect: Rect::new(-0.1, -0.1, 1.2, 1.2),
+        }));
+        mask.append_kind(rect_kind(Rect::new(0.0, 0.0, 100.0, 100.0)));
+
+        let mut outer = tree.root().append_kind(group_kind(None, Some("mask1")));
+        let mut inner = outer.append_kind(group_kind(Some("clip1"), None));
+        inner.append_kind(rect_kind(Rect::new(10.0, 10.0, 50.0, 50.0)));
+
+        tree
+    }
+
+    fn has_clip_path(tree: &usvg::Tree) -> bool {
+        tree.root().descendants().any(|n| {
+            match *n.borrow() {
+                usvg::NodeKind::Group(ref g) => g.clip_path.is_some(),
+                _ => false,
+            }
+        })
+    }
+
+    #[test]
+    fn bake_inside_user_space_mask() {
+        let tree = masked_tree(usvg::Units::UserSpaceOnUse);
+        assert_eq!(bake_clip_paths(&tree), 1);
+        assert!(!has_clip_path(&tree));
+    }
+
+    #[test]
+    fn skip_inside_bbox_mask() {
+        // The mask region depends on the masked group bbox,
+        // which would shrink after baking.
+        let tree = masked_tree(usvg::Units::ObjectBoundingBox);
+        assert_eq!(bake_clip_paths(&tree), 0);
+        assert!(has_clip_path(&tree));
+    }
+
+    #[test]
+    fn convex_polygons() {
+        assert!(is_convex(&rect(0.0, 0.0, 10.0, 10.0)));
+        assert!(is_convex(&reversed(rect(0.0, 0.0, 10.0, 10.0))));
+        assert!(is_convex(&[(0.0, 0.0), (10.0, 0.0), (5.0, 8.0)]));
+
+        // Duplicated and collinear points.
+        assert!(is_convex(&[(0.0, 0.0), (0.0, 0.0), (5.0, 0.0), (10.0, 0.0),
+                            (10.0, 10.0), (0.0, 10.0), (0.0, 0.0)]));
+    }
+
+    #[test]
+    fn concave_polygons() {
+        // L-shape.
+        assert!(!is_convex(&[(0.0, 0.0), (10.0, 0.0), (10.0, 5.0), (5.0, 5.0),
+                             (5.0, 10.0), (0.0, 10.0)]));
+    }
+
+    #[test]
+    fn self_intersecting_polygons() {
+        // Bowtie.
+        assert!(!is_convex(&[(0.0, 0.0), (10.0, 10.0), (10.0, 0.0), (0.0, 10.0)]));
+
+        // Pentagram. All turns have the same sign, but it makes two turns.
+        let star: Polygon = (0..5).map(|i| {
+            let a = (i * 144) as f64 * f64::consts::PI / 180.0;
+            (a.cos() * 10.0, a.sin() * 10.0)
+        }).collect();
+        assert!(!is_convex(&star));
+    }
+
+    #[test]
+    fn degenerate_polygons() {
+        assert!(!is_convex(&[]));
+        assert!(!is_convex(&[(0.0, 0.0), (10.0, 0.0)]));
+        assert!(!is_convex(&[(0.0, 0.0), (5.0, 0.0), (10.0, 0.0)]));
+        assert!(!is_convex(&[(0.0, 0.0), (10.0, 0.0), (0.0, 0.0), (10.0, 0.0)]));
+    }
+
+    #[test]
+    fn subpaths_split() {
+        let mut segments = path(&rect(0.0, 0.0, 10.0, 10.0));
+        add_subpath(&mut segments, &rect(20.0, 0.0, 10.0, 10.0));
+        // A line is not a polygon.
+        add_subpath(&mut segments, &[(0.0, 0.0), (10.0, 0.0)]);
+
+        let list = subpaths(&segments).unwrap();
+        assert_eq!(list, vec![rect(0.0, 0.0, 10.0, 10.0), rect(20.0, 0.0, 10.0, 10.0)]);
+    }
+
+    #[test]
+    fn subpaths_after_close_path() {
+        // A subpath after `ClosePath` starts from the previous `MoveTo`.
+        let segments = vec![
+            usvg::PathSegment::MoveTo { x: 0.0, y: 0.0 },
+            usvg::PathSegment::LineTo { x: 10.0, y: 0.0 },
+            usvg::PathSegment::LineTo { x: 10.0, y: 10.0 },
+            usvg::PathSegment::ClosePath,
+            usvg::PathSegment::LineTo { x: -10.0, y: 0.0 },
+            usvg::PathSegment::LineTo { x: -10.0, y: -10.0 },
+        ];
+
+        let list = subpaths(&segments).unwrap();
+        assert_eq!(list, vec![
+            vec![(0.0, 0.0), (10.0, 0.0), (10.0, 10.0)],
+            vec![(0.0, 0.0), (-10.0, 0.0), (-10.0, -10.0)],
+        ]);
+    }
+
+    #[test]
+    fn subpaths_with_curves() {
+        let segments = vec![
+            usvg::PathSegment::MoveTo { x: 0.0, y: 0.0 },
+            usvg::PathSegment::CurveTo { x1: 5.0, y1: 5.0, x2: 5.0, y2: 5.0, x: 10.0, y: 0.0 },
+            usvg::PathSegment::ClosePath,
+        ];
+
+        assert!(subpaths(&segments).is_none());
+    }
+
+    #[test]
+    fn clip_by_vertical_edge() {
+        let square = rect(0.0, 0.0, 10.0, 10.0);
+
+        // A clockwise, in the SVG coordinates, edge that keeps the right side.
+        let out = clip_by_edge(&square, (4.0, 0.0), (4.0, 10.0), -1.0);
+        assert_eq!(bounds(&out), (4.0, 0.0, 10.0, 10.0));
+
+        // The same edge with an opposite orientation keeps the left side.
+        let out = clip_by_edge(&square, (4.0, 0.0), (4.0, 10.0), 1.0);
+        assert_eq!(bounds(&out), (0.0, 0.0, 4.0, 10.0));
+
+        // Outside.
+        let out = clip_by_edge(&square, (20.0, 0.0), (20.0, 10.0), -1.0);
+        assert!(out.is_empty());
+    }
+
+    #[test]
+    fn clip_rect_by_rect() {
+        let segments = path(&rect(0.0, 0.0, 10.0, 10.0));
+
+        for clip in &[rect(5.0, 5.0, 10.0, 10.0), reversed(rect(5.0, 5.0, 10.0, 10.0))] {
+            let clipped = clip_segments(&segments, clip);
+            let list = subpaths(&clipped).unwrap();
+            assert_eq!(list.len(), 1);
+            assert_eq!(bounds(&list[0]), (5.0, 5.0, 10.0, 10.0));
+        }
+    }
+
+    #[test]
+    fn clip_outside() {
+        let segments = path(&rect(0.0, 0.0, 10.0, 10.0));
+        assert!(clip_segments(&segments, &rect(20.0, 20.0, 10.0, 10.0)).is_empty());
+    }
+
+    #[test]
+    fn clip_preserves_winding() {
+        // An outer square, an opposite inner square that is a hole with both fill rules
+        // and a same direction square that is a hole only with the `evenodd` fill rule.
+        let mut segments = path(&rect(0.0, 0.0, 30.0, 10.0));
+        add_subpath(&mut segments, &reversed(rect(2.0, 2.0, 6.0, 6.0)));
+        add_subpath(&mut segments, &rect(12.0, 2.0, 6.0, 6.0));
+
+        let clip = rect(1.0, 1.0, 20.0, 8.0);
+        let clipped = clip_segments(&segments, &clip);
+
+        let points = [(1.5, 1.5), (5.0, 5.0), (15.0, 5.0), (10.0, 5.0), (20.5, 8.5)];
+        for &p in &points {
+            let before = winding(&segments, p);
+            let after = winding(&clipped, p);
+
+            // Non-zero.
+            assert_eq!(before != 0, after != 0, "{:?}", p);
+            // Even-odd.
+            assert_eq!(before % 2 != 0, after % 2 != 0, "{:?}", p);
+        }
+
+        assert_eq!(winding(&clipped, (5.0, 5.0)), 0);
+        assert_eq!(winding(&clipped, (15.0, 5.0)).abs(), 2);
+
+        // Outside of the clip.
+        assert_eq!(winding(&clipped, (25.0, 5.0)), 0);
+        assert_eq!(winding(&clipped, (0.5, 0.5)), 0);
+    }
+
+    #[test]
+    fn clip_in_path_coordinates() {
+        // The clip polygon is mapped into the path coordinates
+        // using the inverted path transform.
+        let mut path_ts = usvg::Transform::default();
+        path_ts.translate(10.0, 20.0);
+        path_ts.scale(2.0, 4.0);
+
+        let ts = invert(&path_ts).unwrap();
+        let clip: Polygon = rect(10.0, 20.0, 10.0, 20.0).iter()
+            .map(|&(x, y)| ts.apply(x, y)).collect();
+        assert_eq!(clip, rect(0.0, 0.0, 5.0, 5.0));
+
+        let clipped = clip_segments(&path(&rect(-10.0, -10.0, 20.0, 20.0)), &clip);
+        assert_eq!(bounds(&subpaths(&clipped).unwrap()[0]), (0.0, 0.0, 5.0, 5.0));
+
+        let mut identity = path_ts;
+        identity.append(&ts);
+        assert_eq!(identity, usvg::Transform::default());
+    }
+
+    #[test]
+    fn singular_transform() {
+        assert!(invert(&usvg::Transform::new(1.0, 2.0, 2.0, 4.0, 0.0, 0.0)).is_none());
+        assert!(invert(&usvg::Transform::new(0.0, 0.0, 0.0, 0.0, 5.0, 5.0)).is_none());
+    }
+}
@@ -0,0 +1,719 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::collections::HashMap;
+
+// external
+use usvg;
+use usvg::prelude::*;
+
+// self
+use geom::*;
+use utils;
+use super::invert;
+
+
+/// Replaces gradients with stops of the same color and opacity with a solid color.
+///
+/// Doesn't change the result, so it's safe to apply to any tree.
+/// Unused gradients are kept in `defs`.
+///
+/// Returns the number of simplified references.
+pub fn simplify_effects(tree: &usvg::Tree) -> u32 {
+    replace_solid_paints(tree, solid_gradient)
+}
+
+/// Replaces effects that cover the whole content with their cheap equivalents.
+///
+/// - A pattern that is fully covered by a single solid rect becomes a solid color.
+/// - A mask with a single white rect that covers the group content
+///   becomes a group opacity.
+/// - A clip path with a single rect that covers the group content is removed.
+///
+/// Masks and clip paths are checked only for groups that contain paths,
+/// images and other such groups. Unused patterns, masks and clip paths
+/// are kept in `defs`.
+///
+/// A rect that touches the content edges still antialiases them,
+/// so the result may have slightly different edge pixels.
+///
+/// Returns the number of simplified references.
+pub fn simplify_covering_effects(tree: &usvg::Tree) -> u32 {
+    // Patterns are resolved first, so they can be used by masks.
+    let mut count = replace_solid_paints(tree, |node| {
+        match *node.borrow() {
+            usvg::NodeKind::Pattern(ref pattern) => solid_pattern(node, pattern),
+            _ => None,
+        }
+    });
+
+    let groups: Vec<_> = tree.root().descendants().filter(|n| {
+        if let usvg::NodeKind::Group(ref g) = *n.borrow() {
+            g.clip_path.is_some() || g.mask.is_some()
+        } else {
+            false
+        }
+    }).collect();
+
+    for mut node in groups {
+        count += simplify_group(tree, &mut node);
+    }
+
+    count
+}
+
+/// Replaces links to paint servers for which `f` returns a color and an opacity.
+fn replace_solid_paints<F>(tree: &usvg::Tree, f: F) -> u32
+    where F: Fn(&usvg::Node) -> Option<(usvg::Color, f64)>
+{
+    let mut solid_paints = HashMap::new();
+    for node in tree.root().descendants() {
+        if let Some(paint) = f(&node) {
+            solid_paints.insert(node.id().to_string(), paint);
+        }
+    }
+
+    if solid_paints.is_empty() {
+        return 0;
+    }
+
+    let mut count = 0;
+    for node in tree.root().descendants() {
+        count += replace_paints(&node, &solid_paints);
+    }
+
+    count
+}
+
+/// Returns a color and an opacity the gradient is equivalent to.
+fn solid_gradient(node: &usvg::Node) -> Option<(usvg::Color, f64)> {
+    let kind = node.borrow();
+    let base = match *kind {
+        usvg::NodeKind::LinearGradient(ref lg) => &lg.base,
+        usvg::NodeKind::RadialGradient(ref rg) => &rg.base,
+        _ => return None,
+    };
+
+    let first = base.stops.first()?;
+    let is_uniform = base.stops.iter().all(|stop| {
+        stop.color == first.color && stop.opacity.value().fuzzy_eq(&first.opacity.value())
+    });
+
+    if is_uniform {
+        Some((first.color, first.opacity.value()))
+    } else {
+        None
+    }
+}
+
+fn solid_pattern(node: &usvg::Node, pattern: &usvg::Pattern) -> Option<(usvg::Color, f64)> {
+    if    pattern.units != usvg::Units::UserSpaceOnUse
+       || pattern.content_units != usvg::Units::UserSpaceOnUse
+       || pattern.view_box.is_some()
+    {
+        return None;
+    }
+
+    let tile = pattern.rect;
+    if !(tile.width > 0.0 && tile.height > 0.0) {
+        return None;
+    }
+
+    let (color, opacity, rect) = single_rect(node)?;
+
+    // The tile content starts at the tile origin.
+    if !contains(rect, Rect::new(0.0, 0.0, tile.width, tile.height)) {
+        return None;
+    }
+
+    Some((color, opacity))
+}
+
+/// Returns a color, an opacity and a rect of the only child of the `parent`,
+/// if it's a filled rect without a stroke and a transform.
+fn single_rect(parent: &usvg::Node) -> Option<(usvg::Color, f64, Rect)> {
+    let mut children = parent.children();
+    let child = children.next()?;
+    if children.next().is_some() {
+        return None;
+    }
+
+    if !child.transform().is_default() {
+        return None;
+    }
+
+    let kind = child.borrow();
+    let path = match *kind {
+        usvg::NodeKind::Path(ref path) => path,
+        _ => return None,
+    };
+
+    if path.stroke.is_some() {
+        return None;
+    }
+
+    let fill = path.fill.as_ref()?;
+    let color = match fill.paint {
+        usvg::Paint::Color(c) => c,
+        _ => return None,
+    };
+
+    let rect = utils::path_to_rect(&path.segments)?;
+    Some((color, fill.opacity.value(), rect))
+}
+
+fn replace_paints(node: &usvg::Node, paints: &HashMap<String, (usvg::Color, f64)>) -> u32 {
+    let mut count = 0;
+
+    {
+        let mut replace_fill = |fill: &mut Option<usvg::Fill>| {
+            if let Some(ref mut fill) = *fill {
+                if let Some(opacity) = replace_paint(&mut fill.paint, paints) {
+                    fill.opacity = (fill.opacity.value() * opacity).into();
+                    count += 1;
+                }
+            }
+        };
+
+        match *node.clone().borrow_mut() {
+            usvg::NodeKind::Path(ref mut path) => {
+                replace_fill(&mut path.fill);
+            }
+            usvg::NodeKind::Text(ref mut text) => {
+                for chunk in &mut text.chunks {
+                    for span in &mut chunk.spans {
+                        replace_fill(&mut span.fill);
+                    }
+                }
+            }
+            _ => {}
+        }
+    }
+
+    {
+        let mut replace_stroke = |stroke: &mut Option<usvg::Stroke>| {
+            if let Some(ref mut stroke) = *stroke {
+                if let Some(opacity) = replace_paint(&mut stroke.paint, paints) {
+                    stroke.opacity = (stroke.opacity.value() * opacity).into();
+                    count += 1;
+                }
+            }
+        };
+
+        match *node.clone().borrow_mut() {
+            usvg::NodeKind::Path(ref mut path) => {
+                replace_stroke(&mut path.stroke);
+            }
+            usvg::NodeKind::Text(ref mut text) => {
+                for chunk in &mut text.chunks {
+                    for span in &mut chunk.spans {
+                        replace_stroke(&mut span.stroke);
+                    }
+                }
+            }
+            _ => {}
+        }
+    }
+
+    count
+}
+
+/// Replaces a link with a color and returns an opacity that should be applied.
+fn replace_paint(
+    paint: &mut usvg::Paint,
+    paints: &HashMap<String, (usvg::Color, f64)>,
+) -> Option<f64> {
+    let (color, opacity) = match *paint {
+        usvg::Paint::Link(ref id) => *paints.get(id)?,
+        _ => return None,
+    };
+
+    *paint = usvg::Paint::Color(color);
+    Some(opacity)
+}
+
+fn simplify_group(tree: &usvg::Tree, node: &mut usvg::Node) -> u32 {
+    let (clip_id, mask_id) = match *node.borrow() {
+        usvg::NodeKind::Group(ref g) => (g.clip_path.clone(), g.mask.clone()),
+        _ => return 0,
+    };
+
+    // The content bbox, including strokes.
+    let content = match content_bbox(node, usvg::Transform::default()) {
+        Some(v) => v,
+        None => return 0,
+    };
+
+    let mut count = 0;
+
+    if let Some(clip_node) = clip_id.and_then(|id| tree.defs_by_id(&id)) {
+        if is_redundant_clip(&clip_node, node, content) {
+            if let usvg::NodeKind::Group(ref mut g) = *node.borrow_mut() {
+                g.clip_path = None;
+            }
+
+            count += 1;
+        }
+    }
+
+    if let Some(mask_node) = mask_id.and_then(|id| tree.defs_by_id(&id)) {
+        if let Some(opacity) = mask_opacity(&mask_node, node, content) {
+            if let usvg::NodeKind::Group(ref mut g) = *node.borrow_mut() {
+                let opacity = g.opacity.map(|v| v.value()).unwrap_or(1.0) * opacity;
+                g.opacity = if opacity.fuzzy_eq(&1.0) { None } else { Some(opacity.into()) };
+                g.mask = None;
+            }
+
+            count += 1;
+        }
+    }
+
+    count
+}
+
+fn is_redundant_clip(clip_node: &usvg::Node, group: &usvg::Node, content: Rect) -> bool {
+    let (units, cp_ts) = match *clip_node.borrow() {
+        usvg::NodeKind::ClipPath(ref cp) => (cp.units, cp.transform),
+        _ => return false,
+    };
+
+    let mut children = clip_node.children();
+    let child = match (children.next(), children.next()) {
+        (Some(child), None) => child,
+        _ => return false,
+    };
+
+    let rect = match *child.borrow() {
+        usvg::NodeKind::Path(ref path) if path.fill.is_some() => {
+            match utils::path_to_rect(&path.segments) {
+                Some(v) => v,
+                None => return false,
+            }
+        }
+        _ => return false,
+    };
+
+    let mut ts = cp_ts;
+    if units == usvg::Units::ObjectBoundingBox {
+        if !(cp_ts.is_default() && child.transform().is_default()) {
+            return false;
+        }
+
+        let rect = match bbox_rect(rect, group) {
+            Some(v) => v,
+            None => return false,
+        };
+
+        return contains(rect, content);
+    }
+
+    ts.append(&child.transform());
+    transformed_contains(rect, &ts, content)
+}
+
+/// Returns an opacity the mask is equivalent to.
+fn mask_opacity(mask_node: &usvg::Node, group: &usvg::Node, content: Rect) -> Option<f64> {
+    let (units, content_units, region) = match *mask_node.borrow() {
+        usvg::NodeKind::Mask(ref mask) => (mask.units, mask.content_units, mask.rect),
+        _ => return None,
+    };
+
+    let (color, opacity, rect) = single_rect(mask_node)?;
+    if color != usvg::Color::new(255, 255, 255) {
+        return None;
+    }
+
+    let region = if units == usvg::Units::ObjectBoundingBox {
+        bbox_rect(region, group)?
+    } else {
+        region
+    };
+
+    let rect = if content_units == usvg::Units::ObjectBoundingBox {
+        bbox_rect(rect, group)?
+    } else {
+        rect
+    };
+
+    if contains(region, content) && contains(rect, content) {
+        Some(opacity)
+    } else {
+        None
+    }
+}
+
+/// Maps an `objectBoundingBox` rect into the group coordinates.
+///
+/// The result is smaller or equal to the one used during rendering,
+/// so it's suitable only for coverage checks.
+fn bbox_rect(rect: Rect, group: &usvg::Node) -> Option<Rect> {
+    // A rect that covers the whole bbox covers any bbox that is bigger too.
+    if !(rect.x <= 0.0 && rect.y <= 0.0 && rect.x + rect.width >= 1.0 && rect.y + rect.height >= 1.0) {
+        return None;
+    }
+
+    let bbox = fill_bbox(group)?;
+    Some(Rect::new(
+        bbox.x + rect.x * bbox.width,
+        bbox.y + rect.y * bbox.height,
+        rect.width * bbox.width,
+        rect.height * bbox.height,
+    ))
+}
+
+/// Calculates a bbox that the backend uses for `objectBoundingBox` units.
+///
+/// Children transforms are not applied by the backend,
+/// so only groups without them are supported.
+fn fill_bbox(parent: &usvg::Node) -> Option<Rect> {
+    let mut bbox = Rect::new_bbox();
+    let mut is_empty = true;
+    for child in parent.children() {
+        if !child.transform().is_default() {
+            return None;
+        }
+
+        let r = match *child.borrow() {
+            usvg::NodeKind::Path(ref path) if path.segments.len() >= 2 => {
+                utils::path_bbox(&path.segments, None, &usvg::Transform::default())
+            }
+            usvg::NodeKind::Image(ref img) => img.view_box.rect,
+            usvg::NodeKind::Group(_) => fill_bbox(&child)?,
+            _ => return None,
+        };
+
+        bbox.expand(r);
+        is_empty = false;
+    }
+
+    if is_empty { None } else { Some(bbox) }
+}
+
+/// Calculates a conservative bbox of everything the group can draw,
+/// in the group coordinates.
+fn content_bbox(parent: &usvg::Node, ts: usvg::Transform) -> Option<Rect> {
+    let mut bbox = Rect::new_bbox();
+    let mut is_empty = true;
+    for child in parent.children() {
+        let mut child_ts = ts;
+        child_ts.append(&child.transform());
+
+        let r = match *child.borrow() {
+            usvg::NodeKind::Path(ref path) => {
+                if path.segments.len() < 2 {
+                    continue;
+                }
+
+                utils::path_bounds(&path.segments, path.stroke.as_ref(), &child_ts)
+            }
+            usvg::NodeKind::Image(ref img) if img.format != usvg::ImageFormat::SVG => {
+                utils::transform_rect(img.view_box.rect, &child_ts)
+            }
+            usvg::NodeKind::Group(_) => {
+                match content_bbox(&child, child_ts) {
+                    Some(v) => v,
+                    None => return None,
+                }
+            }
+            // Text and SVG images bboxes are unknown.
+            _ => return None,
+        };
+
+        bbox.expand(r);
+        is_empty = false;
+    }
+
+    if is_empty { None } else { Some(bbox) }
+}
+
+fn contains(outer: Rect, inner: Rect) -> bool {
+    outer.x <= inner.x && outer.y <= inner.y
+        && outer.x + outer.width >= inner.x + inner.width
+        && outer.y + outer.height >= inner.y + inner.height
+}
+
+/// Checks that the `rect` transformed by `ts` contains the `area`.
+fn transformed_contains(rect: Rect, ts: &usvg::Transform, area: Rect) -> bool {
+    let ts = match invert(ts) {
+        Some(v) => v,
+        None => return false,
+    };
+
+    // A transformed rect is convex, so it's enough to check the corners.
+    let corners = [
+        (area.x, area.y),
+        (area.x + area.width, area.y),
+        (area.x, area.y + area.height),
+        (area.x + area.width, area.y + area.height),
+    ];
+
+    corners.iter().all(|&(x, y)| {
+        let (x, y) = ts.apply(x, y);
+        x >= rect.x && y >= rect.y && x <= rect.x + rect.width && y <= rect.y + rect.height
+    })
+}
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn new_tree() -> usvg::Tree {
+        usvg::Tree::create(usvg::Svg {
+            size: Size::new(100.0, 100.0),
+            view_box: usvg::ViewBox {
+                rect: Rect::new(0.0, 0.0, 100.0, 100.0),
+                aspect: usvg::AspectRatio::default(),
+            },
+        })
+    }
+
+    fn rect_path(r: Rect, paint: usvg::Paint) -> usvg::NodeKind {
+        usvg::NodeKind::Path(usvg::Path {
+            id: String::new(),
+            transform: usvg::Transform::default(),
+            fill: Some(usvg::Fill { paint, ..usvg::Fill::default() }),
+            stroke: None,
+            segments: utils::rect_to_path(r),
+        })
+    }
+
+    fn white() -> usvg::Paint {
+        usvg::Paint::Color(usvg::Color::new(255, 255, 255))
+    }
+
+    fn link(id: &str) -> usvg::Paint {
+        usvg::Paint::Link(id.to_string())
+    }
+
+    fn stop(color: usvg::Color, opacity: f64) -> usvg::Stop {
+        usvg::Stop { offset: 0.0.into(), color, opacity: opacity.into() }
+    }
+
+    fn add_gradient(tree: &mut usvg::Tree, id: &str, stops: Vec<usvg::Stop>) {
+        tree.append_to_defs(usvg::NodeKind::LinearGradient(usvg::LinearGradient {
+            id: id.to_string(),
+            x1: 0.0,
+            y1: 0.0,
+            x2: 1.0,
+            y2: 0.0,
+            base: usvg::BaseGradient {
+                units: usvg::Units::ObjectBoundingBox,
+                transform: usvg::Transform::default(),
+                spread_method: usvg::SpreadMethod::Pad,
+                stops,
+            },
+        }));
+    }
+
+    fn add_clip_path(tree: &mut usvg::Tree, id: &str, units: usvg::Units, r: Rect) {
+        let mut node = tree.append_to_defs(usvg::NodeKind::ClipPath(usvg::ClipPath {
+            id: id.to_string(),
+            units,
+            transform: usvg::Transform::default(),
+        }));
+        node.append_kind(rect_path(r, white()));
+    }
+
+    fn add_mask(tree: &mut usvg::Tree, id: &str, r: Rect, paint: usvg::Paint, opacity: f64) {
+        let mut node = tree.append_to_defs(usvg::NodeKind::Mask(usvg::Mask {
+            id: id.to_string(),
+            units: usvg::Units::UserSpaceOnUse,
+            content_units: usvg::Units::UserSpaceOnUse,
+            rect: Rect::new(-10.0, -10.0, 120.0, 120.0),
+        }));
+
+        if let usvg::NodeKind::Path(ref mut path) = *node.append_kind(rect_path(r, paint)).borrow_mut() {
+            path.fill.as_mut().unwrap().opacity = opacity.into();
+        }
+    }
+
+    fn add_pattern(tree: &mut usvg::Tree, id: &str, units: usvg::Units, r: Rect) {
+        let mut node = tree.append_to_defs(usvg::NodeKind::Pattern(usvg::Pattern {
+            id: id.to_string(),
+            units,
+            content_units: usvg::Units::UserSpaceOnUse,
+            transform: usvg::Transform::default(),
+            rect: Rect::new(0.0, 0.0, 10.0, 10.0),
+            view_box: None,
+        }));
+        node.append_kind(rect_path(r, usvg::Paint::Color(usvg::Color::new(0, 0, 255))));
+    }
+
+    /// Adds a group with a single rect at 10,10 20x20.
+    fn add_group(
+        tree: &usvg::Tree,
+        clip_path: Option<&str>,
+        mask: Option<&str>,
+        opacity: Option<f64>,
+    ) -> usvg::Node {
+        let mut g = tree.root().append_kind(usvg::NodeKind::Group(usvg::Group {
+            id: String::new(),
+            transform: usvg::Transform::default(),
+            opacity: opacity.map(|v| v.into()),
+            clip_path: clip_path.map(|v| v.to_string()),
+            mask: mask.map(|v| v.to_string()),
+        }));
+        g.append_kind(rect_path(Rect::new(10.0, 10.0, 20.0, 20.0), white()));
+        g
+    }
+
+    fn add_rect(tree: &usvg::Tree, paint: usvg::Paint) -> usvg::Node {
+        tree.root().append_kind(rect_path(Rect::new(10.0, 10.0, 20.0, 20.0), paint))
+    }
+
+    fn fill(node: &usvg::Node) -> (usvg::Paint, f64) {
+        match *node.borrow() {
+            usvg::NodeKind::Path(ref path) => {
+                let fill = path.fill.as_ref().unwrap();
+                (fill.paint.clone(), fill.opacity.value())
+            }
+            _ => unreachable!(),
+        }
+    }
+
+    fn group(node: &usvg::Node) -> (Option<String>, Option<String>, Option<f64>) {
+        match *node.borrow() {
+            usvg::NodeKind::Group(ref g) => {
+                (g.clip_path.clone(), g.mask.clone(), g.opacity.map(|v| v.value()))
+            }
+            _ => unreachable!(),
+        }
+    }
+
+    #[test]
+    fn uniform_gradient() {
+        let mut tree = new_tree();
+        let red = usvg::Color::new(255, 0, 0);
+        add_gradient(&mut tree, "lg1", vec![stop(red, 0.5), stop(red, 0.5)]);
+        let node = add_rect(&tree, link("lg1"));
+
+        assert_eq!(simplify_effects(&tree), 1);
+        assert_eq!(fill(&node), (usvg::Paint::Color(red), 0.5));
+    }
+
+    #[test]
+    fn non_uniform_gradient() {
+        let mut tree = new_tree();
+        let red = usvg::Color::new(255, 0, 0);
+        add_gradient(&mut tree, "lg1", vec![stop(red, 1.0), stop(red, 0.5)]);
+        add_gradient(&mut tree, "lg2", vec![stop(red, 1.0), stop(usvg::Color::new(0, 0, 0), 1.0)]);
+        let node1 = add_rect(&tree, link("lg1"));
+        let node2 = add_rect(&tree, link("lg2"));
+
+        assert_eq!(simplify_effects(&tree), 0);
+        assert_eq!(fill(&node1).0, link("lg1"));
+        assert_eq!(fill(&node2).0, link("lg2"));
+    }
+
+    #[test]
+    fn exact_pass_keeps_covering_effects() {
+        let mut tree = new_tree();
+        add_clip_path(&mut tree, "clip1", usvg::Units::UserSpaceOnUse,
+                      Rect::new(0.0, 0.0, 100.0, 100.0));
+        add_mask(&mut tree, "mask1", Rect::new(0.0, 0.0, 100.0, 100.0), white(), 1.0);
+        add_pattern(&mut tree, "patt1", usvg::Units::UserSpaceOnUse,
+                    Rect::new(0.0, 0.0, 10.0, 10.0));
+        let g = add_group(&tree, Some("clip1"), Some("mask1"), None);
+        let node = add_rect(&tree, link("patt1"));
+
+        assert_eq!(simplify_effects(&tree), 0);
+        assert_eq!(group(&g), (Some("clip1".to_string()), Some("mask1".to_string()), None));
+        assert_eq!(fill(&node).0, link("patt1"));
+    }
+
+    #[test]
+    fn solid_pattern() {
+        let mut tree = new_tree();
+        add_pattern(&mut tree, "patt1", usvg::Units::UserSpaceOnUse,
+                    Rect::new(-1.0, 0.0, 11.0, 10.0));
+        let node = add_rect(&tree, link("patt1"));
+
+        assert_eq!(simplify_covering_effects(&tree), 1);
+        assert_eq!(fill(&node), (usvg::Paint::Color(usvg::Color::new(0, 0, 255)), 1.0));
+    }
+
+    #[test]
+    fn partial_pattern() {
+        let mut tree = new_tree();
+        add_pattern(&mut tree, "patt1", usvg::Units::UserSpaceOnUse,
+                    Rect::new(0.0, 0.0, 10.0, 9.0));
+        // The tile size depends on the bbox.
+        add_pattern(&mut tree, "patt2", usvg::Units::ObjectBoundingBox,
+                    Rect::new(0.0, 0.0, 10.0, 10.0));
+        let node1 = add_rect(&tree, link("patt1"));
+        let node2 = add_rect(&tree, link("patt2"));
+
+        assert_eq!(simplify_covering_effects(&tree), 0);
+        assert_eq!(fill(&node1).0, link("patt1"));
+        assert_eq!(fill(&node2).0, link("patt2"));
+    }
+
+    #[test]
+    fn covering_clip_path() {
+        let mut tree = new_tree();
+        add_clip_path(&mut tree, "clip1", usvg::Units::UserSpaceOnUse,
+                      Rect::new(5.0, 5.0, 30.0, 30.0));
+        add_clip_path(&mut tree, "clip2", usvg::Units::ObjectBoundingBox,
+                      Rect::new(0.0, 0.0, 1.0, 1.0));
+        let g1 = add_group(&tree, Some("clip1"), None, None);
+        let g2 = add_group(&tree, Some("clip2"), None, None);
+
+        assert_eq!(simplify_covering_effects(&tree), 2);
+        assert_eq!(group(&g1), (None, None, None));
+        assert_eq!(group(&g2), (None, None, None));
+    }
+
+    #[test]
+    fn partial_clip_path() {
+        let mut tree = new_tree();
+        add_clip_path(&mut tree, "clip1", usvg::Units::UserSpaceOnUse,
+                      Rect::new(15.0, 5.0, 30.0, 30.0));
+        add_clip_path(&mut tree, "clip2", usvg::Units::ObjectBoundingBox,
+                      Rect::new(0.0, 0.0, 1.0, 0.5));
+        let g1 = add_group(&tree, Some("clip1"), None, None);
+        let g2 = add_group(&tree, Some("clip2"), None, None);
+
+        assert_eq!(simplify_covering_effects(&tree), 0);
+        assert_eq!(group(&g1).0, Some("clip1".to_string()));
+        assert_eq!(group(&g2).0, Some("clip2".to_string()));
+    }
+
+    #[test]
+    fn covering_mask() {
+        let mut tree = new_tree();
+        add_mask(&mut tree, "mask1", Rect::new(0.0, 0.0, 100.0, 100.0), white(), 0.5);
+        let g1 = add_group(&tree, None, Some("mask1"), None);
+        let g2 = add_group(&tree, None, Some("mask1"), Some(0.5));
+
+        assert_eq!(simplify_covering_effects(&tree), 2);
+        assert_eq!(group(&g1), (None, None, Some(0.5)));
+        assert_eq!(group(&g2), (None, None, Some(0.25)));
+    }
+
+    #[test]
+    fn opaque_covering_mask() {
+        let mut tree = new_tree();
+        add_mask(&mut tree, "mask1", Rect::new(0.0, 0.0, 100.0, 100.0), white(), 1.0);
+        let g = add_group(&tree, None, Some("mask1"), None);
+
+        assert_eq!(simplify_covering_effects(&tree), 1);
+        assert_eq!(group(&g), (None, None, None));
+    }
+
+    #[test]
+    fn partial_mask() {
+        let mut tree = new_tree();
+        add_mask(&mut tree, "mask1", Rect::new(0.0, 0.0, 20.0, 100.0), white(), 1.0);
+        // Only white masks are equal to opacity.
+        add_mask(&mut tree, "mask2", Rect::new(0.0, 0.0, 100.0, 100.0),
+                 usvg::Paint::Color(usvg::Color::new(255, 0, 0)), 1.0);
+        let g1 = add_group(&tree, None, Some("mask1"), None);
+        let g2 = add_group(&tree, None, Some("mask2"), None);
+
+        assert_eq!(simplify_covering_effects(&tree), 0);
+        assert_eq!(group(&g1).1, Some("mask1".to_string()));
+        assert_eq!(group(&g2).1, Some("mask2".to_string()));
+    }
+}
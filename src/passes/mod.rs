@@ -0,0 +1,41 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Optional tree preprocessing passes.
+//!
+//! Passes modify the `usvg` tree in place to make the rendering cheaper.
+//!
+//! `simplify_effects` doesn't change the result and is applied to SVG images.
+//! Other passes are not applied automatically, because they can slightly
+//! change the antialiasing.
+
+// external
+use usvg;
+use usvg::prelude::*;
+
+mod clip;
+mod effects;
+
+pub use self::clip::bake_clip_paths;
+pub use self::effects::{
+    simplify_effects,
+    simplify_covering_effects,
+};
+
+
+fn invert(ts: &usvg::Transform) -> Option<usvg::Transform> {
+    let det = ts.a * ts.d - ts.b * ts.c;
+    if det.is_fuzzy_zero() {
+        return None;
+    }
+
+    Some(usvg::Transform::new(
+        ts.d / det,
+        -ts.b / det,
+        -ts.c / det,
+        ts.a / det,
+        (ts.c * ts.f - ts.d * ts.e) / det,
+        (ts.b * ts.e - ts.a * ts.f) / det,
+    ))
+}
@@ -0,0 +1,153 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Rendering statistics.
+//!
+//! Statistics are collected per thread, so they must be read
+//! from the same thread that did the rendering.
+
+use std::cell::Cell;
+
+
+/// Rendering statistics.
+#[derive(Clone, Copy, Default, Debug)]
+pub struct RenderStats {
+    /// Number of allocated layers.
+    pub layers: u32,
+    /// Number of rendered pattern tiles.
+    pub patterns: u32,
+    /// Amount of memory allocated for layers and pattern tiles, in bytes.
+    ///
+    /// Since layers are kept alive until the end of the rendering
+    /// and are counted by their peak size, this is a good estimation
+    /// of the peak canvas memory usage.
+    pub surfaces_size: u64,
+    /// Number of nodes skipped by occlusion culling.
+    pub culled_nodes: u32,
+    /// Number of clip path and mask layers reused from the coverage cache.
+    pub coverage_cache_hits: u32,
+    /// Number of clip path and mask layers that were not found in the coverage cache.
+    pub coverage_cache_misses: u32,
+}
+
+thread_local!(static STATS: Cell<RenderStats> = Cell::new(RenderStats::default()));
+
+/// Resets the current thread statistics.
+pub fn reset() {
+    STATS.with(|s| s.set(RenderStats::default()));
+}
+
+/// Returns the current thread statistics.
+pub fn get() -> RenderStats {
+    STATS.with(|s| s.get())
+}
+
+pub(crate) fn update<F>(f: F)
+    where F: FnOnce(&mut RenderStats)
+{
+    STATS.with(|s| {
+        let mut stats = s.get();
+        f(&mut stats);
+        s.set(stats);
+    });
+}
+
+/// An allocation site.
+///
+/// Marks the rendering stage that is currently running,
+/// so a custom global allocator can group allocations by it.
+#[derive(Clone, Copy, PartialEq, Debug)]
+pub enum Site {
+    /// Everything else, including parsing.
+    Other,
+    /// Layers allocation.
+    Layers,
+    /// Text rendering.
+    Text,
+    /// Image decoding and rendering.
+    Image,
+    /// Pattern tiles rendering.
+    Pattern,
+    /// Path bounding box calculation.
+    PathBbox,
+}
+
+impl Site {
+    /// Returns all sites in the `as usize` order.
+    pub fn all() -> &'static [Site] {
+        &[Site::Other, Site::Layers, Site::Text, Site::Image, Site::Pattern, Site::PathBbox]
+    }
+
+    /// Returns a site name.
+    pub fn name(&self) -> &'static str {
+        match *self {
+            Site::Other     => "other",
+            Site::Layers    => "layers",
+            Site::Text      => "text",
+            Site::Image     => "image",
+            Site::Pattern   => "pattern",
+            Site::PathBbox  => "path_bbox",
+        }
+    }
+}
+
+// The site is per thread, so decoding threads and batch workers
+// do not mix up each other allocations.
+//
+// `Cell<usize>` has no destructor, so with a native thread-local storage
+// the access doesn't allocate and can be done from a global allocator.
+#[cfg(feature = "alloc-stats")]
+thread_local!(static SITE: Cell<usize> = Cell::new(0));
+
+/// Returns the current thread allocation site.
+///
+/// Doesn't allocate, so it can be called from a global allocator.
+///
+/// Always returns `Site::Other` without the `alloc-stats` build feature.
+#[cfg(feature = "alloc-stats")]
+pub fn site() -> Site {
+    // `try_with`, because the allocator can be called during the thread destruction.
+    let idx = SITE.try_with(|s| s.get()).unwrap_or(0);
+    Site::all().get(idx).cloned().unwrap_or(Site::Other)
+}
+
+/// Returns the current thread allocation site.
+///
+/// Always returns `Site::Other` without the `alloc-stats` build feature.
+#[cfg(not(feature = "alloc-stats"))]
+pub fn site() -> Site {
+    Site::Other
+}
+
+/// Restores the previous allocation site on drop.
+#[cfg(feature = "alloc-stats")]
+pub(crate) struct SiteGuard(usize);
+
+#[cfg(feature = "alloc-stats")]
+impl Drop for SiteGuard {
+    fn drop(&mut self) {
+        let prev = self.0;
+        let _ = SITE.try_with(|s| s.set(prev));
+    }
+}
+
+/// Sets the current thread allocation site until the returned guard is dropped.
+#[cfg(feature = "alloc-stats")]
+pub(crate) fn enter_site(site: Site) -> SiteGuard {
+    SiteGuard(SITE.try_with(|s| s.replace(site as usize)).unwrap_or(0))
+}
+
+/// A no-op guard, since sites are not tracked without the `alloc-stats` build feature.
+#[cfg(not(feature = "alloc-stats"))]
+pub(crate) struct SiteGuard;
+
+#[cfg(not(feature = "alloc-stats"))]
+#[inline]
+pub(crate) fn enter_site(_: Site) -> SiteGuard {
+    SiteGuard
+}
+
+pub(crate) fn surface_size(width: u32, height: u32) -> u64 {
+    width as u64 * height as u64 * 4
+}
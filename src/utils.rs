@@ -4,6 +4,7 @@
 
 //! Some useful utilities.
 
+use std::collections::HashMap;
 use std::f64;
 
 // external
@@ -13,6 +14,7 @@ pub use usvg::utils::*;
 
 // self
 use geom::*;
+use stats;
 use FitTo;
 
 
@@ -38,6 +40,70 @@ pub fn fit_to(size: ScreenSize, fit: FitTo) -> ScreenSize {
     }
 }
 
+/// Returns the image region that contains the `bbox`.
+///
+/// `bbox` is in the root coordinates, like the one returned by `calc_node_bbox`.
+/// The region is in the pixels of the image returned by `render_to_image`,
+/// rounded outwards and clipped by the image.
+///
+/// Returns `None` when the region is empty.
+pub fn trim_region(
+    tree: &usvg::Tree,
+    bbox: Rect,
+    fit: FitTo,
+) -> Option<ScreenRect> {
+    let (img_size, ts) = root_transform(tree, fit);
+
+    let r = transform_rect(bbox, &ts);
+    let x1 = r.x.floor().max(0.0);
+    let y1 = r.y.floor().max(0.0);
+    let x2 = (r.x + r.width).ceil().min(img_size.width as f64);
+    let y2 = (r.y + r.height).ceil().min(img_size.height as f64);
+    if !(x2 > x1 && y2 > y1) {
+        return None;
+    }
+
+    Some(ScreenRect::new(x1 as u32, y1 as u32, (x2 - x1) as u32, (y2 - y1) as u32))
+}
+
+/// Returns a `viewBox` for rendering only the `region` of the image.
+///
+/// The region is in the pixels of the image returned by `render_to_image`.
+/// Rendering using the returned `viewBox` into an image of the region size
+/// will produce the same pixels as the full rendering does.
+pub fn region_view_box(
+    tree: &usvg::Tree,
+    region: ScreenRect,
+    fit: FitTo,
+) -> usvg::ViewBox {
+    let (_, ts) = root_transform(tree, fit);
+
+    // The `viewBox` transform is a scale and a translate,
+    // so the region can be mapped back directly.
+    usvg::ViewBox {
+        rect: Rect::new(
+            (region.x as f64 - ts.e) / ts.a,
+            (region.y as f64 - ts.f) / ts.d,
+            region.width as f64 / ts.a,
+            region.height as f64 / ts.d,
+        ),
+        // Each axis has its own scale already.
+        aspect: usvg::AspectRatio {
+            defer: false,
+            align: usvg::Align::None,
+            slice: false,
+        },
+    }
+}
+
+/// Returns the full image size and the root `viewBox` transform.
+fn root_transform(tree: &usvg::Tree, fit: FitTo) -> (ScreenSize, usvg::Transform) {
+    let svg = tree.svg_node();
+    let img_size = fit_to(svg.size.to_screen_size(), fit);
+    let ts = view_box_to_transform(svg.view_box.rect, svg.view_box.aspect, img_size.to_size());
+    (img_size, ts)
+}
+
 pub(crate) fn apply_view_box(vb: &usvg::ViewBox, img_size: ScreenSize) -> ScreenSize {
     if vb.aspect.align == usvg::Align::None {
         vb.rect.to_screen_size()
@@ -81,26 +147,27 @@ pub fn path_bbox(
 
     use lyon_geom;
 
-    let mut path_buf;
-    let new_path = if !ts.is_default() {
-        // Clone only when transform is required.
-        path_buf = segments.to_vec();
-        transform_path(&mut path_buf, ts);
-        &path_buf
-    } else {
-        segments
-    };
+    let _site = stats::enter_site(stats::Site::PathBbox);
+
+    let has_ts = !ts.is_default();
 
     let (mut prev_x, mut prev_y, mut minx, mut miny, mut maxx, mut maxy) = {
-        if let usvg::PathSegment::MoveTo { x, y } = new_path[0] {
+        if let usvg::PathSegment::MoveTo { x, y } = segments[0] {
+            let (x, y) = if has_ts { ts.apply(x, y) } else { (x, y) };
             (x as f32, y as f32, x as f32, y as f32, x as f32, y as f32)
         } else {
             unreachable!();
         }
     };
 
-    for seg in new_path {
-        match *seg {
+    for seg in segments {
+        // Transform segments one by one instead of cloning the whole path.
+        let mut seg = [*seg];
+        if has_ts {
+            transform_path(&mut seg, ts);
+        }
+
+        match seg[0] {
               usvg::PathSegment::MoveTo { x, y }
             | usvg::PathSegment::LineTo { x, y } => {
                 let x = x as f32;
@@ -160,6 +227,170 @@ pub fn path_bbox(
     (minx as f64, miny as f64, width as f64, height as f64).into()
 }
 
+/// Returns a conservative distance the stroke can extend beyond the path outline.
+pub fn stroke_margin(stroke: &usvg::Stroke) -> f64 {
+    // Miter joins and square caps can go beyond the half of the stroke width.
+    let mut w = stroke.width / 2.0 * 2f64.sqrt();
+    if stroke.linejoin == usvg::LineJoin::Miter {
+        w *= stroke.miterlimit.max(1.0);
+    }
+
+    w
+}
+
+/// Calculates a conservative path bbox, including the stroke.
+///
+/// Unlike `path_bbox`, includes miter joins and square caps
+/// and scales the stroke width by `ts`.
+pub fn path_bounds(
+    segments: &[usvg::PathSegment],
+    stroke: Option<&usvg::Stroke>,
+    ts: &usvg::Transform,
+) -> Rect {
+    let r = path_bbox(segments, None, ts);
+    match stroke {
+        Some(stroke) => {
+            let (sx, sy) = ts.get_scale();
+            let w = stroke_margin(stroke) * sx.max(sy);
+            Rect::new(r.x - w, r.y - w, r.width + w * 2.0, r.height + w * 2.0)
+        }
+        None => r,
+    }
+}
+
+/// Conservative canvas space bounds of groups content.
+///
+/// Includes strokes and a one pixel margin for antialiasing.
+/// Bounds are `None` when they are unknown, like for text or SVG images.
+///
+/// Bounds of each group are memoized, so when they are requested from the root
+/// to the leaves, like during rendering, every node is visited only once.
+pub struct ContentBounds {
+    /// Bounds by the group address.
+    ///
+    /// Nodes are stored to keep the addresses valid.
+    d: HashMap<usize, (usvg::Node, usvg::Transform, Option<Rect>)>,
+}
+
+impl ContentBounds {
+    /// Creates an empty `ContentBounds`.
+    pub fn new() -> Self {
+        ContentBounds {
+            d: HashMap::new(),
+        }
+    }
+
+    /// Returns canvas space bounds of the `parent` children.
+    ///
+    /// `ts` is the `parent` canvas space transform.
+    pub fn get(&mut self, parent: &usvg::Node, ts: &usvg::Transform) -> Option<Rect> {
+        let key = &*parent.borrow() as *const usvg::NodeKind as usize;
+
+        if let Some(&(_, ref cached_ts, bounds)) = self.d.get(&key) {
+            // The same group can be rendered with a different transform,
+            // like a mask content.
+            if is_same_transform(cached_ts, ts) {
+                return bounds;
+            }
+        }
+
+        let bounds = self.calc(parent, ts);
+        self.d.insert(key, (parent.clone(), *ts, bounds));
+        bounds
+    }
+
+    /// Returns canvas space bounds of a single `parent` child.
+    ///
+    /// `ts` is the `parent` canvas space transform.
+    /// Returns an empty rect when the child draws nothing.
+    pub fn child(&mut self, node: &usvg::Node, ts: &usvg::Transform) -> Option<Rect> {
+        let mut node_ts = *ts;
+        node_ts.append(&node.transform());
+
+        let r = match *node.borrow() {
+            usvg::NodeKind::Path(ref path) => {
+                if path.segments.len() < 2 {
+                    return Some(Rect::new(0.0, 0.0, 0.0, 0.0));
+                }
+
+                path_bounds(&path.segments, path.stroke.as_ref(), &node_ts)
+            }
+            usvg::NodeKind::Image(ref img) => {
+                // SVG images are not clipped by the view box.
+                if img.format == usvg::ImageFormat::SVG {
+                    return None;
+                }
+
+                transform_rect(img.view_box.rect, &node_ts)
+            }
+            usvg::NodeKind::Group(_) => {
+                let r = self.get(node, &node_ts)?;
+                if r.width <= 0.0 {
+                    return Some(r);
+                }
+
+                r
+            }
+            usvg::NodeKind::Text(_) => return None,
+            _ => return Some(Rect::new(0.0, 0.0, 0.0, 0.0)),
+        };
+
+        Some(Rect::new(r.x - 1.0, r.y - 1.0, r.width + 2.0, r.height + 2.0))
+    }
+
+    fn calc(&mut self, parent: &usvg::Node, ts: &usvg::Transform) -> Option<Rect> {
+        let mut bounds = Rect::new_bbox();
+
+        for node in parent.children() {
+            let r = self.child(&node, ts)?;
+            if r.width > 0.0 {
+                bounds.expand(r);
+            }
+        }
+
+        if bounds.x == f64::MAX {
+            // Nothing is drawn.
+            return Some(Rect::new(0.0, 0.0, 0.0, 0.0));
+        }
+
+        Some(bounds)
+    }
+}
+
+/// Checks that transforms are equal up to the rounding errors.
+///
+/// The backends and `usvg` multiply matrices in a different order,
+/// so the same transform can differ in the last bits.
+fn is_same_transform(ts1: &usvg::Transform, ts2: &usvg::Transform) -> bool {
+    let eq = |a: f64, b: f64| (a - b).abs() <= 1e-9 * (1.0 + a.abs().max(b.abs()));
+
+    eq(ts1.a, ts2.a) && eq(ts1.b, ts2.b) && eq(ts1.c, ts2.c) &&
+    eq(ts1.d, ts2.d) && eq(ts1.e, ts2.e) && eq(ts1.f, ts2.f)
+}
+
+/// Returns a bbox of the transformed rect.
+pub fn transform_rect(r: Rect, ts: &usvg::Transform) -> Rect {
+    let points = [
+        ts.apply(r.x, r.y),
+        ts.apply(r.x + r.width, r.y),
+        ts.apply(r.x, r.y + r.height),
+        ts.apply(r.x + r.width, r.y + r.height),
+    ];
+
+    let mut x1 = points[0].0;
+    let mut y1 = points[0].1;
+    let mut x2 = x1;
+    let mut y2 = y1;
+    for &(x, y) in &points {
+        x1 = x1.min(x);
+        y1 = y1.min(y);
+        x2 = x2.max(x);
+        y2 = y2.max(y);
+    }
+
+    Rect::new(x1, y1, x2 - x1, y2 - y1)
+}
+
 /// Applies the transform to the path segments.
 pub fn transform_path(segments: &mut [usvg::PathSegment], ts: &usvg::Transform) {
     for seg in segments {
@@ -199,3 +430,366 @@ pub fn rect_to_path(rect: Rect) -> Vec<usvg::PathSegment> {
         usvg::PathSegment::ClosePath,
     ]
 }
+
+/// Returns a rect if the path is an axis-aligned rectangle.
+///
+/// Any corner order and direction is allowed, so the result is suitable
+/// only for filling and bbox calculation. Use `is_rect_path` to check that
+/// the path can be replaced by `rect_to_path` output for stroking.
+pub fn path_to_rect(segments: &[usvg::PathSegment]) -> Option<Rect> {
+    use usvg::PathSegment as Seg;
+
+    // 4 corners and an optional explicit closing point.
+    if segments.len() < 5 || segments.len() > 6 {
+        return None;
+    }
+
+    let mut points = [(0.0, 0.0); 5];
+    let mut len = 0;
+    for (i, seg) in segments.iter().enumerate() {
+        match *seg {
+            Seg::MoveTo { x, y } if i == 0 => {
+                points[len] = (x, y);
+                len += 1;
+            }
+            Seg::LineTo { x, y } if i != 0 && len < 5 => {
+                points[len] = (x, y);
+                len += 1;
+            }
+            Seg::ClosePath if i + 1 == segments.len() => {}
+            _ => return None,
+        }
+    }
+
+    if len == 5 && points[0] == points[4] {
+        len -= 1;
+    }
+
+    if len != 4 {
+        return None;
+    }
+
+    // Each edge must be either horizontal or vertical, alternating.
+    let horizontal_first = points[0].1 == points[1].1;
+    for i in 0..4 {
+        let (x1, y1) = points[i];
+        let (x2, y2) = points[(i + 1) % 4];
+        let is_horizontal = (i % 2 == 0) == horizontal_first;
+
+        if is_horizontal {
+            if y1 != y2 || x1 == x2 {
+                return None;
+            }
+        } else {
+            if x1 != x2 || y1 == y2 {
+                return None;
+            }
+        }
+    }
+
+    let mut x1 = points[0].0;
+    let mut y1 = points[0].1;
+    let mut x2 = x1;
+    let mut y2 = y1;
+    for &(x, y) in &points[1..4] {
+        x1 = x1.min(x);
+        y1 = y1.min(y);
+        x2 = x2.max(x);
+        y2 = y2.max(y);
+    }
+
+    Some(Rect::new(x1, y1, x2 - x1, y2 - y1))
+}
+
+/// Checks that segments are identical to the `rect_to_path` output.
+pub fn is_rect_path(segments: &[usvg::PathSegment], rect: Rect) -> bool {
+    segments.len() == 5 && segments == rect_to_path(rect).as_slice()
+}
+
+/// Creates a deep copy of the tree.
+///
+/// Much faster than parsing the same file again, since the tree is already preprocessed.
+pub fn clone_tree(tree: &usvg::Tree) -> usvg::Tree {
+    let mut new_tree = usvg::Tree::create(tree.svg_node().clone());
+
+    for node in tree.root().children() {
+        if let usvg::NodeKind::Defs = *node.borrow() {
+            // `Tree::create` creates its own `defs`.
+            for def in node.children() {
+                let mut new_def = new_tree.append_to_defs(def.borrow().clone());
+                clone_children(&def, &mut new_def);
+            }
+        } else {
+            let mut new_node = new_tree.root().append_kind(node.borrow().clone());
+            clone_children(&node, &mut new_node);
+        }
+    }
+
+    new_tree
+}
+
+fn clone_children(parent: &usvg::Node, new_parent: &mut usvg::Node) {
+    for node in parent.children() {
+        let mut new_node = new_parent.append_kind(node.borrow().clone());
+        clone_children(&node, &mut new_node);
+    }
+}
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn tree(width: f64, height: f64, view_box: Rect, align: usvg::Align) -> usvg::Tree {
+        usvg::Tree::create(usvg::Svg {
+            size: Size::new(width, height),
+            view_box: usvg::ViewBox {
+                rect: view_box,
+                aspect: usvg::AspectRatio { defer: false, align, slice: false },
+            },
+        })
+    }
+
+    fn rect_tuple(r: Rect) -> (f64, f64, f64, f64) {
+        (r.x, r.y, r.width, r.height)
+    }
+
+    fn screen_rect_tuple(r: Option<ScreenRect>) -> Option<(u32, u32, u32, u32)> {
+        r.map(|r| (r.x, r.y, r.width, r.height))
+    }
+
+    fn stroke(width: f64, linejoin: usvg::LineJoin) -> usvg::Stroke {
+        usvg::Stroke {
+            width,
+            linejoin,
+            miterlimit: 4.0,
+            .. usvg::Stroke::default()
+        }
+    }
+
+    /// Checks that rendering of the region maps the `viewBox` into the region origin
+    /// using the full image scale.
+    fn check_region(tree: &usvg::Tree, region: ScreenRect, fit: FitTo) {
+        let (_, full_ts) = root_transform(tree, fit);
+        let vb = region_view_box(tree, region, fit);
+        let ts = view_box_to_transform(vb.rect, vb.aspect,
+                                       Size::new(region.width as f64, region.height as f64));
+
+        assert_eq!((ts.a, ts.d), (full_ts.a, full_ts.d));
+
+        let (x, y) = full_ts.apply(vb.rect.x, vb.rect.y);
+        assert_eq!((x, y), (region.x as f64, region.y as f64));
+        assert_eq!(ts.apply(vb.rect.x, vb.rect.y), (0.0, 0.0));
+    }
+
+    #[test]
+    fn full_region_view_box() {
+        let tree = tree(200.0, 100.0, Rect::new(0.0, 0.0, 100.0, 50.0), usvg::Align::XMidYMid);
+        let vb = region_view_box(&tree, ScreenRect::new(0, 0, 200, 100), FitTo::Original);
+        assert_eq!(rect_tuple(vb.rect), (0.0, 0.0, 100.0, 50.0));
+        assert_eq!(vb.aspect.align, usvg::Align::None);
+    }
+
+    #[test]
+    fn partial_region_view_box() {
+        let tree = tree(200.0, 100.0, Rect::new(0.0, 0.0, 100.0, 50.0), usvg::Align::XMidYMid);
+        let region = ScreenRect::new(20, 10, 40, 30);
+        let vb = region_view_box(&tree, region, FitTo::Original);
+        assert_eq!(rect_tuple(vb.rect), (10.0, 5.0, 20.0, 15.0));
+        check_region(&tree, region, FitTo::Original);
+    }
+
+    #[test]
+    fn region_view_box_with_aspect() {
+        // The `viewBox` is centered horizontally.
+        let tree = tree(200.0, 100.0, Rect::new(0.0, 0.0, 50.0, 50.0), usvg::Align::XMidYMid);
+        let vb = region_view_box(&tree, ScreenRect::new(50, 0, 100, 100), FitTo::Original);
+        assert_eq!(rect_tuple(vb.rect), (0.0, 0.0, 50.0, 50.0));
+
+        // Regions can include the area outside the `viewBox`.
+        let region = ScreenRect::new(0, 0, 60, 40);
+        let vb = region_view_box(&tree, region, FitTo::Original);
+        assert_eq!(rect_tuple(vb.rect), (-25.0, 0.0, 30.0, 20.0));
+        check_region(&tree, region, FitTo::Original);
+    }
+
+    #[test]
+    fn region_view_box_with_zoom() {
+        let tree = tree(100.0, 50.0, Rect::new(10.0, 10.0, 100.0, 50.0), usvg::Align::None);
+        let region = ScreenRect::new(100, 20, 50, 40);
+        let vb = region_view_box(&tree, region, FitTo::Zoom(2.0));
+        assert_eq!(rect_tuple(vb.rect), (60.0, 20.0, 25.0, 20.0));
+        check_region(&tree, region, FitTo::Zoom(2.0));
+    }
+
+    #[test]
+    fn trim_region_rounding() {
+        let tree = tree(200.0, 100.0, Rect::new(0.0, 0.0, 100.0, 50.0), usvg::Align::XMidYMid);
+
+        let r = trim_region(&tree, Rect::new(10.0, 5.0, 20.0, 15.0), FitTo::Original);
+        assert_eq!(screen_rect_tuple(r), Some((20, 10, 40, 30)));
+
+        // Rounded outwards.
+        let r = trim_region(&tree, Rect::new(10.1, 5.1, 19.8, 14.8), FitTo::Original);
+        assert_eq!(screen_rect_tuple(r), Some((20, 10, 40, 30)));
+
+        // Clipped by the image.
+        let r = trim_region(&tree, Rect::new(-10.0, 40.0, 30.0, 30.0), FitTo::Original);
+        assert_eq!(screen_rect_tuple(r), Some((0, 80, 40, 20)));
+
+        // Outside.
+        let r = trim_region(&tree, Rect::new(200.0, 0.0, 10.0, 10.0), FitTo::Original);
+        assert_eq!(screen_rect_tuple(r), None);
+    }
+
+    #[test]
+    fn trim_region_with_fit() {
+        let tree = tree(200.0, 100.0, Rect::new(0.0, 0.0, 100.0, 50.0), usvg::Align::XMidYMid);
+        let r = trim_region(&tree, Rect::new(10.0, 5.0, 20.0, 15.0), FitTo::Width(400));
+        assert_eq!(screen_rect_tuple(r), Some((40, 20, 80, 60)));
+    }
+
+    #[test]
+    fn path_bounds_without_stroke() {
+        let segments = rect_to_path(Rect::new(10.0, 20.0, 30.0, 40.0));
+        let r = path_bounds(&segments, None, &usvg::Transform::default());
+        assert_eq!(rect_tuple(r), (10.0, 20.0, 30.0, 40.0));
+    }
+
+    #[test]
+    fn path_bounds_with_miter_join() {
+        let segments = rect_to_path(Rect::new(10.0, 20.0, 30.0, 40.0));
+        let s = stroke(2.0, usvg::LineJoin::Miter);
+        let r = path_bounds(&segments, Some(&s), &usvg::Transform::default());
+
+        // The half of the stroke width * sqrt(2) * miterlimit.
+        let w = 2f64.sqrt() * 4.0;
+        assert_eq!(rect_tuple(r), (10.0 - w, 20.0 - w, 30.0 + w * 2.0, 40.0 + w * 2.0));
+
+        // Always covers the exact stroke bbox.
+        let exact = path_bbox(&segments, Some(&s), &usvg::Transform::default());
+        assert!(r.x <= exact.x && r.y <= exact.y);
+        assert!(r.right() >= exact.right() && r.bottom() >= exact.bottom());
+    }
+
+    #[test]
+    fn path_bounds_with_scaled_stroke() {
+        let segments = rect_to_path(Rect::new(10.0, 20.0, 30.0, 40.0));
+        let s = stroke(2.0, usvg::LineJoin::Round);
+        let r = path_bounds(&segments, Some(&s), &usvg::Transform::new(2.0, 0.0, 0.0, 3.0, 0.0, 0.0));
+
+        // The stroke is scaled by the largest scale factor.
+        let w = 2f64.sqrt() * 3.0;
+        assert_eq!(rect_tuple(r), (20.0 - w, 60.0 - w, 60.0 + w * 2.0, 120.0 + w * 2.0));
+    }
+
+    fn group(ts: usvg::Transform) -> usvg::NodeKind {
+        usvg::NodeKind::Group(usvg::Group {
+            id: String::new(),
+            transform: ts,
+            opacity: None,
+            clip_path: None,
+            mask: None,
+        })
+    }
+
+    fn rect_node(r: Rect) -> usvg::NodeKind {
+        usvg::NodeKind::Path(usvg::Path {
+            id: String::new(),
+            transform: usvg::Transform::default(),
+            fill: Some(usvg::Fill::default()),
+            stroke: None,
+            segments: rect_to_path(r),
+        })
+    }
+
+    fn translate(x: f64, y: f64) -> usvg::Transform {
+        usvg::Transform::new(1.0, 0.0, 0.0, 1.0, x, y)
+    }
+
+    #[test]
+    fn content_bounds_nested() {
+        let tree = tree(100.0, 100.0, Rect::new(0.0, 0.0, 100.0, 100.0), usvg::Align::None);
+        let mut g = tree.root().append_kind(group(translate(10.0, 0.0)));
+        g.append_kind(rect_node(Rect::new(0.0, 0.0, 10.0, 10.0)));
+        tree.root().append_kind(rect_node(Rect::new(50.0, 50.0, 10.0, 10.0)));
+
+        // Each level adds a one pixel margin.
+        let mut bounds = ContentBounds::new();
+        let r = bounds.get(&tree.root(), &usvg::Transform::default()).unwrap();
+        assert_eq!(rect_tuple(r), (8.0, -2.0, 53.0, 63.0));
+
+        let r = bounds.get(&g, &translate(10.0, 0.0)).unwrap();
+        assert_eq!(rect_tuple(r), (9.0, -1.0, 12.0, 12.0));
+    }
+
+    #[test]
+    fn content_bounds_child() {
+        let tree = tree(100.0, 100.0, Rect::new(0.0, 0.0, 100.0, 100.0), usvg::Align::None);
+        let mut g = tree.root().append_kind(group(translate(10.0, 0.0)));
+        g.append_kind(rect_node(Rect::new(0.0, 0.0, 10.0, 10.0)));
+        let path = tree.root().append_kind(rect_node(Rect::new(50.0, 50.0, 10.0, 10.0)));
+        let empty = tree.root().append_kind(group(usvg::Transform::default()));
+
+        let mut bounds = ContentBounds::new();
+        let ts = usvg::Transform::default();
+        assert_eq!(rect_tuple(bounds.child(&g, &ts).unwrap()), (8.0, -2.0, 14.0, 14.0));
+        assert_eq!(rect_tuple(bounds.child(&path, &ts).unwrap()), (49.0, 49.0, 12.0, 12.0));
+        assert_eq!(rect_tuple(bounds.child(&empty, &ts).unwrap()), (0.0, 0.0, 0.0, 0.0));
+    }
+
+    #[test]
+    fn content_bounds_memoized() {
+        let tree = tree(100.0, 100.0, Rect::new(0.0, 0.0, 100.0, 100.0), usvg::Align::None);
+        let mut g = tree.root().append_kind(group(usvg::Transform::default()));
+        let mut path = g.append_kind(rect_node(Rect::new(0.0, 0.0, 10.0, 10.0)));
+
+        let mut bounds = ContentBounds::new();
+        bounds.get(&tree.root(), &usvg::Transform::default());
+
+        // Change the content to check that the group bounds are not recalculated.
+        if let usvg::NodeKind::Path(ref mut p) = *path.borrow_mut() {
+            p.segments = rect_to_path(Rect::new(0.0, 0.0, 20.0, 20.0));
+        }
+
+        let r = bounds.get(&g, &translate(1e-12, 0.0)).unwrap();
+        assert_eq!(rect_tuple(r), (-1.0, -1.0, 12.0, 12.0));
+
+        // A different transform.
+        let r = bounds.get(&g, &translate(5.0, 0.0)).unwrap();
+        assert_eq!(rect_tuple(r), (4.0, -1.0, 22.0, 22.0));
+    }
+
+    #[test]
+    fn content_bounds_empty() {
+        let tree = tree(100.0, 100.0, Rect::new(0.0, 0.0, 100.0, 100.0), usvg::Align::None);
+        let mut g = tree.root().append_kind(group(usvg::Transform::default()));
+        g.append_kind(group(usvg::Transform::default()));
+
+        let mut bounds = ContentBounds::new();
+        let r = bounds.get(&g, &usvg::Transform::default()).unwrap();
+        assert_eq!(rect_tuple(r), (0.0, 0.0, 0.0, 0.0));
+    }
+
+    #[test]
+    fn content_bounds_unknown() {
+        let tree = tree(100.0, 100.0, Rect::new(0.0, 0.0, 100.0, 100.0), usvg::Align::None);
+        let mut g = tree.root().append_kind(group(usvg::Transform::default()));
+        g.append_kind(usvg::NodeKind::Image(usvg::Image {
+            id: String::new(),
+            transform: usvg::Transform::default(),
+            view_box: usvg::ViewBox {
+                rect: Rect::new(0.0, 0.0, 10.0, 10.0),
+                aspect: usvg::AspectRatio::default(),
+            },
+            data: usvg::ImageData::Raw(Vec::new()),
+            format: usvg::ImageFormat::SVG,
+        }));
+        tree.root().append_kind(rect_node(Rect::new(50.0, 50.0, 10.0, 10.0)));
+
+        // SVG images are not clipped, so the parents bounds are unknown too.
+        let mut bounds = ContentBounds::new();
+        assert!(bounds.get(&tree.root(), &usvg::Transform::default()).is_none());
+        assert!(bounds.get(&g, &usvg::Transform::default()).is_none());
+    }
+}
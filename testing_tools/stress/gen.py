@@ -0,0 +1,181 @@
+#!/usr/bin/env python3.6
+
+# Generates synthetic SVG documents that stress a single dimension.
+#
+# Usage:
+#   ./gen.py nodes 1000 out.svg
+#   ./gen.py depth 64 out.svg
+
+import argparse
+import base64
+import math
+import random
+import struct
+import zlib
+
+
+SIZE = 1000
+# Keep documents reproducible.
+SEED = 42
+
+
+def svg(content, defs=''):
+    if defs:
+        defs = '<defs>\n{}</defs>\n'.format(defs)
+
+    return ('<svg xmlns="http://www.w3.org/2000/svg" '
+            'xmlns:xlink="http://www.w3.org/1999/xlink" '
+            'width="{0}" height="{0}" viewBox="0 0 {0} {0}">\n{1}{2}</svg>\n'
+            .format(SIZE, defs, content))
+
+
+def grid_cell(idx, count):
+    cols = max(1, math.ceil(math.sqrt(count)))
+    cell = SIZE / cols
+    return (idx % cols) * cell, (idx // cols) * cell, cell
+
+
+def color(rnd):
+    return '#{:06x}'.format(rnd.randrange(0x1000000))
+
+
+def gen_nodes(n, rnd):
+    content = ''
+    for i in range(n):
+        x, y, cell = grid_cell(i, n)
+        content += '<rect x="{:.3f}" y="{:.3f}" width="{:.3f}" height="{:.3f}" fill="{}"/>\n' \
+                   .format(x, y, cell * 0.8, cell * 0.8, color(rnd))
+    return svg(content)
+
+
+def gen_depth(n, rnd):
+    # Group opacity prevents group removal, so each level requires a separate layer.
+    content = '<g opacity="0.99">\n' * n
+    content += '<rect x="100" y="100" width="800" height="800" fill="{}"/>\n'.format(color(rnd))
+    content += '</g>\n' * n
+    return svg(content)
+
+
+def gen_masks(n, rnd):
+    defs = ''
+    content = ''
+    for i in range(n):
+        x, y, cell = grid_cell(i, n)
+        defs += ('<mask id="mask{0}">\n'
+                 '  <circle cx="{1:.3f}" cy="{2:.3f}" r="{3:.3f}" fill="white"/>\n'
+                 '</mask>\n').format(i, x + cell / 2, y + cell / 2, cell / 2)
+        content += '<g mask="url(#mask{})"><rect x="{:.3f}" y="{:.3f}" width="{:.3f}" ' \
+                   'height="{:.3f}" fill="{}"/></g>\n'.format(i, x, y, cell, cell, color(rnd))
+    return svg(content, defs)
+
+
+def gen_clips(n, rnd):
+    defs = ''
+    content = ''
+    for i in range(n):
+        x, y, cell = grid_cell(i, n)
+        defs += ('<clipPath id="clip{0}">\n'
+                 '  <circle cx="{1:.3f}" cy="{2:.3f}" r="{3:.3f}"/>\n'
+                 '</clipPath>\n').format(i, x + cell / 2, y + cell / 2, cell / 2)
+        content += '<g clip-path="url(#clip{})"><rect x="{:.3f}" y="{:.3f}" width="{:.3f}" ' \
+                   'height="{:.3f}" fill="{}"/></g>\n'.format(i, x, y, cell, cell, color(rnd))
+    return svg(content, defs)
+
+
+def gen_patterns(n, rnd):
+    defs = ''
+    content = ''
+    for i in range(n):
+        x, y, cell = grid_cell(i, n)
+        defs += ('<pattern id="patt{0}" patternUnits="userSpaceOnUse" width="20" height="20">\n'
+                 '  <rect width="10" height="10" fill="{1}"/>\n'
+                 '</pattern>\n').format(i, color(rnd))
+        content += '<rect x="{:.3f}" y="{:.3f}" width="{:.3f}" height="{:.3f}" ' \
+                   'fill="url(#patt{})"/>\n'.format(x, y, cell, cell, i)
+    return svg(content, defs)
+
+
+def gen_segments(n, rnd):
+    d = 'M 500 500'
+    for i in range(n):
+        x = rnd.uniform(0, SIZE)
+        y = rnd.uniform(0, SIZE)
+        if i % 2 == 0:
+            d += ' L {:.3f} {:.3f}'.format(x, y)
+        else:
+            d += ' C {:.3f} {:.3f} {:.3f} {:.3f} {:.3f} {:.3f}'.format(
+                rnd.uniform(0, SIZE), rnd.uniform(0, SIZE),
+                rnd.uniform(0, SIZE), rnd.uniform(0, SIZE), x, y)
+    content = '<path d="{} Z" fill="{}" stroke="black" fill-rule="evenodd"/>\n' \
+              .format(d, color(rnd))
+    return svg(content)
+
+
+def gen_text(n, rnd):
+    # Every glyph has its own position and rotation,
+    # so each one becomes a separate text block.
+    letters = 'abcdefghijklmnopqrstuvwxyz'
+    text = ''.join(rnd.choice(letters) for _ in range(n))
+    cols = max(1, math.ceil(math.sqrt(n)))
+    step = SIZE / cols
+    xs = ' '.join('{:.2f}'.format((i % cols) * step) for i in range(n))
+    ys = ' '.join('{:.2f}'.format((i // cols + 1) * step) for i in range(n))
+    rotate = ' '.join(str(rnd.randrange(360)) for _ in range(n))
+    content = '<text x="{}" y="{}" rotate="{}" font-size="{:.2f}">{}</text>\n' \
+              .format(xs, ys, rotate, step, text)
+    return svg(content)
+
+
+def png_data(width, height, rnd):
+    def chunk(kind, data):
+        body = kind + data
+        return struct.pack('>I', len(data)) + body + struct.pack('>I', zlib.crc32(body))
+
+    row = bytes(rnd.randrange(256) for _ in range(width * 3))
+    raw = b''.join(b'\x00' + row for _ in range(height))
+    header = struct.pack('>IIBBBBB', width, height, 8, 2, 0, 0, 0)
+    return (b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', header) +
+            chunk(b'IDAT', zlib.compress(raw)) + chunk(b'IEND', b''))
+
+
+def gen_images(n, rnd, image_size=64):
+    content = ''
+    for i in range(n):
+        x, y, cell = grid_cell(i, n)
+        data = base64.b64encode(png_data(image_size, image_size, rnd)).decode('ascii')
+        content += '<image x="{:.3f}" y="{:.3f}" width="{:.3f}" height="{:.3f}" ' \
+                   'xlink:href="data:image/png;base64,{}"/>\n'.format(x, y, cell, cell, data)
+    return svg(content)
+
+
+def gen_image_size(n, rnd):
+    return gen_images(1, rnd, image_size=n)
+
+
+GENERATORS = {
+    'nodes': gen_nodes,
+    'depth': gen_depth,
+    'masks': gen_masks,
+    'clips': gen_clips,
+    'patterns': gen_patterns,
+    'segments': gen_segments,
+    'text': gen_text,
+    'images': gen_images,
+    'image-size': gen_image_size,
+}
+
+
+def generate(dimension, n):
+    return GENERATORS[dimension](n, random.Random(SEED))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('dimension', choices=sorted(GENERATORS.keys()),
+                        help='Sets the stressed dimension')
+    parser.add_argument('n', type=int, help='Sets the dimension size')
+    parser.add_argument('out_svg', help='Sets the output file')
+    args = parser.parse_args()
+
+    with open(args.out_svg, 'w') as f:
+        f.write(generate(args.dimension, args.n))
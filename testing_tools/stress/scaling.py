@@ -0,0 +1,111 @@
+#!/usr/bin/env python3.6
+
+# Times rendersvg on synthetic documents and reports the fitted complexity
+# of each dimension, which helps to find superlinear behaviour.
+#
+# Usage:
+#   ./scaling.py --backend cairo /tmp/stress
+#   ./scaling.py --backend qt --dimension depth --dimension text /tmp/stress
+
+import argparse
+import math
+import os
+import re
+import subprocess as proc
+from subprocess import run
+from pathlib import Path
+
+import gen
+
+
+SWEEPS = {
+    'nodes': [250, 500, 1000, 2000, 4000],
+    'depth': [8, 16, 32, 64, 128],
+    'masks': [25, 50, 100, 200, 400],
+    'clips': [25, 50, 100, 200, 400],
+    'patterns': [25, 50, 100, 200, 400],
+    'segments': [1000, 2000, 4000, 8000, 16000],
+    'text': [100, 200, 400, 800, 1600],
+    'images': [10, 20, 40, 80, 160],
+    'image-size': [64, 128, 256, 512, 1024],
+}
+
+# An exponent above this value is reported as superlinear.
+SUPERLINEAR = 1.3
+
+
+def render(in_svg, out_png):
+    out = run([render_path, '--backend', args.backend, '--perf', '--quiet', in_svg, out_png],
+              check=True, stdout=proc.PIPE).stdout.decode('utf-8')
+
+    timings = {}
+    for line in out.splitlines():
+        m = re.match(r'(.+): ([0-9.]+)ms', line)
+        if m:
+            timings[m.group(1)] = float(m.group(2))
+    return timings
+
+
+def measure(in_svg, out_png):
+    # Use the best run to reduce noise.
+    best = None
+    for _ in range(args.runs):
+        t = render(in_svg, out_png)
+        total = t.get('Preprocessing', 0) + t.get('Rendering', 0)
+        if best is None or total < best:
+            best = total
+    return best
+
+
+def fit_exponent(points):
+    # Least squares fit of log(time) = k * log(n) + b.
+    points = [(math.log(n), math.log(t)) for n, t in points if t > 0]
+    if len(points) < 2:
+        return None
+
+    mean_x = sum(x for x, _ in points) / len(points)
+    mean_y = sum(y for _, y in points) / len(points)
+    num = sum((x - mean_x) * (y - mean_y) for x, y in points)
+    den = sum((x - mean_x) ** 2 for x, _ in points)
+    return num / den if den else None
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--backend', help='Sets resvg backend', choices=['qt', 'cairo'],
+                        default='cairo')
+    parser.add_argument('--dimension', help='Tests only the selected dimension',
+                        choices=sorted(SWEEPS.keys()), action='append')
+    parser.add_argument('--runs', help='Sets the number of runs per document',
+                        type=int, default=3)
+    parser.add_argument('work_dir', type=Path, help='Sets working directory')
+    args = parser.parse_args()
+
+    render_path = Path(__file__).resolve().parent / '../../target/release/rendersvg'
+    if not render_path.exists():
+        raise RuntimeError('rendersvg executable not found')
+
+    if not args.work_dir.exists():
+        os.mkdir(args.work_dir)
+
+    dimensions = args.dimension or sorted(SWEEPS.keys())
+    for dim in dimensions:
+        points = []
+        for n in SWEEPS[dim]:
+            svg_path = args.work_dir / '{}-{}.svg'.format(dim, n)
+            png_path = args.work_dir / '{}-{}.png'.format(dim, n)
+
+            with open(svg_path, 'w') as f:
+                f.write(gen.generate(dim, n))
+
+            t = measure(svg_path, png_path)
+            points.append((n, t))
+            print('{:>10} {:>6}: {:.2f}ms'.format(dim, n, t))
+
+        k = fit_exponent(points)
+        if k is None:
+            print('{:>10}: not enough data'.format(dim))
+        else:
+            note = ' superlinear' if k > SUPERLINEAR else ''
+            print('{:>10}: O(n^{:.2f}){}'.format(dim, k, note))
+        print()
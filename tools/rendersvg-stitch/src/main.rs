@@ -0,0 +1,462 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+extern crate deflate;
+extern crate png;
+
+
+use std::fs;
+use std::io::{
+    self,
+    BufRead,
+    BufWriter,
+    Write,
+};
+use std::path;
+
+
+const MANIFEST_HEADER: &'static str = "rendersvg-tiles 1";
+
+/// IDAT chunks size.
+const CHUNK_SIZE: usize = 256 * 1024;
+
+
+macro_rules! bail {
+    ($msg:expr) => {
+        return Err(format!("{}", $msg));
+    };
+    ($fmt:expr, $($arg:tt)*) => {
+        return Err(format!($fmt, $($arg)*));
+    };
+}
+
+
+struct Tile {
+    x: u32,
+    y: u32,
+    width: u32,
+    height: u32,
+    path: path::PathBuf,
+}
+
+
+fn main() {
+    if let Err(e) = process() {
+        eprintln!("Error: {}.", e);
+        std::process::exit(1);
+    }
+}
+
+fn process() -> Result<(), String> {
+    let args: Vec<String> = std::env::args().collect();
+    if args.len() != 3 {
+        println!("\
+Assembles an image from tiles rendered by rendersvg --tile-grid.
+
+USAGE:
+    rendersvg-stitch <tiles-dir> <out-png>
+
+    <out-png> can be '-' to write to stdout.");
+        bail!("<tiles-dir> and <out-png> must be set");
+    }
+
+    let dir = path::Path::new(&args[1]);
+    let (width, height, tiles) = load_manifests(dir)?;
+    let bands = split_bands(width, height, tiles)?;
+
+    if args[2] == "-" {
+        let stdout = io::stdout();
+        let out = stdout.lock();
+        write_png(width, height, &bands, out)
+    } else {
+        let out = fs::File::create(&args[2])
+            .map_err(|e| format!("failed to create {:?}: {}", args[2], e))?;
+        write_png(width, height, &bands, out)
+    }
+}
+
+/// Loads all manifests from the directory.
+fn load_manifests(dir: &path::Path) -> Result<(u32, u32, Vec<Tile>), String> {
+    let entries = fs::read_dir(dir).map_err(|e| format!("failed to read {:?}: {}", dir, e))?;
+
+    let mut size = None;
+    let mut tiles = Vec::new();
+    for entry in entries {
+        let path = entry.map_err(|e| e.to_string())?.path();
+        if path.extension().and_then(|s| s.to_str()) != Some("manifest") {
+            continue;
+        }
+
+        let (w, h) = parse_manifest(&path, dir, &mut tiles)?;
+        match size {
+            Some(s) if s != (w, h) => bail!("{:?} has a different image size", path),
+            _ => size = Some((w, h)),
+        }
+    }
+
+    match size {
+        Some((w, h)) => Ok((w, h, tiles)),
+        None => bail!("{:?} has no manifests", dir),
+    }
+}
+
+fn parse_manifest(
+    path: &path::Path,
+    dir: &path::Path,
+    tiles: &mut Vec<Tile>,
+) -> Result<(u32, u32), String> {
+    let file = fs::File::open(path).map_err(|e| format!("failed to open {:?}: {}", path, e))?;
+
+    let mut size = None;
+    for (i, line) in io::BufReader::new(file).lines().enumerate() {
+        let line = line.map_err(|e| format!("failed to read {:?}: {}", path, e))?;
+        let invalid = || format!("{:?}:{}: invalid line", path, i + 1);
+
+        if i == 0 {
+            if line != MANIFEST_HEADER {
+                bail!("{:?} is not a tiles manifest", path);
+            }
+
+            continue;
+        }
+
+        let items: Vec<&str> = line.split(' ').collect();
+        let nums: Vec<u32> = items.iter().skip(1).filter_map(|n| n.parse().ok()).collect();
+        match items[0] {
+            "image" if items.len() == 3 && nums.len() == 2 => {
+                size = Some((nums[0], nums[1]));
+            }
+            "tile" if items.len() == 6 && nums.len() == 4 => {
+                tiles.push(Tile {
+                    x: nums[0],
+                    y: nums[1],
+                    width: nums[2],
+                    height: nums[3],
+                    path: dir.join(items[5]),
+                });
+            }
+            "" => {}
+            _ => return Err(invalid()),
+        }
+    }
+
+    size.ok_or_else(|| format!("{:?} has no image size", path))
+}
+
+/// Splits tiles into rows, checking that they cover the whole image once.
+fn split_bands(width: u32, height: u32, mut tiles: Vec<Tile>) -> Result<Vec<Vec<Tile>>, String> {
+    tiles.sort_by_key(|t| (t.y, t.x));
+
+    let mut bands: Vec<Vec<Tile>> = Vec::new();
+    for tile in tiles {
+        let is_new_band = match bands.last() {
+            Some(band) => band[0].y != tile.y,
+            None => true,
+        };
+
+        if is_new_band {
+            bands.push(vec![tile]);
+        } else {
+            bands.last_mut().unwrap().push(tile);
+        }
+    }
+
+    let mut y = 0;
+    for band in &bands {
+        let h = band[0].height;
+        if band[0].y != y {
+            bail!("tiles at y={} are missing", y);
+        }
+
+        let mut x = 0;
+        for tile in band {
+            if tile.x != x || tile.height != h {
+                bail!("tiles at {},{} are missing or overlap", x, y);
+            }
+
+            x += tile.width;
+        }
+
+        if x != width {
+            bail!("tiles at {},{} are missing", x, y);
+        }
+
+        y += h;
+    }
+
+    if y != height {
+        bail!("tiles at y={} are missing", y);
+    }
+
+    Ok(bands)
+}
+
+/// Writes a PNG image row by row.
+///
+/// Only a single band of tiles is decoded at a time, so the image
+/// can be much bigger than the available memory.
+fn write_png<W: Write>(width: u32, height: u32, bands: &[Vec<Tile>], out: W) -> Result<(), String> {
+    let out = BufWriter::new(out);
+    let mut chunks = ChunkWriter::new(out);
+    chunks.write_signature(width, height).map_err(|e| e.to_string())?;
+
+    let mut encoder = deflate::write::ZlibEncoder::new(chunks, deflate::Compression::Default);
+
+    let row_len = width as usize * 4;
+    let mut row = Vec::with_capacity(row_len + 1);
+    for band in bands {
+        let mut images = Vec::with_capacity(band.len());
+        for tile in band {
+            images.push(load_tile(tile)?);
+        }
+
+        for y in 0..band[0].height as usize {
+            row.clear();
+            // No filtering.
+            row.push(0);
+
+            for (tile, data) in band.iter().zip(images.iter()) {
+                let len = tile.width as usize * 4;
+                row.extend_from_slice(&data[y * len..(y + 1) * len]);
+            }
+
+            encoder.write_all(&row).map_err(|e| e.to_string())?;
+        }
+    }
+
+    let chunks = encoder.finish().map_err(|e| e.to_string())?;
+    chunks.finish().map_err(|e| e.to_string())?;
+
+    Ok(())
+}
+
+/// Loads a tile as RGBA8.
+fn load_tile(tile: &Tile) -> Result<Vec<u8>, String> {
+    let file = fs::File::open(&tile.path)
+        .map_err(|e| format!("failed to open {:?}: {}", tile.path, e))?;
+
+    let decoder = png::Decoder::new(file);
+    let (info, mut reader) = decoder.read_info()
+        .map_err(|e| format!("failed to decode {:?}: {}", tile.path, e))?;
+
+    if info.width != tile.width || info.height != tile.height {
+        bail!("{:?} has an unexpected size", tile.path);
+    }
+
+    if info.bit_depth != png::BitDepth::Eight {
+        bail!("{:?} has an unsupported bit depth", tile.path);
+    }
+
+    let mut data = vec![0; info.buffer_size()];
+    reader.next_frame(&mut data)
+        .map_err(|e| format!("failed to decode {:?}: {}", tile.path, e))?;
+
+    match info.color_type {
+        png::ColorType::RGBA => Ok(data),
+        png::ColorType::RGB => {
+            let mut rgba = Vec::with_capacity(data.len() / 3 * 4);
+            for p in data.chunks(3) {
+                rgba.extend_from_slice(p);
+                rgba.push(255);
+            }
+
+            Ok(rgba)
+        }
+        _ => bail!("{:?} has an unsupported color type", tile.path),
+    }
+}
+
+
+/// Splits the compressed stream into PNG chunks.
+struct ChunkWriter<W: Write> {
+    out: W,
+    buf: Vec<u8>,
+    crc_table: [u32; 256],
+}
+
+impl<W: Write> ChunkWriter<W> {
+    fn new(out: W) -> Self {
+        let mut crc_table = [0; 256];
+        for (n, v) in crc_table.iter_mut().enumerate() {
+            let mut c = n as u32;
+            for _ in 0..8 {
+                c = if c & 1 != 0 { 0xedb88320 ^ (c >> 1) } else { c >> 1 };
+            }
+            *v = c;
+        }
+
+        ChunkWriter {
+            out,
+            buf: Vec::with_capacity(CHUNK_SIZE),
+            crc_table,
+        }
+    }
+
+    fn write_signature(&mut self, width: u32, height: u32) -> io::Result<()> {
+        self.out.write_all(&[0x89, b'P', b'N', b'G', b'\r', b'\n', 0x1a, b'\n'])?;
+
+        let mut ihdr = Vec::with_capacity(13);
+        ihdr.extend_from_slice(&be_bytes(width));
+        ihdr.extend_from_slice(&be_bytes(height));
+        // 8 bit RGBA, deflate, adaptive filtering, no interlace.
+        ihdr.extend_from_slice(&[8, 6, 0, 0, 0]);
+        self.write_chunk(b"IHDR", &ihdr)
+    }
+
+    fn write_chunk(&mut self, kind: &[u8; 4], data: &[u8]) -> io::Result<()> {
+        let mut crc = !0u32;
+        for &b in kind.iter().chain(data) {
+            crc = self.crc_table[((crc ^ b as u32) & 0xff) as usize] ^ (crc >> 8);
+        }
+
+        self.out.write_all(&be_bytes(data.len() as u32))?;
+        self.out.write_all(kind)?;
+        self.out.write_all(data)?;
+        self.out.write_all(&be_bytes(!crc))
+    }
+
+    fn flush_buf(&mut self) -> io::Result<()> {
+        if !self.buf.is_empty() {
+            let buf = ::std::mem::replace(&mut self.buf, Vec::new());
+            self.write_chunk(b"IDAT", &buf)?;
+            self.buf = buf;
+            self.buf.clear();
+        }
+
+        Ok(())
+    }
+
+    fn finish(mut self) -> io::Result<()> {
+        self.flush_buf()?;
+        self.write_chunk(b"IEND", &[])?;
+        self.out.flush()
+    }
+}
+
+impl<W: Write> Write for ChunkWriter<W> {
+    fn write(&mut self, data: &[u8]) -> io::Result<usize> {
+        let len = (CHUNK_SIZE - self.buf.len()).min(data.len());
+        self.buf.extend_from_slice(&data[..len]);
+
+        if self.buf.len() == CHUNK_SIZE {
+            self.flush_buf()?;
+        }
+
+        Ok(len)
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+}
+
+fn be_bytes(n: u32) -> [u8; 4] {
+    [(n >> 24) as u8, (n >> 16) as u8, (n >> 8) as u8, n as u8]
+}
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn tile(x: u32, y: u32, width: u32, height: u32) -> Tile {
+        Tile { x, y, width, height, path: path::PathBuf::new() }
+    }
+
+    fn grid(tiles: Vec<Tile>) -> Result<Vec<Vec<(u32, u32)>>, String> {
+        let bands = split_bands(100, 60, tiles)?;
+        Ok(bands.iter().map(|band| band.iter().map(|t| (t.x, t.y)).collect()).collect())
+    }
+
+    #[test]
+    fn sorted_bands() {
+        let tiles = vec![
+            tile(50, 30, 50, 30),
+            tile(0, 0, 50, 30),
+            tile(0, 30, 50, 30),
+            tile(50, 0, 50, 30),
+        ];
+
+        assert_eq!(grid(tiles).unwrap(), vec![
+            vec![(0, 0), (50, 0)],
+            vec![(0, 30), (50, 30)],
+        ]);
+    }
+
+    #[test]
+    fn uneven_tiles() {
+        // The last row and column can be smaller.
+        let tiles = vec![
+            tile(0, 0, 70, 40),
+            tile(70, 0, 30, 40),
+            tile(0, 40, 70, 20),
+            tile(70, 40, 30, 20),
+        ];
+
+        assert_eq!(grid(tiles).unwrap(), vec![
+            vec![(0, 0), (70, 0)],
+            vec![(0, 40), (70, 40)],
+        ]);
+    }
+
+    #[test]
+    fn missing_tile() {
+        let tiles = vec![
+            tile(0, 0, 50, 30),
+            tile(50, 0, 50, 30),
+            tile(0, 30, 50, 30),
+        ];
+
+        assert_eq!(grid(tiles).unwrap_err(), "tiles at 50,30 are missing");
+    }
+
+    #[test]
+    fn missing_band() {
+        let tiles = vec![
+            tile(0, 0, 50, 30),
+            tile(50, 0, 50, 30),
+        ];
+
+        assert_eq!(grid(tiles).unwrap_err(), "tiles at y=30 are missing");
+
+        let tiles = vec![
+            tile(0, 30, 50, 30),
+            tile(50, 30, 50, 30),
+        ];
+
+        assert_eq!(grid(tiles).unwrap_err(), "tiles at y=0 are missing");
+    }
+
+    #[test]
+    fn overlapping_tiles() {
+        let tiles = vec![
+            tile(0, 0, 60, 30),
+            tile(50, 0, 50, 30),
+            tile(0, 30, 100, 30),
+        ];
+
+        assert_eq!(grid(tiles).unwrap_err(), "tiles at 60,0 are missing or overlap");
+    }
+
+    #[test]
+    fn different_heights() {
+        let tiles = vec![
+            tile(0, 0, 50, 30),
+            tile(50, 0, 50, 20),
+            tile(0, 30, 100, 30),
+        ];
+
+        assert_eq!(grid(tiles).unwrap_err(), "tiles at 50,0 are missing or overlap");
+    }
+
+    #[test]
+    fn too_wide() {
+        let tiles = vec![
+            tile(0, 0, 50, 60),
+            tile(50, 0, 60, 60),
+        ];
+
+        assert_eq!(grid(tiles).unwrap_err(), "tiles at 110,0 are missing");
+    }
+}
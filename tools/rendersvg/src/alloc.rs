@@ -0,0 +1,50 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Allocation statistics printing.
+//!
+//! The allocator itself is `resvg::alloc_stats::CountingAlloc`.
+
+use resvg::alloc_stats::AllocStats;
+use resvg::stats::Site;
+
+pub use resvg::alloc_stats::{
+    get,
+    reset_peak,
+};
+
+
+/// Prints the difference between two snapshots.
+pub fn print_phase(title: &str, start: &AllocStats, end: &AllocStats) {
+    let mut sites = Vec::new();
+    for (i, site) in Site::all().iter().enumerate() {
+        let count = end.count[i] - start.count[i];
+        let bytes = end.bytes[i] - start.bytes[i];
+        if count != 0 {
+            sites.push((site.name(), count, bytes));
+        }
+    }
+
+    // Sort by allocated bytes.
+    sites.sort_by(|a, b| b.2.cmp(&a.2));
+
+    println!("{}: {} allocations, {}, peak {}", title,
+             end.total_count() - start.total_count(),
+             format_bytes(end.total_bytes() - start.total_bytes()),
+             format_bytes(end.peak));
+
+    for (name, count, bytes) in sites {
+        println!("    {}: {} allocations, {}", name, count, format_bytes(bytes));
+    }
+}
+
+fn format_bytes(n: usize) -> String {
+    if n >= 1024 * 1024 {
+        format!("{:.2}MiB", n as f64 / (1024.0 * 1024.0))
+    } else if n >= 1024 {
+        format!("{:.2}KiB", n as f64 / 1024.0)
+    } else {
+        format!("{}B", n)
+    }
+}
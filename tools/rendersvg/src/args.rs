@@ -7,42 +7,99 @@
 use std::process;
 use std::path;
 use std::str::FromStr;
+use std::time;
 
 use getopts;
 
 use resvg::{
     usvg,
+    capture,
     FitTo,
     Options,
 };
 
+use batch;
+use bench;
+use tiles;
+
 pub fn print_help() {
     print!("\
 rendersvg is an SVG rendering application.
 
 USAGE:
     rendersvg [OPTIONS] <in-svg> <out-png>
+    rendersvg [OPTIONS] --batch <in-svg>... <out-dir>
+    rendersvg [OPTIONS] --tile-grid=<COLS>x<ROWS> <in-svg> <out-dir>
 
     rendersvg in.svg out.png
     rendersvg -z 4 in.svg out.png
     rendersvg --query-all in.svg
+    rendersvg --bench --repeat=20 in.svg out.png
+    rendersvg --batch --jobs=4 *.svg out/
+    rendersvg -w 50000 --tile-grid=8x8 --tile-job=3/16 in.svg tiles/
 
 OPTIONS:
         --help                  Prints help information
     -V, --version               Prints version information
 
         --perf                  Prints performance stats
+        --alloc-stats           Prints allocation stats per phase.
+                                Requires the alloc-stats build feature
+        --bench                 Runs parsing, rendering and saving multiple times
+                                and prints per-phase statistics
+        --repeat=<N>            Sets the number of measured benchmark runs
+                                [default: 10]
+        --warmup=<N>            Sets the number of benchmark runs to discard
+                                [default: 1]
+        --bench-format=<FORMAT> Sets the benchmark output format
+                                [default: text] [possible values: text, json]
+        --pin-cpu=<ID>          Pins the benchmark thread to the selected CPU.
+                                Linux only
+        --batch                 Converts multiple files to PNG files
+                                with the same name in <out-dir>.
+                                Input file names must be unique.
+                                Reading, parsing, rendering and saving
+                                of different files are overlapped
+        --jobs=<N>              Sets the number of batch conversion workers
+                                [default: 3]
+        --tile-grid=<GRID>      Splits the image into a COLSxROWS grid of tiles
+                                and saves them with a manifest to <out-dir>.
+                                Use rendersvg-stitch to assemble the image
+        --tile-job=<I>/<N>      Renders only every N-th tile starting from I,
+                                so N jobs render the whole grid [default: 1/1]
         --pretend               Does all the steps except rendering
         --quiet                 Disables warnings
         --dump-svg=<PATH>       Saves the preprocessed SVG to the selected file
+        --capture-dir=<DIR>     Saves a diagnostic bundle to the selected directory
+                                when one of the capture thresholds is exceeded
+        --capture-time=<MS>     Sets the capture threshold for a single phase
+                                in milliseconds. 0 disables it [default: 1000]
+        --capture-memory=<MB>   Sets the capture threshold for the memory
+                                allocated for layers and patterns in megabytes.
+                                0 disables it
 
         --query-all             Queries all valid SVG ids with bounding boxes
         --export-id=<ID>        Renders an object only with a specified ID
+        --trim                  Renders only the content bounds and prints
+                                the rendered region as x,y,width,height
+                                in the full image pixels
 
         --backend=<BACKEND>     Sets the rendering backend.
                                 Has no effect if built with only one backend
                                 [default: {}] [possible values: {}]
 
+        --occlusion-culling     Skips elements that are fully covered
+                                by later opaque rectangles
+        --bake-clip-paths       Replaces simple clip paths with
+                                the clipped geometry
+        --simplify-covering-effects
+                                Removes clip paths and masks that cover
+                                the whole content and replaces solid patterns
+                                with a color
+        --decoding-threads=<N>  Decodes raster images using N threads
+                                before rendering. Cairo backend only
+                                [default: 1]
+
         --background=<COLOR>    Sets the background color.
                                 Examples: red, #fff, #fff000
         --dpi=<DPI>             Sets the resolution
@@ -65,8 +122,16 @@ pub struct Args {
     pub query_all: bool,
     pub export_id: Option<String>,
     pub dump: Option<path::PathBuf>,
+    pub capture: Option<(path::PathBuf, capture::Thresholds)>,
     pub pretend: bool,
     pub perf: bool,
+    pub bench: Option<bench::Config>,
+    pub batch: Option<batch::Config>,
+    pub tiles: Option<tiles::Config>,
+    pub alloc_stats: bool,
+    pub bake_clip_paths: bool,
+    pub simplify_covering_effects: bool,
+    pub trim: bool,
     pub quiet: bool,
 }
 
@@ -78,15 +143,33 @@ pub fn parse() -> Result<(Args, Options), String> {
     opts.optflag("V", "version", "");
 
     opts.optflag("", "perf", "");
+    opts.optflag("", "alloc-stats", "");
+    opts.optflag("", "bench", "");
+    opts.optopt("", "repeat", "", "");
+    opts.optopt("", "warmup", "", "");
+    opts.optopt("", "bench-format", "", "");
+    opts.optopt("", "pin-cpu", "", "");
+    opts.optflag("", "batch", "");
+    opts.optopt("", "jobs", "", "");
+    opts.optopt("", "tile-grid", "", "");
+    opts.optopt("", "tile-job", "", "");
     opts.optflag("", "pretend", "");
     opts.optflag("", "quiet", "");
     opts.optopt("", "dump-svg", "", "");
+    opts.optopt("", "capture-dir", "", "");
+    opts.optopt("", "capture-time", "", "");
+    opts.optopt("", "capture-memory", "", "");
 
     opts.optflag("", "query-all", "");
     opts.optopt("", "export-id", "", "");
+    opts.optflag("", "trim", "");
 
     opts.optopt("", "backend", "", "");
     opts.optopt("", "background", "", "");
+    opts.optflag("", "occlusion-culling", "");
+    opts.optflag("", "bake-clip-paths", "");
+    opts.optflag("", "simplify-covering-effects", "");
+    opts.optopt("", "decoding-threads", "", "");
     opts.optopt("", "dpi", "", "");
     opts.optopt("w", "width", "", "");
     opts.optopt("h", "height", "", "");
@@ -107,24 +190,125 @@ pub fn parse() -> Result<(Args, Options), String> {
         process::exit(0);
     }
 
-    let positional_count = if args.opt_present("query-all") { 1 } else { 2 };
+    let batch = if args.opt_present("batch") {
+        let conflicts = ["query-all", "bench", "trim", "export-id", "capture-dir", "dump-svg"];
+        if conflicts.iter().any(|name| args.opt_present(name)) {
+            return Err(format!("--batch cannot be used with --query-all, --bench, --trim, \
+                                --export-id, --capture-dir or --dump-svg"));
+        }
 
-    if args.free.len() != positional_count {
-        return Err(format!("<in-svg> and <out-png> must be set"));
-    }
+        if args.free.len() < 2 {
+            return Err(format!("<in-svg> and <out-dir> must be set"));
+        }
+
+        let jobs = get_type(&args, "jobs", "N")?.unwrap_or(3);
+        if jobs == 0 {
+            return Err(format!("invalid N"));
+        }
+
+        let (out_dir, inputs) = args.free.split_last().unwrap();
+
+        Some(batch::Config {
+            jobs,
+            inputs: inputs.iter().map(|v| v.into()).collect(),
+            out_dir: out_dir.into(),
+            bake_clip_paths: args.opt_present("bake-clip-paths"),
+            simplify_covering_effects: args.opt_present("simplify-covering-effects"),
+        })
+    } else {
+        let positional_count = if args.opt_present("query-all") { 1 } else { 2 };
+
+        if args.free.len() != positional_count {
+            return Err(format!("<in-svg> and <out-png> must be set"));
+        }
+
+        None
+    };
+
+    let tiles = match get_pair(&args, "tile-grid", 'x', "GRID")? {
+        Some((cols, rows)) => {
+            if batch.is_some() || args.opt_present("query-all") || args.opt_present("bench")
+               || args.opt_present("export-id") || args.opt_present("trim")
+            {
+                return Err(format!("--tile-grid cannot be used with --batch, --query-all, \
+                                    --bench, --export-id or --trim"));
+            }
+
+            if cols == 0 || rows == 0 {
+                return Err(format!("invalid GRID"));
+            }
+
+            let (job, jobs) = get_pair(&args, "tile-job", '/', "I/N")?.unwrap_or((1, 1));
+            if jobs == 0 || job == 0 || job > jobs {
+                return Err(format!("invalid I/N"));
+            }
+
+            Some(tiles::Config { job: job - 1, jobs, cols, rows })
+        }
+        None => {
+            if args.opt_present("tile-job") {
+                return Err(format!("--tile-job requires --tile-grid"));
+            }
+
+            None
+        }
+    };
 
     let in_svg: path::PathBuf = args.free[0].to_string().into();
 
-    let out_png = if !args.opt_present("query-all") {
+    let out_png = if batch.is_none() && !args.opt_present("query-all") {
         Some(args.free[1].to_string().into())
     } else {
         None
     };
 
+    if args.opt_present("trim") && args.opt_present("export-id") {
+        return Err(format!("--trim cannot be used with --export-id"));
+    }
+
     let backend_name = args.opt_str("backend").unwrap_or(default_backend().to_string());
     let dump = args.opt_str("dump-svg").map(|v| v.into());
     let export_id = args.opt_str("export-id").map(|v| v.to_string());
 
+    let capture = match args.opt_str("capture-dir") {
+        Some(dir) => {
+            let time: u64 = get_type(&args, "capture-time", "MS")?.unwrap_or(1000);
+            let memory: Option<u64> = get_type(&args, "capture-memory", "MB")?;
+
+            // Like in the C API, zero disables the threshold.
+            let thresholds = capture::Thresholds {
+                time: if time != 0 { Some(time::Duration::from_millis(time)) } else { None },
+                memory: memory.and_then(|v| if v != 0 { Some(v * 1024 * 1024) } else { None }),
+            };
+
+            Some((dir.into(), thresholds))
+        }
+        None => None,
+    };
+
+    let bench = if args.opt_present("bench") {
+        let repeat = get_type(&args, "repeat", "N")?.unwrap_or(10);
+        if repeat == 0 {
+            return Err(format!("invalid N"));
+        }
+
+        let format = match args.opt_str("bench-format") {
+            Some(ref v) if v == "json" => bench::Format::Json,
+            Some(ref v) if v == "text" => bench::Format::Text,
+            Some(v) => return Err(format!("invalid FORMAT: '{}'", v)),
+            None => bench::Format::Text,
+        };
+
+        Some(bench::Config {
+            repeat,
+            warmup: get_type(&args, "warmup", "N")?.unwrap_or(1),
+            format,
+            pin_cpu: get_type(&args, "pin-cpu", "ID")?,
+        })
+    } else {
+        None
+    };
+
     let app_args = Args {
         in_svg: in_svg.clone(),
         out_png,
@@ -132,8 +316,16 @@ pub fn parse() -> Result<(Args, Options), String> {
         query_all: args.opt_present("query-all"),
         export_id,
         dump,
+        capture,
         pretend: args.opt_present("pretend"),
         perf: args.opt_present("perf"),
+        bench,
+        batch,
+        tiles,
+        alloc_stats: args.opt_present("alloc-stats"),
+        bake_clip_paths: args.opt_present("bake-clip-paths"),
+        simplify_covering_effects: args.opt_present("simplify-covering-effects"),
+        trim: args.opt_present("trim"),
         quiet: args.opt_present("quiet"),
     };
 
@@ -169,6 +361,11 @@ pub fn parse() -> Result<(Args, Options), String> {
         return Err(format!("DPI out of bounds"));
     }
 
+    let decoding_threads = get_type(&args, "decoding-threads", "N")?.unwrap_or(1);
+    if decoding_threads == 0 {
+        return Err(format!("invalid N"));
+    }
+
     let opt = Options {
         usvg: usvg::Options {
             path: Some(in_svg.into()),
@@ -177,6 +374,9 @@ pub fn parse() -> Result<(Args, Options), String> {
         },
         fit_to,
         background,
+        occlusion_culling: args.opt_present("occlusion-culling"),
+        coverage_cache: false,
+        decoding_threads,
     };
 
     Ok((app_args, opt))
@@ -192,6 +392,25 @@ fn get_type<T: FromStr>(args: &getopts::Matches, name: &str, type_name: &str) ->
     }
 }
 
+/// Parses values like `4x4` or `1/8`.
+fn get_pair(
+    args: &getopts::Matches,
+    name: &str,
+    sep: char,
+    type_name: &str,
+) -> Result<Option<(u32, u32)>, String> {
+    match args.opt_str(name) {
+        Some(v) => {
+            let mut iter = v.splitn(2, sep).map(|n| n.parse::<u32>());
+            match (iter.next(), iter.next()) {
+                (Some(Ok(a)), Some(Ok(b))) => Ok(Some((a, b))),
+                _ => Err(format!("invalid {}: '{}'", type_name, v)),
+            }
+        }
+        None => Ok(None),
+    }
+}
+
 #[allow(unreachable_code)]
 fn default_backend() -> &'static str {
     #[cfg(feature = "cairo-backend")]
@@ -0,0 +1,234 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Batch conversion mode.
+//!
+//! Files are read by a separate thread and converted by a pool of workers,
+//! so reading, parsing, rendering and saving of different files overlap.
+//!
+//! The `usvg` tree and the rendered image cannot be sent between threads,
+//! so each worker parses, renders and saves its file itself.
+
+use std::collections::{
+    HashMap,
+    HashSet,
+};
+use std::fs;
+use std::path;
+use std::sync::{
+    mpsc,
+    Arc,
+    Mutex,
+};
+use std::thread;
+
+use time;
+
+use resvg::{
+    usvg,
+    passes,
+    Options,
+};
+
+use create_backend;
+
+
+/// Maximum number of files that were read, but not converted yet.
+const QUEUE_SIZE: usize = 4;
+
+
+pub struct Config {
+    pub jobs: usize,
+    pub inputs: Vec<path::PathBuf>,
+    pub out_dir: path::PathBuf,
+    pub bake_clip_paths: bool,
+    pub simplify_covering_effects: bool,
+}
+
+/// Enabled optional passes.
+#[derive(Clone, Copy)]
+struct PassFlags {
+    bake_clip_paths: bool,
+    simplify_covering_effects: bool,
+}
+
+struct Job {
+    in_svg: path::PathBuf,
+    data: Result<Vec<u8>, String>,
+}
+
+pub fn run(
+    config: &Config,
+    backend_name: &str,
+    perf: bool,
+    opt: &Options,
+) -> Result<(), String> {
+    if !config.out_dir.is_dir() {
+        return Err(format!("{:?} is not a directory", config.out_dir));
+    }
+
+    // Outputs are named after the input file names only,
+    // so files with the same name from different directories would overwrite each other.
+    let mut outputs = HashMap::new();
+    for in_svg in &config.inputs {
+        let out_png = out_path(in_svg, &config.out_dir);
+        if let Some(prev) = outputs.insert(out_png.clone(), in_svg) {
+            return Err(format!("{:?} and {:?} have the same output file {:?}",
+                               prev, in_svg, out_png));
+        }
+    }
+
+    // Check that the backend is valid before starting any threads.
+    create_backend(backend_name)?;
+
+    let start = time::precise_time_ns();
+
+    // The bounded queue stops the reader when workers are busy.
+    let (job_tx, job_rx) = mpsc::sync_channel::<Job>(QUEUE_SIZE);
+    let job_rx = Arc::new(Mutex::new(job_rx));
+    let (res_tx, res_rx) = mpsc::channel();
+
+    let inputs = config.inputs.clone();
+    let reader = thread::spawn(move || {
+        for in_svg in inputs {
+            let data = fs::read(&in_svg).map_err(|e| e.to_string());
+            if job_tx.send(Job { in_svg, data }).is_err() {
+                break;
+            }
+        }
+    });
+
+    let mut workers = Vec::new();
+    for _ in 0..config.jobs {
+        let job_rx = job_rx.clone();
+        let res_tx = res_tx.clone();
+        let out_dir = config.out_dir.clone();
+        let flags = PassFlags {
+            bake_clip_paths: config.bake_clip_paths,
+            simplify_covering_effects: config.simplify_covering_effects,
+        };
+        let backend_name = backend_name.to_string();
+        let opt = file_options(opt, None);
+
+        workers.push(thread::spawn(move || {
+            loop {
+                // The lock is released before the conversion.
+                let job = match job_rx.lock().unwrap().recv() {
+                    Ok(job) => job,
+                    Err(_) => break,
+                };
+
+                let start = time::precise_time_ns();
+                let res = convert(&job, &out_dir, &backend_name, flags, &opt);
+                let elapsed = time::precise_time_ns() - start;
+
+                if res_tx.send((job.in_svg, res, elapsed)).is_err() {
+                    break;
+                }
+            }
+        }));
+    }
+
+    // Otherwise `res_rx` will wait forever.
+    drop(res_tx);
+
+    let mut failed = 0;
+    let mut finished = HashSet::new();
+    for (in_svg, res, elapsed) in res_rx {
+        match res {
+            Ok(_) => {
+                if perf {
+                    println!("{:?}: {:.2}ms", in_svg, elapsed as f64 / 1_000_000.0);
+                }
+            }
+            Err(e) => {
+                eprintln!("Error: {:?}: {}.", in_svg, e);
+                failed += 1;
+            }
+        }
+
+        finished.insert(in_svg);
+    }
+
+    // A worker that panicked doesn't send the result of its file,
+    // so files are checked by name.
+    let _ = reader.join();
+    for worker in workers {
+        let _ = worker.join();
+    }
+
+    for in_svg in &config.inputs {
+        if !finished.contains(in_svg) {
+            eprintln!("Error: {:?}: conversion was not finished.", in_svg);
+            failed += 1;
+        }
+    }
+
+    if perf {
+        let elapsed = (time::precise_time_ns() - start) as f64 / 1_000_000_000.0;
+        println!("Batch: {} files in {:.2}s, {:.2} files/s",
+                 config.inputs.len(), elapsed, config.inputs.len() as f64 / elapsed);
+    }
+
+    if failed != 0 {
+        return Err(format!("failed to convert {} of {} files", failed, config.inputs.len()));
+    }
+
+    Ok(())
+}
+
+fn convert(
+    job: &Job,
+    out_dir: &path::Path,
+    backend_name: &str,
+    flags: PassFlags,
+    opt: &Options,
+) -> Result<(), String> {
+    let data = job.data.as_ref().map_err(|e| e.clone())?;
+
+    // Relative image paths are resolved using the SVG file path.
+    let opt = file_options(opt, Some(&job.in_svg));
+
+    let tree = usvg::Tree::from_data(data, &opt.usvg).map_err(|e| e.to_string())?;
+
+    passes::simplify_effects(&tree);
+    if flags.simplify_covering_effects {
+        passes::simplify_covering_effects(&tree);
+    }
+    if flags.bake_clip_paths {
+        passes::bake_clip_paths(&tree);
+    }
+
+    let backend = create_backend(backend_name)?;
+    let img = backend.render_to_image(&tree, &opt)
+                     .ok_or_else(|| "failed to allocate an image".to_string())?;
+
+    let out_png = out_path(&job.in_svg, out_dir);
+    if !img.save(&out_png) {
+        return Err(format!("failed to save {:?}", out_png));
+    }
+
+    Ok(())
+}
+
+fn out_path(in_svg: &path::Path, out_dir: &path::Path) -> path::PathBuf {
+    let mut name = in_svg.file_stem().map(|s| s.to_os_string()).unwrap_or_default();
+    name.push(".png");
+    out_dir.join(name)
+}
+
+fn file_options(opt: &Options, in_svg: Option<&path::Path>) -> Options {
+    Options {
+        usvg: usvg::Options {
+            path: in_svg.map(|p| p.to_path_buf()),
+            dpi: opt.usvg.dpi,
+            keep_named_groups: opt.usvg.keep_named_groups,
+        },
+        fit_to: opt.fit_to,
+        background: opt.background,
+        occlusion_culling: opt.occlusion_culling,
+        coverage_cache: opt.coverage_cache,
+        decoding_threads: opt.decoding_threads,
+    }
+}
@@ -0,0 +1,230 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! In-process benchmark mode.
+//!
+//! Runs parsing, rendering and saving multiple times and prints
+//! per-phase statistics.
+
+use std::path;
+
+use time;
+
+use resvg::{
+    usvg,
+    passes,
+    Options,
+    Render,
+};
+use usvg::prelude::*;
+
+use args;
+
+
+#[derive(Clone, Copy, PartialEq, Debug)]
+pub enum Format {
+    Text,
+    Json,
+}
+
+pub struct Config {
+    pub repeat: u32,
+    pub warmup: u32,
+    pub format: Format,
+    pub pin_cpu: Option<usize>,
+}
+
+struct Phase {
+    name: &'static str,
+    /// Samples in nanoseconds.
+    samples: Vec<u64>,
+}
+
+impl Phase {
+    fn new(name: &'static str) -> Self {
+        Phase { name, samples: Vec::new() }
+    }
+}
+
+struct Summary {
+    min: f64,
+    median: f64,
+    p95: f64,
+    mean: f64,
+    stddev: f64,
+}
+
+pub fn run(
+    args: &args::Args,
+    config: &Config,
+    backend: &Render,
+    opt: &Options,
+) -> Result<(), String> {
+    if let Some(cpu) = config.pin_cpu {
+        pin_to_cpu(cpu)?;
+    }
+
+    let out_png = match args.out_png {
+        Some(ref path) => path,
+        None => return Err(format!("<out-png> must be set")),
+    };
+
+    let mut phases = [
+        Phase::new("Preprocessing"),
+        Phase::new("Rendering"),
+        Phase::new("Saving"),
+    ];
+
+    for i in 0..(config.warmup + config.repeat) {
+        let samples = run_once(args, backend, opt, out_png)?;
+
+        if i < config.warmup {
+            continue;
+        }
+
+        for (phase, sample) in phases.iter_mut().zip(samples.iter()) {
+            phase.samples.push(*sample);
+        }
+    }
+
+    match config.format {
+        Format::Text => print_text(&args.backend_name, config, &phases),
+        Format::Json => print_json(&args.backend_name, config, &phases),
+    }
+
+    Ok(())
+}
+
+fn run_once(
+    args: &args::Args,
+    backend: &Render,
+    opt: &Options,
+    out_png: &path::Path,
+) -> Result<[u64; 3], String> {
+    let start = time::precise_time_ns();
+    let tree = usvg::Tree::from_file(&args.in_svg, &opt.usvg).map_err(|e| e.to_string())?;
+    passes::simplify_effects(&tree);
+    if args.simplify_covering_effects {
+        passes::simplify_covering_effects(&tree);
+    }
+    if args.bake_clip_paths {
+        passes::bake_clip_paths(&tree);
+    }
+    let parse_end = time::precise_time_ns();
+
+    let img = if let Some(ref id) = args.export_id {
+        match tree.root().descendants().find(|n| &*n.id() == id) {
+            Some(node) => backend.render_node_to_image(&node, opt),
+            None => return Err(format!("SVG doesn't have '{}' ID", id)),
+        }
+    } else if args.trim {
+        backend.render_trimmed_to_image(&tree, opt).map(|(img, _)| img)
+    } else {
+        backend.render_to_image(&tree, opt)
+    };
+    let render_end = time::precise_time_ns();
+
+    let img = match img {
+        Some(img) => img,
+        None => return Err(format!("failed to allocate an image")),
+    };
+
+    if !img.save(out_png) {
+        return Err(format!("failed to save an image to {:?}", out_png));
+    }
+    let save_end = time::precise_time_ns();
+
+    Ok([parse_end - start, render_end - parse_end, save_end - render_end])
+}
+
+fn summarize(samples: &[u64]) -> Summary {
+    let mut v: Vec<f64> = samples.iter().map(|n| *n as f64 / 1_000_000.0).collect();
+    v.sort_by(|a, b| a.partial_cmp(b).unwrap());
+
+    let count = v.len() as f64;
+    let mean = v.iter().sum::<f64>() / count;
+    let variance = v.iter().map(|x| (x - mean) * (x - mean)).sum::<f64>() / count;
+
+    Summary {
+        min: v[0],
+        median: percentile(&v, 50.0),
+        p95: percentile(&v, 95.0),
+        mean,
+        stddev: variance.sqrt(),
+    }
+}
+
+/// Nearest-rank percentile of a sorted list.
+fn percentile(sorted: &[f64], p: f64) -> f64 {
+    let rank = (p / 100.0 * sorted.len() as f64).ceil() as usize;
+    let idx = if rank == 0 { 0 } else { rank - 1 };
+    sorted[::std::cmp::min(idx, sorted.len() - 1)]
+}
+
+fn print_text(backend: &str, config: &Config, phases: &[Phase]) {
+    println!("Backend: {}, runs: {}, warmup: {}", backend, config.repeat, config.warmup);
+    println!("{:<14} {:>10} {:>10} {:>10} {:>10} {:>10}",
+             "Phase", "Min", "Median", "P95", "Mean", "Stddev");
+
+    for phase in phases {
+        let s = summarize(&phase.samples);
+        println!("{:<14} {:>8.3}ms {:>8.3}ms {:>8.3}ms {:>8.3}ms {:>8.3}ms",
+                 phase.name, s.min, s.median, s.p95, s.mean, s.stddev);
+    }
+}
+
+fn print_json(backend: &str, config: &Config, phases: &[Phase]) {
+    println!("{{");
+    println!("  \"backend\": \"{}\",", backend);
+    println!("  \"runs\": {},", config.repeat);
+    println!("  \"warmup\": {},", config.warmup);
+    println!("  \"unit\": \"ms\",");
+    println!("  \"phases\": {{");
+
+    for (i, phase) in phases.iter().enumerate() {
+        let s = summarize(&phase.samples);
+        let sep = if i + 1 == phases.len() { "" } else { "," };
+        println!("    \"{}\": {{ \"min\": {:.4}, \"median\": {:.4}, \"p95\": {:.4}, \
+                  \"mean\": {:.4}, \"stddev\": {:.4} }}{}",
+                 phase.name, s.min, s.median, s.p95, s.mean, s.stddev, sep);
+    }
+
+    println!("  }}");
+    println!("}}");
+}
+
+#[cfg(target_os = "linux")]
+fn pin_to_cpu(cpu: usize) -> Result<(), String> {
+    use std::mem;
+
+    // Matches glibc's `cpu_set_t`, which has 1024 bits.
+    #[repr(C)]
+    struct CpuSet {
+        bits: [u64; 16],
+    }
+
+    extern "C" {
+        fn sched_setaffinity(pid: i32, size: usize, mask: *const CpuSet) -> i32;
+    }
+
+    if cpu >= 1024 {
+        return Err(format!("invalid CPU index: {}", cpu));
+    }
+
+    let mut set = CpuSet { bits: [0; 16] };
+    set.bits[cpu / 64] |= 1 << (cpu % 64);
+
+    // `0` is the calling thread.
+    let res = unsafe { sched_setaffinity(0, mem::size_of::<CpuSet>(), &set) };
+    if res != 0 {
+        return Err(format!("failed to pin the thread to CPU {}", cpu));
+    }
+
+    Ok(())
+}
+
+#[cfg(not(target_os = "linux"))]
+fn pin_to_cpu(_: usize) -> Result<(), String> {
+    Err(format!("CPU pinning is supported only on Linux"))
+}
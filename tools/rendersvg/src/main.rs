@@ -11,20 +11,31 @@ extern crate time;
 
 use std::fmt;
 use std::fs;
-use std::io::Write;
+use std::io::{
+    Read,
+    Write,
+};
 use std::path;
+use std::time::Duration;
 
 use resvg::{
     usvg,
-    svgdom,
+    capture,
     Options,
     Render,
 };
 use usvg::prelude::*;
 
-use svgdom::WriteBuffer;
-
 mod args;
+mod batch;
+mod bench;
+mod tiles;
+#[cfg(feature = "alloc-stats")] mod alloc;
+
+
+#[cfg(feature = "alloc-stats")]
+#[global_allocator]
+static GLOBAL: resvg::alloc_stats::CountingAlloc = resvg::alloc_stats::CountingAlloc;
 
 
 macro_rules! bail {
@@ -59,6 +70,13 @@ fn process() -> Result<(), String> {
         }
     };
 
+    #[cfg(not(feature = "alloc-stats"))]
+    {
+        if args.alloc_stats {
+            bail!("rendersvg has been built without the alloc-stats feature")
+        }
+    }
+
     // Do not print warning during the ID querying.
     //
     // Some crates still can print to stdout/stderr, but we can't do anything about it.
@@ -70,22 +88,44 @@ fn process() -> Result<(), String> {
             .apply().unwrap();
     }
 
-    let backend: Box<Render> = match args.backend_name.as_str() {
-        #[cfg(feature = "cairo-backend")]
-        "cairo" => Box::new(resvg::backend_cairo::Backend),
+    if let Some(ref config) = args.batch {
+        // Text may be present in any file, so Qt must be always initialized.
         #[cfg(feature = "qt-backend")]
-        "qt" => Box::new(resvg::backend_qt::Backend),
-        _ => bail!("unknown backend"),
-    };
+        let _resvg = if args.backend_name == "qt" { Some(resvg::init()) } else { None };
+
+        return batch::run(config, &args.backend_name, args.perf, &opt);
+    }
+
+    let backend = create_backend(&args.backend_name)?;
+
+    let mut timings = Vec::new();
 
     macro_rules! timed {
-        ($name:expr, $task:expr) => { run_task(args.perf, $name, || $task) };
+        ($name:expr, $task:expr) => { run_task(&args, $name, &mut timings, || $task) };
     }
 
     // Load file.
     let tree = timed!("Preprocessing", {
         usvg::Tree::from_file(&args.in_svg, &opt.usvg).map_err(|e| e.to_string())
-    })?;
+    });
+
+    let tree = match tree {
+        Ok(tree) => tree,
+        Err(e) => {
+            capture_slow_render(&args, &opt, &timings, None);
+            bail!(e);
+        }
+    };
+
+    timed!("Passes", {
+        resvg::passes::simplify_effects(&tree);
+        if args.simplify_covering_effects {
+            resvg::passes::simplify_covering_effects(&tree);
+        }
+        if args.bake_clip_paths {
+            resvg::passes::bake_clip_paths(&tree);
+        }
+    });
 
     // We have to init only Qt backend.
     #[cfg(feature = "qt-backend")]
@@ -100,10 +140,22 @@ fn process() -> Result<(), String> {
         dump_svg(&tree, dump_path)?;
     }
 
+    if let Some(ref config) = args.bench {
+        return bench::run(&args, config, &*backend, &opt);
+    }
+
+    if let Some(ref config) = args.tiles {
+        let out_dir = args.out_png.as_ref().unwrap();
+        return timed!("Rendering", tiles::run(config, &tree, &*backend, &opt, out_dir));
+    }
+
     if args.pretend {
+        capture_slow_render(&args, &opt, &timings, Some(&tree));
         return Ok(());
     }
 
+    resvg::stats::reset();
+
     // Render.
     if let Some(ref out_png) = args.out_png {
         let img = if let Some(ref id) = args.export_id {
@@ -112,19 +164,40 @@ fn process() -> Result<(), String> {
             } else {
                 bail!("SVG doesn't have '{}' ID", id)
             }
+        } else if args.trim {
+            let res = timed!("Rendering", backend.render_trimmed_to_image(&tree, &opt));
+            res.map(|(img, r)| {
+                println!("{},{},{},{}", r.x, r.y, r.width, r.height);
+                img
+            })
         } else {
             timed!("Rendering", backend.render_to_image(&tree, &opt))
         };
 
         match img {
             Some(img) => { timed!("Saving", img.save(out_png)); }
-            None => { bail!("failed to allocate an image") }
+            None => {
+                capture_slow_render(&args, &opt, &timings, Some(&tree));
+                bail!("failed to allocate an image")
+            }
         }
     };
 
+    capture_slow_render(&args, &opt, &timings, Some(&tree));
+
     Ok(())
 }
 
+fn create_backend(name: &str) -> Result<Box<Render>, String> {
+    match name {
+        #[cfg(feature = "cairo-backend")]
+        "cairo" => Ok(Box::new(resvg::backend_cairo::Backend)),
+        #[cfg(feature = "qt-backend")]
+        "qt" => Ok(Box::new(resvg::backend_qt::Backend)),
+        _ => bail!("unknown backend"),
+    }
+}
+
 // Qt backend initialization is pretty slow
 // and needed only for files with text nodes.
 // So we skip it file doesn't have one.
@@ -185,35 +258,85 @@ fn query_all(
     Ok(())
 }
 
-fn run_task<P, T>(perf: bool, title: &str, p: P) -> T
+fn run_task<P, T>(
+    args: &args::Args,
+    title: &'static str,
+    timings: &mut Vec<(&'static str, Duration)>,
+    p: P,
+) -> T
     where P: FnOnce() -> T
 {
-    if perf {
-        let start = time::precise_time_ns();
-        let res = p();
-        let end = time::precise_time_ns();
-        println!("{}: {:.2}ms", title, (end - start) as f64 / 1_000_000.0);
-        res
+    #[cfg(feature = "alloc-stats")]
+    let alloc_start = if args.alloc_stats {
+        alloc::reset_peak();
+        Some(alloc::get())
     } else {
-        p()
+        None
+    };
+
+    let start = time::precise_time_ns();
+    let res = p();
+    let end = time::precise_time_ns();
+
+    #[cfg(feature = "alloc-stats")]
+    {
+        if let Some(ref alloc_start) = alloc_start {
+            alloc::print_phase(title, alloc_start, &alloc::get());
+        }
+    }
+
+    let elapsed = end - start;
+    timings.push((title, Duration::new(elapsed / 1_000_000_000, (elapsed % 1_000_000_000) as u32)));
+
+    if args.perf {
+        println!("{}: {:.2}ms", title, elapsed as f64 / 1_000_000.0);
     }
+
+    res
 }
 
-fn dump_svg(tree: &usvg::Tree, path: &path::Path) -> Result<(), String> {
-    let mut f = fs::File::create(path)
-                   .map_err(|_| format!("failed to create a file {:?}", path))?;
+fn capture_slow_render(
+    args: &args::Args,
+    opt: &Options,
+    timings: &[(&'static str, Duration)],
+    tree: Option<&usvg::Tree>,
+) {
+    let &(ref dir, ref thresholds) = match args.capture {
+        Some(ref v) => v,
+        None => return,
+    };
+
+    let stats = resvg::stats::get();
+    if !thresholds.is_exceeded(timings, &stats) {
+        return;
+    }
+
+    let mut input = Vec::new();
+    if let Ok(mut f) = fs::File::open(&args.in_svg) {
+        if f.read_to_end(&mut input).is_err() {
+            input.clear();
+        }
+    }
 
-    let opt = svgdom::WriteOptions {
-        indent: svgdom::Indent::Spaces(2),
-        attributes_indent: svgdom::Indent::Spaces(3),
-        attributes_order: svgdom::AttributesOrder::Specification,
-        .. svgdom::WriteOptions::default()
+    let bundle = capture::Bundle {
+        input: &input,
+        opt,
+        timings,
+        stats,
+        tree,
     };
 
-    let svgdoc = tree.to_svgdom();
+    match bundle.write(dir) {
+        Ok(path) => eprintln!("Warning: slow render captured to {:?}.", path),
+        Err(e) => eprintln!("Warning: failed to write a capture bundle: {}.", e),
+    }
+}
+
+fn dump_svg(tree: &usvg::Tree, path: &path::Path) -> Result<(), String> {
+    let mut f = fs::File::create(path)
+                   .map_err(|_| format!("failed to create a file {:?}", path))?;
 
-    let mut out = Vec::new();
-    svgdoc.write_buf_opt(&opt, &mut out);
+    let out = capture::dump_tree(tree);
     f.write_all(&out).map_err(|_| format!("failed to write a file {:?}", path))?;
 
     Ok(())
@@ -0,0 +1,101 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Tile jobs.
+//!
+//! A large image can be split into a grid of tiles, which are rendered
+//! by independent jobs, possibly on different machines. Each job parses
+//! the file once, renders every N-th tile of the grid and writes a manifest
+//! with the tiles positions. `rendersvg-stitch` assembles the final image
+//! from the manifests.
+//!
+//! Manifest format:
+//!
+//! ```text
+//! rendersvg-tiles 1
+//! image <width> <height>
+//! tile <x> <y> <width> <height> <file>
+//! ...
+//! ```
+
+use std::fs;
+use std::io::Write;
+use std::path;
+
+use resvg::{
+    usvg,
+    utils,
+    Options,
+    Render,
+    ScreenRect,
+};
+use resvg::prelude::*;
+
+
+const MANIFEST_HEADER: &'static str = "rendersvg-tiles 1";
+
+pub struct Config {
+    /// Zero-based job index.
+    pub job: u32,
+    pub jobs: u32,
+    pub cols: u32,
+    pub rows: u32,
+}
+
+pub fn run(
+    config: &Config,
+    tree: &usvg::Tree,
+    backend: &Render,
+    opt: &Options,
+    out_dir: &path::Path,
+) -> Result<(), String> {
+    let img_size = utils::fit_to(tree.svg_node().size.to_screen_size(), opt.fit_to);
+    if config.cols > img_size.width || config.rows > img_size.height {
+        return Err(format!("the tile grid is bigger than the image"));
+    }
+
+    fs::create_dir_all(out_dir).map_err(|e| format!("failed to create {:?}: {}", out_dir, e))?;
+
+    let mut manifest = format!("{}\nimage {} {}\n", MANIFEST_HEADER, img_size.width, img_size.height);
+
+    let count = config.cols * config.rows;
+    for idx in (config.job..count).filter(|idx| idx % config.jobs == config.job) {
+        let col = idx % config.cols;
+        let row = idx / config.cols;
+
+        let x1 = split(img_size.width, config.cols, col);
+        let x2 = split(img_size.width, config.cols, col + 1);
+        let y1 = split(img_size.height, config.rows, row);
+        let y2 = split(img_size.height, config.rows, row + 1);
+        let region = ScreenRect::new(x1, y1, x2 - x1, y2 - y1);
+
+        let img = backend.render_region_to_image(tree, opt, region)
+                         .ok_or_else(|| "failed to allocate an image".to_string())?;
+
+        let name = format!("tile-{}-{}.png", col, row);
+        let path = out_dir.join(&name);
+        if !img.save(&path) {
+            return Err(format!("failed to save {:?}", path));
+        }
+
+        manifest.push_str(&format!("tile {} {} {} {} {}\n",
+                                   region.x, region.y, region.width, region.height, name));
+    }
+
+    // The manifest is written last and renamed into place,
+    // so an incomplete job doesn't have one.
+    let path = out_dir.join(format!("job-{}.manifest", config.job + 1));
+    let tmp_path = path.with_extension("manifest.tmp");
+    fs::File::create(&tmp_path)
+        .and_then(|mut f| f.write_all(manifest.as_bytes()))
+        .and_then(|_| fs::rename(&tmp_path, &path))
+        .map_err(|e| format!("failed to write {:?}: {}", path, e))?;
+
+    Ok(())
+}
+
+/// Returns the start of the `idx` part when `len` is split into `count` parts.
+fn split(len: u32, count: u32, idx: u32) -> u32 {
+    (len as u64 * idx as u64 / count as u64) as u32
+}
@@ -88,3 +88,56 @@ fn query_file_without_ids() {
         .stderr().is("Error: the file has no valid ID's.")
         .unwrap();
 }
+
+#[test]
+fn batch_with_same_file_names() {
+    let args = &[
+        APP_PATH,
+        "--batch",
+        "tests/images/bbox.svg",
+        "tests/images/../images/bbox.svg",
+        "tests/images",
+    ];
+
+    Assert::command(args)
+        .fails()
+        .stdout().is("")
+        .stderr().is("Error: \"tests/images/bbox.svg\" and \"tests/images/../images/bbox.svg\" \
+                       have the same output file \"tests/images/bbox.png\".")
+        .unwrap();
+}
+
+#[test]
+fn batch_with_export_id() {
+    let args = &[
+        APP_PATH,
+        "--batch",
+        "--export-id=rect1",
+        "tests/images/bbox.svg",
+        "tests/images",
+    ];
+
+    Assert::command(args)
+        .fails()
+        .stdout().is("")
+        .stderr().is("Error: --batch cannot be used with --query-all, --bench, --trim, \
+                       --export-id, --capture-dir or --dump-svg.")
+        .unwrap();
+}
+
+// Check that the trimmed region includes miter joins and scaled strokes.
+#[test]
+fn trim() {
+    let out_png = std::env::temp_dir().join("rendersvg-trim.png");
+    let args = &[
+        APP_PATH,
+        "--trim",
+        "tests/images/trim.svg",
+        out_png.to_str().unwrap(),
+    ];
+
+    Assert::command(args)
+        .stdout().is("21,21,142,142")
+        .stderr().is("")
+        .unwrap();
+}